@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 #include "branch_predictor.hh"
 #include "machine_state.hh"
 #include "globals.hh"
@@ -5,17 +9,27 @@
 
 namespace {
   class tage_tbl {
-  private:
+  public:
     static const int tag_bits = 14;
     struct tage_tbl_entry {
-      int64_t tag : tag_bits;
-      int64_t pred : 3;
-      int64_t useful : 2;
+      uint32_t tag : tag_bits;
+      int32_t pred : 3;
+      uint32_t useful : 2;
     };
+  private:
     uint64_t lg_entries = 0;
     int tbl_id = -1;
     uint64_t h_bits = 0;
     tage_tbl_entry *tbl = nullptr;
+    /* xor n-bit chunks of the history together */
+    static uint64_t fold(uint64_t h, uint64_t n) {
+      uint64_t f = 0;
+      while(h) {
+	f ^= h & ((1UL << n) - 1);
+	h >>= n;
+      }
+      return f;
+    }
   public:
     tage_tbl(uint64_t lg_entries, int tbl_id, uint64_t h_bits) :
       lg_entries(lg_entries), tbl_id(tbl_id), h_bits(h_bits) {
@@ -25,30 +39,204 @@ namespace {
     ~tage_tbl() {
       delete [] tbl;
     }
+    uint64_t history_bits() const {
+      return h_bits;
+    }
+    uint64_t index(uint32_t pc, uint64_t hist) const {
+      hist &= (h_bits < 64) ? ((1UL << h_bits) - 1) : ~(0UL);
+      uint64_t a = pc >> 2;
+      uint64_t i = a ^ (a >> (lg_entries + tbl_id)) ^ fold(hist, lg_entries);
+      return i & ((1UL << lg_entries) - 1);
+    }
+    uint32_t tag(uint32_t pc, uint64_t hist) const {
+      hist &= (h_bits < 64) ? ((1UL << h_bits) - 1) : ~(0UL);
+      uint64_t t = (pc >> 2) ^ fold(hist, tag_bits) ^ (fold(hist, tag_bits-1) << 1);
+      return t & ((1U << tag_bits) - 1);
+    }
+    tage_tbl_entry &at(uint64_t idx) {
+      return tbl[idx];
+    }
+    const tage_tbl_entry &at(uint64_t idx) const {
+      return tbl[idx];
+    }
+    void age() {
+      for(uint64_t i = 0, n = 1UL<<lg_entries; i < n; i++) {
+	tbl[i].useful >>= 1;
+      }
+    }
   };
-  
+
+  /* Seznec's TAGE : a bimodal base table plus tagged tables over
+   * geometrically longer histories. The provider is the hit with
+   * the longest history ; the next hit (or the base table) gives
+   * the alternate prediction, used instead of a newly allocated
+   * provider while use_alt_on_na says that pays off.
+   *
+   * pht_idx holds the history seen at predict, so update rebuilds
+   * the same indices and tags from it. */
   class tage : public branch_predictor {
   private:
+    static const int max_tbls = 16;
+    static const uint64_t lg_aging_period = 18;
+    struct lookup {
+      int provider = -1, alt = -1;
+      uint64_t idx[max_tbls];
+      uint32_t tag[max_tbls];
+      bool provider_pred = false, alt_pred = false;
+      bool weak = false;
+      bool pred = false;
+    };
     twobit_counter_array *bimode_tbl = nullptr;
     tage_tbl** tagged_tbls = nullptr;
+    int num_tbls = 0;
+    uint64_t hist_len = 0;
+    int use_alt_on_na = 0;
+    uint64_t updates = 0;
+    uint64_t alloc_seed = 1;
+
+    uint64_t base_idx(uint32_t pc) const {
+      return (pc >> 2) & ((1UL << sim_param::lg_tage_bimode_tbl_entries) - 1);
+    }
+    void do_lookup(uint32_t pc, uint64_t hist, lookup &l) const {
+      for(int i = num_tbls-1; i >= 0; i--) {
+	l.idx[i] = tagged_tbls[i]->index(pc, hist);
+	l.tag[i] = tagged_tbls[i]->tag(pc, hist);
+	if(tagged_tbls[i]->at(l.idx[i]).tag != l.tag[i]) {
+	  continue;
+	}
+	if(l.provider == -1) {
+	  l.provider = i;
+	}
+	else if(l.alt == -1) {
+	  l.alt = i;
+	}
+      }
+      uint32_t base_ctr = bimode_tbl->get_value(base_idx(pc));
+      bool base_pred = base_ctr > 1;
+      l.alt_pred = (l.alt == -1) ? base_pred :
+	(tagged_tbls[l.alt]->at(l.idx[l.alt]).pred >= 0);
+      if(l.provider == -1) {
+	l.provider_pred = l.pred = base_pred;
+	l.weak = (base_ctr == 1) or (base_ctr == 2);
+	return;
+      }
+      const auto &e = tagged_tbls[l.provider]->at(l.idx[l.provider]);
+      l.provider_pred = e.pred >= 0;
+      l.weak = (e.pred == 0) or (e.pred == -1);
+      l.pred = (l.weak and (e.useful == 0) and (use_alt_on_na >= 0)) ?
+	l.alt_pred : l.provider_pred;
+    }
+    void allocate(const lookup &l, bool taken) {
+      int n_free = 0;
+      for(int i = l.provider+1; i < num_tbls; i++) {
+	if(tagged_tbls[i]->at(l.idx[i]).useful == 0) {
+	  n_free++;
+	}
+      }
+      if(n_free == 0) {
+	for(int i = l.provider+1; i < num_tbls; i++) {
+	  tagged_tbls[i]->at(l.idx[i]).useful--;
+	}
+	return;
+      }
+      /* favor the shortest free history, but not always */
+      alloc_seed = alloc_seed * 6364136223846793005UL + 1442695040888963407UL;
+      int skip = ((alloc_seed >> 33) & 1) and (n_free > 1);
+      for(int i = l.provider+1; i < num_tbls; i++) {
+	auto &e = tagged_tbls[i]->at(l.idx[i]);
+	if(e.useful != 0) {
+	  continue;
+	}
+	if(skip) {
+	  skip--;
+	  continue;
+	}
+	e.tag = l.tag[i];
+	e.pred = taken ? 0 : -1;
+	return;
+      }
+    }
+    static void update_ctr(tage_tbl::tage_tbl_entry &e, bool taken) {
+      if(taken) {
+	e.pred = (e.pred == 3) ? 3 : (e.pred + 1);
+      }
+      else {
+	e.pred = (e.pred == -4) ? -4 : (e.pred - 1);
+      }
+    }
   public:
     tage(sim_state &ms) : branch_predictor(ms) {
+      num_tbls = sim_param::num_tage_tbls;
+      if(num_tbls > max_tbls) {
+	num_tbls = max_tbls;
+      }
+      hist_len = std::min(static_cast<uint64_t>(sim_param::bhr_length), 64UL);
       bimode_tbl = new twobit_counter_array(1UL<<sim_param::lg_tage_bimode_tbl_entries);
-      tagged_tbls = new tage_tbl*[sim_param::num_tage_tbls];
-      uint64_t tagged_len = 1UL<<sim_param::lg_tage_tagged_tbl_entries;
-      for(int i = 0; i < sim_param::num_tage_tbls; i++) {
-	/* power of 2 geometric series */
-	tagged_tbls[i] = new tage_tbl(tagged_len, i, 1UL<<(i+1));
+      tagged_tbls = new tage_tbl*[num_tbls];
+      /* geometric series from 4 bits up to the whole bhr */
+      const double min_h = std::min(4.0, static_cast<double>(hist_len));
+      for(int i = 0; i < num_tbls; i++) {
+	double h = (num_tbls == 1) ? hist_len :
+	  min_h * std::pow(hist_len / min_h, static_cast<double>(i) / (num_tbls-1));
+	tagged_tbls[i] = new tage_tbl(sim_param::lg_tage_tagged_tbl_entries, i,
+				      static_cast<uint64_t>(h + 0.5));
       }
     }
     ~tage() {
-      for(int i = 0; i < sim_param::num_tage_tbls; i++) {
-	delete [] tagged_tbls;
+      for(int i = 0; i < num_tbls; i++) {
+	delete tagged_tbls[i];
       }
       delete [] tagged_tbls;
       delete bimode_tbl;
     }
-    
+    uint32_t predict(uint64_t &idx) const override {
+      lookup l;
+      idx = machine_state.bhr.low_bits(hist_len);
+      do_lookup(machine_state.fetch_pc, idx, l);
+      if(l.pred) {
+	return l.weak ? 2 : 3;
+      }
+      return l.weak ? 1 : 0;
+    }
+    void update(uint32_t addr, uint64_t idx, bool taken) override {
+      lookup l;
+      do_lookup(addr, idx, l);
+      if(l.provider != -1) {
+	auto &e = tagged_tbls[l.provider]->at(l.idx[l.provider]);
+	if(l.weak and (e.useful == 0) and (l.provider_pred != l.alt_pred)) {
+	  use_alt_on_na += (l.alt_pred == taken) ? 1 : -1;
+	  use_alt_on_na = std::max(-8, std::min(7, use_alt_on_na));
+	}
+	if(l.provider_pred != l.alt_pred) {
+	  if(l.provider_pred == taken) {
+	    e.useful = (e.useful == 3) ? 3 : (e.useful + 1);
+	  }
+	  else {
+	    e.useful = (e.useful == 0) ? 0 : (e.useful - 1);
+	  }
+	}
+	if(e.useful == 0) {
+	  if(l.alt == -1) {
+	    bimode_tbl->update(base_idx(addr), taken);
+	  }
+	  else {
+	    update_ctr(tagged_tbls[l.alt]->at(l.idx[l.alt]), taken);
+	  }
+	}
+	update_ctr(e, taken);
+      }
+      else {
+	bimode_tbl->update(base_idx(addr), taken);
+      }
+      if((l.pred != taken) and (l.provider < (num_tbls-1))) {
+	allocate(l, taken);
+      }
+      if((++updates & ((1UL << lg_aging_period) - 1)) == 0) {
+	for(int i = 0; i < num_tbls; i++) {
+	  tagged_tbls[i]->age();
+	}
+      }
+    }
   };
   
   class gshare : public branch_predictor {
@@ -190,6 +378,8 @@ branch_predictor* branch_predictor::get_predictor(int id, sim_state &ms) {
       return new gnoalias(ms);
     case 9:
       return new bimode(ms);
+    case 10:
+      return new tage(ms);
     default:
       break;
     }
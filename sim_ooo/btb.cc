@@ -0,0 +1,79 @@
+#include <cassert>
+
+#include "btb.hh"
+#include "helper.hh"
+
+branch_target_buffer::branch_target_buffer(uint32_t n_entries, uint32_t n_ways, uint32_t tag_bits, int repl) :
+  n_ways(n_ways), repl(static_cast<replacement>(repl)) {
+  assert(isPow2(n_entries) and isPow2(n_ways) and (n_ways <= n_entries));
+  if(repl < 0 or repl > static_cast<int>(replacement::random)) {
+    die();
+  }
+  n_sets = n_entries / n_ways;
+  lg_sets = ln2(n_sets);
+  if(tag_bits != 0 and tag_bits < 32) {
+    tag_mask = (1U << tag_bits) - 1;
+  }
+  arr.resize(n_entries);
+}
+
+branch_target_buffer::entry *branch_target_buffer::find(uint32_t pc) {
+  entry *set = &arr[set_of(pc) * n_ways];
+  uint32_t t = tag_of(pc);
+  for(uint32_t w = 0; w < n_ways; w++) {
+    if(set[w].valid and (set[w].tag == t)) {
+      return &set[w];
+    }
+  }
+  return nullptr;
+}
+
+bool branch_target_buffer::lookup(uint32_t pc, uint32_t &target) {
+  entry *e = find(pc);
+  if(e == nullptr) {
+    misses++;
+    return false;
+  }
+  hits++;
+  if(repl == replacement::lru) {
+    e->stamp = ++clock;
+  }
+  target = e->target;
+  return true;
+}
+
+void branch_target_buffer::update(uint32_t pc, uint32_t target) {
+  entry *e = find(pc);
+  if(e) {
+    if(e->target != target) {
+      target_mispredicts++;
+      e->target = target;
+    }
+    return;
+  }
+  entry *set = &arr[set_of(pc) * n_ways];
+  entry *v = nullptr;
+  for(uint32_t w = 0; w < n_ways and v == nullptr; w++) {
+    if(not(set[w].valid)) {
+      v = &set[w];
+    }
+  }
+  if(v == nullptr) {
+    if(repl == replacement::random) {
+      seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+      v = &set[(seed >> 33) % n_ways];
+    }
+    else {
+      v = &set[0];
+      for(uint32_t w = 1; w < n_ways; w++) {
+	if(set[w].stamp < v->stamp) {
+	  v = &set[w];
+	}
+      }
+    }
+  }
+  v->valid = true;
+  v->tag = tag_of(pc);
+  v->target = target;
+  v->stamp = ++clock;
+}
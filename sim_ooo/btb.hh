@@ -0,0 +1,49 @@
+#ifndef __btb_hh__
+#define __btb_hh__
+
+#include <cstdint>
+#include <vector>
+
+/* set-associative branch target buffer, looked up at fetch and
+ * trained at retire */
+class branch_target_buffer {
+public:
+  enum class replacement {lru = 0, fifo = 1, random = 2};
+private:
+  struct entry {
+    bool valid = false;
+    uint32_t tag = 0;
+    uint32_t target = 0;
+    /* last use for lru, fill time for fifo */
+    uint64_t stamp = 0;
+  };
+  uint32_t n_sets = 1, n_ways = 1, lg_sets = 0;
+  uint32_t tag_mask = ~(0U);
+  replacement repl = replacement::lru;
+  std::vector<entry> arr;
+  uint64_t clock = 0, seed = 1;
+  uint64_t hits = 0, misses = 0, target_mispredicts = 0;
+  uint32_t set_of(uint32_t pc) const {
+    return (pc >> 2) & (n_sets-1);
+  }
+  uint32_t tag_of(uint32_t pc) const {
+    return ((pc >> 2) >> lg_sets) & tag_mask;
+  }
+  entry *find(uint32_t pc);
+public:
+  /* tag_bits of 0 keeps full tags */
+  branch_target_buffer(uint32_t n_entries, uint32_t n_ways, uint32_t tag_bits, int repl);
+  bool lookup(uint32_t pc, uint32_t &target);
+  void update(uint32_t pc, uint32_t target);
+  uint64_t get_hits() const {
+    return hits;
+  }
+  uint64_t get_misses() const {
+    return misses;
+  }
+  uint64_t get_target_mispredicts() const {
+    return target_mispredicts;
+  }
+};
+
+#endif
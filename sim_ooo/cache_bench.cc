@@ -0,0 +1,133 @@
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <boost/program_options.hpp>
+#include "sim_cache.hh"
+
+using namespace std;
+
+struct ref_t {
+  uint32_t addr;
+  uint8_t kind;
+};
+
+enum {REF_READ = 0, REF_WRITE, REF_FLUSH};
+
+/* a mix of sequential, strided and random references over the
+ * footprint, with some stores and an occasional line flush */
+static void make_refs(vector<ref_t> &refs, size_t n, uint32_t footprint, uint32_t seed) {
+  mt19937 rng(seed);
+  uint32_t seq = 0, strided = 0;
+  refs.resize(n);
+  for(size_t i = 0; i < n; i++) {
+    uint32_t r = rng(), a = 0;
+    switch(r & 3)
+      {
+      case 0:
+	a = seq;
+	seq += 4;
+	break;
+      case 1:
+	a = strided;
+	strided += 4096 + 64;
+	break;
+      default:
+	a = rng();
+	break;
+      }
+    refs[i].addr = (a % footprint) & ~3U;
+    r >>= 2;
+    refs[i].kind = ((r % 1024) == 0) ? REF_FLUSH : ((r % 8) < 3) ? REF_WRITE : REF_READ;
+  }
+}
+
+static double run(simCache *c, const vector<ref_t> &refs, vector<uint8_t> &out) {
+  auto start = chrono::steady_clock::now();
+  for(size_t i = 0; i < refs.size(); i++) {
+    const ref_t &r = refs[i];
+    uint32_t lat = 0;
+    switch(r.kind)
+      {
+      case REF_FLUSH:
+	c->flush_line(r.addr);
+	out[i] = 2;
+	break;
+      case REF_WRITE:
+	out[i] = c->access(r.addr, 4, opType::WRITE, lat);
+	break;
+      default:
+	out[i] = c->access(r.addr, 4, opType::READ, lat);
+	break;
+      }
+  }
+  auto stop = chrono::steady_clock::now();
+  return chrono::duration<double>(stop - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  namespace po = boost::program_options;
+  size_t sets = 0, assoc = 0, linesize = 0, n = 0;
+  uint32_t footprint = 0, seed = 0;
+  try {
+    po::options_description desc("options");
+    desc.add_options()
+      ("sets", po::value<size_t>(&sets)->default_value(64), "l1 sets")
+      ("assoc", po::value<size_t>(&assoc)->default_value(8), "l1 and l2 assoc")
+      ("linesize", po::value<size_t>(&linesize)->default_value(64), "line size")
+      ("footprint,f", po::value<uint32_t>(&footprint)->default_value(1U<<22), "bytes touched")
+      ("refs,n", po::value<size_t>(&n)->default_value(1UL<<24), "references")
+      ("seed", po::value<uint32_t>(&seed)->default_value(1), "rng seed")
+      ;
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  }
+  catch(po::error &e) {
+    cerr << "command-line error : " << e.what() << "\n";
+    return -1;
+  }
+  vector<ref_t> refs;
+  make_refs(refs, n, footprint, seed);
+
+  /* same two level hierarchy for each engine ; the l2 catches the
+   * writebacks */
+  simCache *l2_list = new setAssocCache(linesize, assoc, 8*sets, "l2", 10, nullptr);
+  simCache *l1_list = new setAssocCache(linesize, assoc, sets, "l1", 1, l2_list);
+  simCache *l2_flat = new flatSetAssocCache(linesize, assoc, 8*sets, "l2", 10, nullptr);
+  simCache *l1_flat = new flatSetAssocCache(linesize, assoc, sets, "l1", 1, l2_flat);
+
+  vector<uint8_t> out_list(n), out_flat(n);
+  double t_list = run(l1_list, refs, out_list);
+  double t_flat = run(l1_flat, refs, out_flat);
+
+  size_t first_diff = n;
+  for(size_t i = 0; i < n; i++) {
+    if(out_list[i] != out_flat[i]) {
+      first_diff = i;
+      break;
+    }
+  }
+  stringstream s_list, s_flat;
+  s_list << *l1_list;
+  s_flat << *l1_flat;
+
+  cout << n << " refs, l1 " << l1_list->capacity() << " bytes "
+       << assoc << " way, l2 " << l2_list->capacity() << " bytes\n";
+  cout << "l1 hits " << l1_list->getHits() << " misses " << l1_list->getMisses() << "\n";
+  cout << "list : " << t_list << " s, " << (1e9 * t_list / n) << " ns/ref\n";
+  cout << "flat : " << t_flat << " s, " << (1e9 * t_flat / n) << " ns/ref\n";
+  cout << "speedup : " << (t_list / t_flat) << "\n";
+  bool same = (first_diff == n) and (s_list.str() == s_flat.str());
+  if(first_diff != n) {
+    cout << "first differing reference " << first_diff << "\n";
+  }
+  cout << (same ? "results match\n" : "RESULTS DIFFER\n");
+
+  delete l1_list;
+  delete l2_list;
+  delete l1_flat;
+  delete l2_flat;
+  return same ? 0 : 1;
+}
@@ -0,0 +1,968 @@
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <sys/mman.h>
+
+#include "dbt.hh"
+#include "interpret.hh"
+#include "state.hh"
+#include "helper.hh"
+
+#if defined(__x86_64__)
+
+namespace {
+
+enum hreg : int {
+  rax = 0, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+  r8, r9, r10, r11, r12, r13, r14, r15
+};
+
+enum hcond : int {
+  cc_b = 0x2, cc_ae = 0x3, cc_e = 0x4, cc_ne = 0x5,
+  cc_l = 0xc, cc_ge = 0xd, cc_le = 0xe, cc_g = 0xf
+};
+
+/* group 1 and shift opcode extensions */
+enum { alu_add = 0, alu_or = 1, alu_and = 4, alu_sub = 5, alu_xor = 6, alu_cmp = 7 };
+enum { sh_shl = 4, sh_shr = 5, sh_sar = 7 };
+
+/* only the x86-64 encodings the translator needs */
+class emitter {
+  uint8_t *ptr;
+public:
+  emitter(uint8_t *ptr) : ptr(ptr) {}
+  uint8_t *pos() const {
+    return ptr;
+  }
+  void b(uint8_t v) {
+    *ptr++ = v;
+  }
+  void d(uint32_t v) {
+    memcpy(ptr, &v, 4);
+    ptr += 4;
+  }
+  void q(uint64_t v) {
+    memcpy(ptr, &v, 8);
+    ptr += 8;
+  }
+  void rex(bool w, int r, int m) {
+    uint8_t v = 0x40 | (w << 3) | ((r >> 3) << 2) | (m >> 3);
+    if(v != 0x40) {
+      b(v);
+    }
+  }
+  void opc(uint32_t op) {
+    if(op > 0xff) {
+      b(op >> 8);
+    }
+    b(op & 0xff);
+  }
+  /* op reg, [base + disp32] */
+  void op_m(bool w, uint32_t op, int reg, int base, int32_t disp) {
+    rex(w, reg, base);
+    opc(op);
+    b(0x80 | ((reg & 7) << 3) | (base & 7));
+    if((base & 7) == rsp) {
+      b(0x24);
+    }
+    d(disp);
+  }
+  /* op reg, rm */
+  void op_r(bool w, uint32_t op, int reg, int rm) {
+    rex(w, reg, rm);
+    opc(op);
+    b(0xc0 | ((reg & 7) << 3) | (rm & 7));
+  }
+  void load32(int r, int base, int32_t disp) {
+    op_m(false, 0x8b, r, base, disp);
+  }
+  void load64(int r, int base, int32_t disp) {
+    op_m(true, 0x8b, r, base, disp);
+  }
+  void store32(int base, int32_t disp, int r) {
+    op_m(false, 0x89, r, base, disp);
+  }
+  void store16(int base, int32_t disp, int r) {
+    b(0x66);
+    op_m(false, 0x89, r, base, disp);
+  }
+  void store8(int base, int32_t disp, int r) {
+    op_m(false, 0x88, r, base, disp);
+  }
+  void store32_imm(int base, int32_t disp, uint32_t imm) {
+    op_m(false, 0xc7, 0, base, disp);
+    d(imm);
+  }
+  void add64_m_imm(int base, int32_t disp, int32_t imm) {
+    op_m(true, 0x81, alu_add, base, disp);
+    d(imm);
+  }
+  void mov_imm32(int r, uint32_t imm) {
+    rex(false, 0, r);
+    b(0xb8 | (r & 7));
+    d(imm);
+  }
+  void mov_imm64(int r, uint64_t imm) {
+    rex(true, 0, r);
+    b(0xb8 | (r & 7));
+    q(imm);
+  }
+  void mov(int dst, int src) {
+    op_r(false, 0x89, src, dst);
+  }
+  void mov64(int dst, int src) {
+    op_r(true, 0x89, src, dst);
+  }
+  void add64(int dst, int src) {
+    op_r(true, 0x01, src, dst);
+  }
+  /* add, or, and, sub, xor, cmp reg, [base + disp32] */
+  void alu_m(int ext, int r, int base, int32_t disp) {
+    op_m(false, 8*ext + 3, r, base, disp);
+  }
+  void alu_imm(int ext, int r, uint32_t imm) {
+    op_r(false, 0x81, ext, r);
+    d(imm);
+  }
+  void alu_m_imm(int ext, int base, int32_t disp, uint32_t imm) {
+    op_m(false, 0x81, ext, base, disp);
+    d(imm);
+  }
+  void cmp64_m(int r, int base, int32_t disp) {
+    op_m(true, 0x3b, r, base, disp);
+  }
+  void shift_imm(int ext, int r, uint8_t n) {
+    op_r(false, 0xc1, ext, r);
+    b(n);
+  }
+  void shift_cl(int ext, int r) {
+    op_r(false, 0xd3, ext, r);
+  }
+  void not32(int r) {
+    op_r(false, 0xf7, 2, r);
+  }
+  /* edx:eax = eax * [base + disp32] ; 4 unsigned, 5 signed */
+  void mul_m(int ext, int base, int32_t disp) {
+    op_m(false, 0xf7, ext, base, disp);
+  }
+  void test_imm(int r, uint32_t imm) {
+    op_r(false, 0xf7, 0, r);
+    d(imm);
+  }
+  void test(int r0, int r1) {
+    op_r(false, 0x85, r1, r0);
+  }
+  void cmov(int cc, int dst, int src) {
+    op_r(false, 0x0f40 | cc, dst, src);
+  }
+  void setcc(int cc, int r) {
+    op_r(false, 0x0f90 | cc, 0, r);
+  }
+  void bt_imm(int r, uint8_t n) {
+    op_r(false, 0x0fba, 4, r);
+    b(n);
+  }
+  void bswap(int r) {
+    rex(false, 0, r);
+    b(0x0f);
+    b(0xc8 | (r & 7));
+  }
+  void rol16(int r, uint8_t n) {
+    b(0x66);
+    op_r(false, 0xc1, 0, r);
+    b(n);
+  }
+  void movzx8(int dst, int src) {
+    op_r(false, 0x0fb6, dst, src);
+  }
+  void movzx16(int dst, int src) {
+    op_r(false, 0x0fb7, dst, src);
+  }
+  void movsx16(int dst, int src) {
+    op_r(false, 0x0fbf, dst, src);
+  }
+  void movzx8_m(int r, int base, int32_t disp) {
+    op_m(false, 0x0fb6, r, base, disp);
+  }
+  void movsx8_m(int r, int base, int32_t disp) {
+    op_m(false, 0x0fbe, r, base, disp);
+  }
+  void movzx16_m(int r, int base, int32_t disp) {
+    op_m(false, 0x0fb7, r, base, disp);
+  }
+  void push(int r) {
+    rex(false, 0, r);
+    b(0x50 | (r & 7));
+  }
+  void pop(int r) {
+    rex(false, 0, r);
+    b(0x58 | (r & 7));
+  }
+  void call_r(int r) {
+    rex(false, 0, r);
+    b(0xff);
+    b(0xd0 | (r & 7));
+  }
+  void call(const void *fn) {
+    mov_imm64(rax, reinterpret_cast<uint64_t>(fn));
+    call_r(rax);
+  }
+  void ret() {
+    b(0xc3);
+  }
+  /* forward rel32 branches, patched by bind */
+  uint8_t *jcc(int cc) {
+    b(0x0f);
+    b(0x80 | cc);
+    d(0);
+    return ptr - 4;
+  }
+  uint8_t *jmp() {
+    b(0xe9);
+    d(0);
+    return ptr - 4;
+  }
+  void bind(uint8_t *at) {
+    int32_t rel = static_cast<int32_t>(ptr - (at + 4));
+    memcpy(at, &rel, 4);
+  }
+};
+
+inline uint32_t opcode(uint32_t inst) {
+  return inst >> 26;
+}
+inline uint32_t funct(uint32_t inst) {
+  return inst & 63;
+}
+inline uint32_t rs(uint32_t inst) {
+  return (inst >> 21) & 31;
+}
+inline uint32_t rt(uint32_t inst) {
+  return (inst >> 16) & 31;
+}
+inline uint32_t rd(uint32_t inst) {
+  return (inst >> 11) & 31;
+}
+inline int32_t simm(uint32_t inst) {
+  return (int32_t)((int16_t)(inst & ((1<<16) - 1)));
+}
+inline uint32_t uimm(uint32_t inst) {
+  return inst & ((1<<16) - 1);
+}
+
+/* monitor calls, syscall and break go back to the interpreter */
+bool ends_block(uint32_t inst) {
+  if(opcode(inst) != 0) {
+    return false;
+  }
+  uint32_t f = funct(inst);
+  return (f == 0x05) or (f == 0x0c) or (f == 0x0d);
+}
+
+bool is_syscall(uint32_t inst) {
+  return (opcode(inst) == 0) and (funct(inst) == 0x0c);
+}
+
+bool is_control(uint32_t inst) {
+  switch(opcode(inst))
+    {
+    case 0x00:
+      return (funct(inst) == 0x08) or (funct(inst) == 0x09);
+    case 0x01:
+    case 0x02:
+    case 0x03:
+    case 0x04:
+    case 0x05:
+    case 0x06:
+    case 0x07:
+    case 0x14:
+    case 0x15:
+    case 0x16:
+    case 0x17:
+      return true;
+    case 0x11:
+      return rs(inst) == 0x8;
+    default:
+      return false;
+    }
+}
+
+/* base + offset stores, as the interpreter implements them */
+bool is_store(uint32_t inst) {
+  switch(opcode(inst))
+    {
+    case 0x28:
+    case 0x29:
+    case 0x2a:
+    case 0x2b:
+    case 0x2e:
+    case 0x38:
+    case 0x39:
+    case 0x3d:
+      return true;
+    default:
+      return false;
+    }
+}
+
+int helper_exec(state_t *s, uint32_t inst);
+
+class translator {
+public:
+  struct tlb_entry {
+    uint64_t tag;
+    uint8_t *page;
+  };
+  static const uint32_t lg_tlb_len = 8;
+  static const uint32_t tlb_len = 1U << lg_tlb_len;
+private:
+  typedef void (*enter_fn)(state_t *, tlb_entry *, tlb_entry *, const uint8_t *);
+  static const size_t code_len = 64UL << 20;
+  /* more than any one block can take */
+  static const size_t max_block_bytes = 64UL << 10;
+  static const int max_block_insns = 64;
+  static const uint32_t lg_lookup_len = 12;
+  static const uint32_t pgshift = 12;
+  static const uint32_t pgsize = 1U << pgshift;
+  static_assert(pgsize == sparse_mem::pgsize, "dbt page size");
+
+  struct block {
+    uint32_t pc = 0;
+    uint32_t ninsns = 0;
+    uint64_t epoch = 0;
+    const uint8_t *code = nullptr;
+    /* every guest word read while translating */
+    std::vector<uint32_t> words;
+  };
+
+  uint8_t *code = nullptr;
+  size_t code_start = 0, code_used = 0;
+  enter_fn enter = nullptr;
+  std::unordered_map<uint32_t, block> blocks;
+  std::vector<block*> lookup;
+  std::vector<uint8_t> code_pages;
+  tlb_entry rtlb[tlb_len], wtlb[tlb_len];
+  const sparse_mem *mem = nullptr;
+  /* bumped whenever guest code may have been written behind the
+   * translator's back ; blocks recheck their words once per epoch */
+  uint64_t epoch = 1;
+  int32_t off_gpr = 0, off_pc = 0, off_icnt = 0;
+  int32_t off_hi = 0, off_lo = 0, off_cr25 = 0;
+
+  int32_t gpr(uint32_t r) const {
+    return off_gpr + 4*r;
+  }
+  void flush_tlbs() {
+    for(uint32_t i = 0; i < tlb_len; i++) {
+      rtlb[i].tag = wtlb[i].tag = ~(0UL);
+      rtlb[i].page = wtlb[i].page = nullptr;
+    }
+  }
+  void mark_code(uint32_t pc) {
+    uint32_t pg = pc >> pgshift;
+    if(code_pages[pg]) {
+      return;
+    }
+    code_pages[pg] = 1;
+    tlb_entry &w = wtlb[pg & (tlb_len-1)];
+    if(w.tag == pg) {
+      w.tag = ~(0UL);
+    }
+  }
+  void flush() {
+    blocks.clear();
+    std::fill(lookup.begin(), lookup.end(), nullptr);
+    std::fill(code_pages.begin(), code_pages.end(), 0);
+    code_used = code_start;
+    flush_tlbs();
+  }
+  bool unchanged(state_t *s, const block &b) const {
+    for(size_t i = 0; i < b.words.size(); i++) {
+      if(bswap(s->mem.get32(b.pc + 4*i)) != b.words[i]) {
+	return false;
+      }
+    }
+    return true;
+  }
+  void exit_block(emitter &e, uint32_t npc, bool in_ds, int executed) {
+    if(in_ds) {
+      e.store32(rbx, off_pc, r12);
+    }
+    else {
+      e.store32_imm(rbx, off_pc, npc);
+    }
+    e.add64_m_imm(rbx, off_icnt, executed);
+    e.ret();
+  }
+  void emit_helper(emitter &e, uint32_t pc, uint32_t inst, bool in_ds, int executed);
+  void emit_mem(emitter &e, uint32_t pc, uint32_t inst, bool in_ds, int executed);
+  void emit_insn(emitter &e, uint32_t pc, uint32_t inst, bool in_ds, int executed);
+  void emit_branch(emitter &e, uint32_t pc, uint32_t inst, uint32_t ds_inst, int n);
+  block *translate(state_t *s, uint32_t pc);
+public:
+  translator();
+  ~translator();
+  bool ok() const {
+    return code != nullptr;
+  }
+  void begin(state_t *s);
+  const block *find(state_t *s, uint32_t pc);
+  void run(state_t *s, const block *b) {
+    enter(s, rtlb, wtlb, b->code);
+  }
+  void invalidate() {
+    epoch++;
+  }
+  bool fill(uint32_t ea, bool store);
+  static uint32_t ninsns(const block *b) {
+    return b->ninsns;
+  }
+  static bool translated(const block *b) {
+    return b->code != nullptr;
+  }
+};
+
+thread_local std::unique_ptr<translator> xlat;
+
+translator::translator() : lookup(1UL << lg_lookup_len, nullptr),
+			   code_pages(1UL << (32 - pgshift), 0) {
+  void *m = mmap(nullptr, code_len, PROT_READ|PROT_WRITE|PROT_EXEC,
+		 MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if(m == MAP_FAILED) {
+    return;
+  }
+  code = reinterpret_cast<uint8_t*>(m);
+  /* enter(state, rtlb, wtlb, block) : rbx holds the state, r12 the
+   * pc after a delay slot, r13 / r14 the read and write tlbs. An
+   * even number of pushes keeps helper calls 16-byte aligned */
+  emitter e(code);
+  e.push(rbx);
+  e.push(r12);
+  e.push(r13);
+  e.push(r14);
+  e.mov64(rbx, rdi);
+  e.mov64(r13, rsi);
+  e.mov64(r14, rdx);
+  e.call_r(rcx);
+  e.pop(r14);
+  e.pop(r13);
+  e.pop(r12);
+  e.pop(rbx);
+  e.ret();
+  enter = reinterpret_cast<enter_fn>(code);
+  code_start = code_used = e.pos() - code;
+  flush_tlbs();
+}
+
+translator::~translator() {
+  if(code) {
+    munmap(code, code_len);
+  }
+}
+
+void translator::begin(state_t *s) {
+  if(off_pc == 0) {
+    const uint8_t *base = reinterpret_cast<const uint8_t*>(s);
+    auto off = [base](const void *p) {
+      return static_cast<int32_t>(reinterpret_cast<const uint8_t*>(p) - base);
+    };
+    off_gpr = off(&s->gpr[0]);
+    off_pc = off(&s->pc);
+    off_icnt = off(&s->icnt);
+    off_hi = off(&s->hi);
+    off_lo = off(&s->lo);
+    off_cr25 = off(&s->fcr1[CP1_CR25]);
+  }
+  if(&s->mem != mem) {
+    mem = &s->mem;
+    flush();
+  }
+  /* pages may have been shared or cleaned since the last run, and
+   * code written by the interpreter */
+  flush_tlbs();
+  epoch++;
+}
+
+bool translator::fill(uint32_t ea, bool store) {
+  uint32_t pg = ea >> pgshift;
+  if(store and (code_pages[pg] or code_pages[(ea+7) >> pgshift])) {
+    epoch++;
+    return true;
+  }
+  uint8_t *p = mem->owned_page(pg);
+  if(p == nullptr) {
+    return false;
+  }
+  tlb_entry &r = rtlb[pg & (tlb_len-1)];
+  r.tag = pg;
+  r.page = p;
+  if(store) {
+    tlb_entry &w = wtlb[pg & (tlb_len-1)];
+    w.tag = pg;
+    w.page = p;
+  }
+  return false;
+}
+
+const translator::block *translator::find(state_t *s, uint32_t pc) {
+  block *&c = lookup[(pc >> 2) & ((1U << lg_lookup_len) - 1)];
+  block *b = c;
+  if(b == nullptr or b->pc != pc) {
+    auto it = blocks.find(pc);
+    b = (it == blocks.end()) ? translate(s, pc) : &(it->second);
+  }
+  if(b->epoch != epoch) {
+    if(not(unchanged(s, *b))) {
+      b = translate(s, pc);
+    }
+    b->epoch = epoch;
+  }
+  c = b;
+  return b;
+}
+
+void translator::emit_helper(emitter &e, uint32_t pc, uint32_t inst,
+			     bool in_ds, int executed) {
+  e.store32_imm(rbx, off_pc, pc);
+  e.mov64(rdi, rbx);
+  e.mov_imm32(rsi, inst);
+  e.call(reinterpret_cast<const void*>(&helper_exec));
+  if(is_store(inst)) {
+    /* wrote a page holding translated code */
+    e.test(rax, rax);
+    uint8_t *ok = e.jcc(cc_e);
+    exit_block(e, pc+4, in_ds, executed);
+    e.bind(ok);
+  }
+}
+
+/* aligned accesses to pages in the tlb stay inline, everything
+ * else goes through the interpreter, which refills the tlb */
+void translator::emit_mem(emitter &e, uint32_t pc, uint32_t inst,
+			  bool in_ds, int executed) {
+  uint32_t op = opcode(inst);
+  bool store = is_store(inst);
+  uint32_t sz = 4;
+  switch(op)
+    {
+    case 0x20:
+    case 0x24:
+    case 0x28:
+      sz = 1;
+      break;
+    case 0x21:
+    case 0x25:
+    case 0x29:
+      sz = 2;
+      break;
+    default:
+      break;
+    }
+  if(store) {
+    e.load32(rcx, rbx, gpr(rt(inst)));
+    if(sz == 4) {
+      e.bswap(rcx);
+    }
+    else if(sz == 2) {
+      e.rol16(rcx, 8);
+    }
+  }
+  e.load32(rax, rbx, gpr(rs(inst)));
+  if(simm(inst) != 0) {
+    e.alu_imm(alu_add, rax, simm(inst));
+  }
+  uint8_t *unaligned = nullptr;
+  if(sz > 1) {
+    e.test_imm(rax, sz-1);
+    unaligned = e.jcc(cc_ne);
+  }
+  e.mov(rdx, rax);
+  e.shift_imm(sh_shr, rdx, pgshift);
+  e.mov(rsi, rdx);
+  e.alu_imm(alu_and, rdx, tlb_len-1);
+  e.shift_imm(sh_shl, rdx, 4);
+  e.add64(rdx, store ? r14 : r13);
+  e.cmp64_m(rsi, rdx, 0);
+  uint8_t *miss = e.jcc(cc_ne);
+  e.load64(rdx, rdx, 8);
+  e.alu_imm(alu_and, rax, pgsize-1);
+  e.add64(rdx, rax);
+  switch(op)
+    {
+    case 0x20: /* lb */
+      e.movsx8_m(rax, rdx, 0);
+      break;
+    case 0x24: /* lbu */
+      e.movzx8_m(rax, rdx, 0);
+      break;
+    case 0x21: /* lh */
+      e.movzx16_m(rax, rdx, 0);
+      e.rol16(rax, 8);
+      e.movsx16(rax, rax);
+      break;
+    case 0x25: /* lhu */
+      e.movzx16_m(rax, rdx, 0);
+      e.rol16(rax, 8);
+      e.movzx16(rax, rax);
+      break;
+    case 0x23: /* lw */
+    case 0x30: /* ll */
+      e.load32(rax, rdx, 0);
+      e.bswap(rax);
+      break;
+    case 0x28: /* sb */
+      e.store8(rdx, 0, rcx);
+      break;
+    case 0x29: /* sh */
+      e.store16(rdx, 0, rcx);
+      break;
+    case 0x2b: /* sw */
+      e.store32(rdx, 0, rcx);
+      break;
+    default:
+      die();
+    }
+  if(not(store)) {
+    e.store32(rbx, gpr(rt(inst)), rax);
+  }
+  uint8_t *done = e.jmp();
+  if(unaligned) {
+    e.bind(unaligned);
+  }
+  e.bind(miss);
+  emit_helper(e, pc, inst, in_ds, executed);
+  e.bind(done);
+}
+
+/* executed counts the instructions retired once this one is done */
+void translator::emit_insn(emitter &e, uint32_t pc, uint32_t inst,
+			   bool in_ds, int executed) {
+  const uint32_t s = rs(inst), t = rt(inst), d = rd(inst);
+  switch(opcode(inst))
+    {
+    case 0x00:
+      switch(funct(inst))
+	{
+	case 0x00: /* sll */
+	case 0x02: /* srl */
+	case 0x03: { /* sra */
+	  static const int ext[4] = {sh_shl, 0, sh_shr, sh_sar};
+	  e.load32(rax, rbx, gpr(t));
+	  e.shift_imm(ext[funct(inst)], rax, (inst >> 6) & 31);
+	  e.store32(rbx, gpr(d), rax);
+	  return;
+	}
+	case 0x04: /* sllv */
+	case 0x06: /* srlv */
+	case 0x07: { /* srav */
+	  static const int ext[4] = {sh_shl, 0, sh_shr, sh_sar};
+	  e.load32(rcx, rbx, gpr(s));
+	  e.load32(rax, rbx, gpr(t));
+	  e.shift_cl(ext[funct(inst) & 3], rax);
+	  e.store32(rbx, gpr(d), rax);
+	  return;
+	}
+	case 0x0A: /* movz */
+	case 0x0B: /* movn */
+	  e.load32(rax, rbx, gpr(t));
+	  e.test(rax, rax);
+	  e.load32(rcx, rbx, gpr(d));
+	  e.load32(rdx, rbx, gpr(s));
+	  e.cmov(funct(inst) == 0x0A ? cc_e : cc_ne, rcx, rdx);
+	  e.store32(rbx, gpr(d), rcx);
+	  return;
+	case 0x0f: /* sync */
+	  return;
+	case 0x10: /* mfhi */
+	  e.load32(rax, rbx, off_hi);
+	  e.store32(rbx, gpr(d), rax);
+	  return;
+	case 0x11: /* mthi */
+	  e.load32(rax, rbx, gpr(s));
+	  e.store32(rbx, off_hi, rax);
+	  return;
+	case 0x12: /* mflo */
+	  e.load32(rax, rbx, off_lo);
+	  e.store32(rbx, gpr(d), rax);
+	  return;
+	case 0x13: /* mtlo */
+	  e.load32(rax, rbx, gpr(s));
+	  e.store32(rbx, off_lo, rax);
+	  return;
+	case 0x18: /* mult */
+	case 0x19: /* multu */
+	  e.load32(rax, rbx, gpr(s));
+	  e.mul_m(funct(inst) == 0x18 ? 5 : 4, rbx, gpr(t));
+	  e.store32(rbx, off_lo, rax);
+	  e.store32(rbx, off_hi, rdx);
+	  return;
+	case 0x20: /* add */
+	case 0x21: /* addu */
+	  e.load32(rax, rbx, gpr(s));
+	  e.alu_m(alu_add, rax, rbx, gpr(t));
+	  e.store32(rbx, gpr(d), rax);
+	  return;
+	case 0x23: /* subu */
+	  e.load32(rax, rbx, gpr(s));
+	  e.alu_m(alu_sub, rax, rbx, gpr(t));
+	  e.store32(rbx, gpr(d), rax);
+	  return;
+	case 0x24: /* and */
+	case 0x25: /* or */
+	case 0x26: /* xor */
+	case 0x27: { /* nor */
+	  static const int ext[4] = {alu_and, alu_or, alu_xor, alu_or};
+	  e.load32(rax, rbx, gpr(s));
+	  e.alu_m(ext[funct(inst) & 3], rax, rbx, gpr(t));
+	  if(funct(inst) == 0x27) {
+	    e.not32(rax);
+	  }
+	  e.store32(rbx, gpr(d), rax);
+	  return;
+	}
+	case 0x2A: /* slt */
+	case 0x2B: /* sltu */
+	  e.load32(rax, rbx, gpr(s));
+	  e.alu_m(alu_cmp, rax, rbx, gpr(t));
+	  e.setcc(funct(inst) == 0x2A ? cc_l : cc_b, rax);
+	  e.movzx8(rax, rax);
+	  e.store32(rbx, gpr(d), rax);
+	  return;
+	default:
+	  break;
+	}
+      break;
+    case 0x08: /* addi */
+    case 0x09: /* addiu */
+      e.load32(rax, rbx, gpr(s));
+      e.alu_imm(alu_add, rax, simm(inst));
+      e.store32(rbx, gpr(t), rax);
+      return;
+    case 0x0A: /* slti */
+    case 0x0B: /* sltiu */
+      e.load32(rax, rbx, gpr(s));
+      e.alu_imm(alu_cmp, rax, simm(inst));
+      e.setcc(opcode(inst) == 0x0A ? cc_l : cc_b, rax);
+      e.movzx8(rax, rax);
+      e.store32(rbx, gpr(t), rax);
+      return;
+    case 0x0C: /* andi */
+    case 0x0D: /* ori */
+    case 0x0E: { /* xori */
+      static const int ext[4] = {alu_and, alu_or, alu_xor, 0};
+      e.load32(rax, rbx, gpr(s));
+      e.alu_imm(ext[opcode(inst) & 3], rax, uimm(inst));
+      e.store32(rbx, gpr(t), rax);
+      return;
+    }
+    case 0x0F: /* lui */
+      e.store32_imm(rbx, gpr(t), uimm(inst) << 16);
+      return;
+    case 0x20:
+    case 0x21:
+    case 0x23:
+    case 0x24:
+    case 0x25:
+    case 0x28:
+    case 0x29:
+    case 0x2b:
+    case 0x30:
+      emit_mem(e, pc, inst, in_ds, executed);
+      return;
+    default:
+      break;
+    }
+  emit_helper(e, pc, inst, in_ds, executed);
+}
+
+/* leaves the pc after the delay slot in r12 before the delay slot
+ * runs, so the slot sees the branch's link register and the branch
+ * sees the registers from before the slot */
+void translator::emit_branch(emitter &e, uint32_t pc, uint32_t inst,
+			     uint32_t ds_inst, int n) {
+  uint32_t target = pc + 4 + (static_cast<uint32_t>(simm(inst)) << 2);
+  int cc = -1;
+  bool likely = false;
+  switch(opcode(inst))
+    {
+    case 0x00: /* jr, jalr */
+      e.load32(r12, rbx, gpr(rs(inst)));
+      if(funct(inst) == 0x09) {
+	e.store32_imm(rbx, gpr(31), pc+8);
+      }
+      break;
+    case 0x02: /* j */
+    case 0x03: /* jal */
+      if(opcode(inst) == 0x03) {
+	e.store32_imm(rbx, gpr(31), pc+8);
+      }
+      e.mov_imm32(r12, ((inst & ((1U<<26)-1)) << 2) | ((pc+4) & (~((1U<<28)-1))));
+      break;
+    case 0x01: { /* bltz, bgez, bltzl, bgezl */
+      static const int c[4] = {cc_l, cc_ge, cc_l, cc_ge};
+      e.alu_m_imm(alu_cmp, rbx, gpr(rs(inst)), 0);
+      cc = c[rt(inst) & 3];
+      likely = (rt(inst) & 2) != 0;
+      break;
+    }
+    case 0x04: /* beq */
+    case 0x05: /* bne */
+    case 0x14: /* beql */
+    case 0x15: /* bnel */
+      e.load32(rax, rbx, gpr(rs(inst)));
+      e.alu_m(alu_cmp, rax, rbx, gpr(rt(inst)));
+      cc = (opcode(inst) & 1) ? cc_ne : cc_e;
+      likely = (opcode(inst) & 0x10) != 0;
+      break;
+    case 0x06: /* blez */
+    case 0x07: /* bgtz */
+    case 0x16: /* blezl */
+    case 0x17: /* bgtzl */
+      e.alu_m_imm(alu_cmp, rbx, gpr(rs(inst)), 0);
+      cc = (opcode(inst) & 1) ? cc_g : cc_le;
+      likely = (opcode(inst) & 0x10) != 0;
+      break;
+    case 0x11: /* bc1f, bc1t, bc1fl, bc1tl */
+      e.load32(rax, rbx, off_cr25);
+      e.bt_imm(rax, (inst >> 18) & 7);
+      cc = (rt(inst) & 1) ? cc_b : cc_ae;
+      likely = (rt(inst) & 2) != 0;
+      break;
+    default:
+      die();
+    }
+  uint8_t *not_taken = nullptr;
+  if(cc != -1) {
+    if(likely) {
+      not_taken = e.jcc(cc ^ 1);
+      e.mov_imm32(r12, target);
+    }
+    else {
+      e.mov_imm32(r12, pc+8);
+      e.mov_imm32(rcx, target);
+      e.cmov(cc, r12, rcx);
+    }
+  }
+  emit_insn(e, pc+4, ds_inst, true, n+2);
+  exit_block(e, 0, true, n+2);
+  if(not_taken) {
+    /* likely branch falls through past its nullified slot */
+    e.bind(not_taken);
+    exit_block(e, pc+8, false, n+1);
+  }
+}
+
+translator::block *translator::translate(state_t *s, uint32_t start) {
+  if((code_len - code_used) < max_block_bytes) {
+    flush();
+  }
+  block &b = blocks[start];
+  b.pc = start;
+  b.epoch = epoch;
+  b.words.clear();
+  emitter e(code + code_used);
+  uint8_t *begin = e.pos();
+  uint32_t pc = start;
+  int n = 0;
+  bool closed = false;
+  while(n < max_block_insns) {
+    uint32_t inst = bswap(s->mem.get32(pc));
+    b.words.push_back(inst);
+    if(ends_block(inst)) {
+      break;
+    }
+    if(is_control(inst)) {
+      uint32_t ds_inst = bswap(s->mem.get32(pc+4));
+      b.words.push_back(ds_inst);
+      /* leave odd delay slots to the interpreter */
+      if(ends_block(ds_inst) or is_control(ds_inst)) {
+	break;
+      }
+      mark_code(pc);
+      mark_code(pc+4);
+      emit_branch(e, pc, inst, ds_inst, n);
+      n += 2;
+      closed = true;
+      break;
+    }
+    mark_code(pc);
+    emit_insn(e, pc, inst, false, n+1);
+    n++;
+    pc += 4;
+  }
+  b.ninsns = n;
+  if(n == 0) {
+    b.code = nullptr;
+    return &b;
+  }
+  if(not(closed)) {
+    exit_block(e, pc, false, n);
+  }
+  b.code = begin;
+  code_used = e.pos() - code;
+  assert((e.pos() - begin) < static_cast<ptrdiff_t>(max_block_bytes));
+  return &b;
+}
+
+/* slow path of translated code ; returns non-zero when a store
+ * hit a page with translated code, the block then exits */
+int helper_exec(state_t *s, uint32_t inst) {
+  uint32_t ea = s->gpr[rs(inst)] + simm(inst);
+  execInsn(inst, s);
+  if(opcode(inst) < 0x20) {
+    return 0;
+  }
+  return xlat->fill(ea, is_store(inst)) ? 1 : 0;
+}
+
+}
+
+bool dbtAvailable() {
+  if(xlat == nullptr) {
+    xlat.reset(new translator());
+  }
+  return xlat->ok();
+}
+
+void dbtRun(state_t *s, uint64_t maxicnt) {
+  if(s->brk) {
+    return;
+  }
+  if(not(dbtAvailable())) {
+    runMips(s, maxicnt);
+    return;
+  }
+  translator &t = *xlat;
+  t.begin(s);
+  do {
+    auto b = t.find(s, s->pc);
+    if(translator::translated(b) and ((s->icnt + translator::ninsns(b)) <= maxicnt)) {
+      t.run(s, b);
+    }
+    else {
+      uint32_t inst = bswap(s->mem.get32(s->pc));
+      bool sys = is_syscall(inst) or
+	(is_control(inst) and is_syscall(bswap(s->mem.get32(s->pc+4))));
+      execMips(s);
+      /* monitor calls and stores write guest memory */
+      t.invalidate();
+      if(sys) {
+	break;
+      }
+    }
+  } while((s->icnt < maxicnt) and not(s->brk));
+}
+
+#else
+
+bool dbtAvailable() {
+  return false;
+}
+
+void dbtRun(state_t *s, uint64_t maxicnt) {
+  runMips(s, maxicnt);
+}
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef __dbt_hh__
+#define __dbt_hh__
+
+#include <cstdint>
+
+struct state_t;
+
+/* Translates guest basic blocks to host code for functional
+ * fast-forward. Same contract as runMips ; hbuf is never written
+ * and the cache model is not driven, so callers that need either
+ * keep using the interpreter. On hosts without a backend this
+ * is runMips. */
+bool dbtAvailable();
+void dbtRun(state_t *s, uint64_t maxicnt);
+
+#endif
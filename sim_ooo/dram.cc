@@ -0,0 +1,102 @@
+#include <algorithm>
+
+#include "dram.hh"
+#include "sim_cache.hh"
+#include "sim_parameters.hh"
+#include "helper.hh"
+
+/* a burst moves 64 bytes, the column granularity of the mapping */
+static const uint32_t lg_burst_bytes = 6;
+
+dram_controller::dram_controller() {
+  const uint32_t row_bytes = sim_param::dram_row_bytes;
+  if(row_bytes < (1U << lg_burst_bytes)) {
+    die();
+  }
+  lg_channels = ln2(static_cast<uint32_t>(sim_param::dram_channels));
+  lg_cols = ln2(row_bytes) - lg_burst_bytes;
+  lg_banks = ln2(static_cast<uint32_t>(sim_param::dram_banks));
+  lg_ranks = ln2(static_cast<uint32_t>(sim_param::dram_ranks));
+  banks.resize(sim_param::dram_channels * sim_param::dram_ranks * sim_param::dram_banks);
+  channels.resize(sim_param::dram_channels);
+  for(channel &c : channels) {
+    c.queue.resize(sim_param::dram_queue_entries, 0);
+  }
+}
+
+/* address bits, low to high : burst offset, channel, column, bank,
+ * rank, row. a sequential stream alternates channels and stays in one
+ * row per bank */
+uint32_t dram_controller::access(uint32_t addr, uint32_t num_bytes, opType o, uint64_t t) {
+  uint32_t a = addr >> lg_burst_bytes;
+  const uint32_t ch = a & ((1U << lg_channels) - 1);
+  a >>= lg_channels + lg_cols;
+  const uint32_t bk = a & ((1U << lg_banks) - 1);
+  a >>= lg_banks;
+  const uint32_t rk = a & ((1U << lg_ranks) - 1);
+  const uint32_t row = a >> lg_ranks;
+  channel &c = channels[ch];
+  bank &b = banks[(((ch << lg_ranks) + rk) << lg_banks) + bk];
+  const uint32_t bursts = std::max(1U, num_bytes >> lg_burst_bytes);
+
+  if(o == opType::WRITE) {
+    writes++;
+  }
+  else {
+    reads++;
+  }
+
+  uint64_t start = t + sim_param::dram_ctrl_latency;
+  auto slot = std::min_element(c.queue.begin(), c.queue.end());
+  if(*slot > start) {
+    queue_stalls++;
+    start = *slot;
+  }
+
+  uint64_t col = 0;
+  if(b.open and (b.row == row)) {
+    row_hits++;
+    col = std::max(start, b.next_col);
+  }
+  else {
+    uint64_t act = std::max(start, b.next_col);
+    if(b.open) {
+      row_conflicts++;
+      act = std::max(act, b.act + sim_param::dram_tras) + sim_param::dram_trp;
+    }
+    else {
+      row_empty++;
+    }
+    b.open = true;
+    b.row = row;
+    b.act = act;
+    col = act + sim_param::dram_trcd;
+  }
+
+  const uint32_t xfer = bursts * sim_param::dram_tburst;
+  const uint64_t data = std::max(col + sim_param::dram_tcas, c.bus_free);
+  const uint64_t done = data + xfer;
+  c.bus_free = done;
+  b.next_col = col + xfer;
+  *slot = done;
+  bus_busy += xfer;
+  total_latency += done - t;
+  return done - t;
+}
+
+std::ostream &operator<<(std::ostream &out, const dram_controller &dram) {
+  const double reqs = static_cast<double>(dram.reads + dram.writes);
+  out << "dram:\n";
+  out << "channels = " << dram.channels.size() << "\n";
+  out << "banks = " << dram.banks.size() << "\n";
+  out << "reads = " << dram.reads << "\n";
+  out << "writes = " << dram.writes << "\n";
+  out << "row_hits = " << dram.row_hits << "\n";
+  out << "row_empty = " << dram.row_empty << "\n";
+  out << "row_conflicts = " << dram.row_conflicts << "\n";
+  out << "row_hit_rate = " << (dram.row_hits / reqs) << "\n";
+  out << "queue_stalls = " << dram.queue_stalls << "\n";
+  out << "avg_latency = " << (dram.total_latency / reqs) << "\n";
+  out << "bus_busy_cycles = " << dram.bus_busy << "\n";
+  return out;
+}
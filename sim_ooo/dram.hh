@@ -0,0 +1,46 @@
+#ifndef __dram_hh__
+#define __dram_hh__
+
+#include <cstdint>
+#include <vector>
+#include <iostream>
+
+enum class opType;
+
+/* dram behind the last cache level : channels of ranks of banks, each
+ * bank with an open row buffer. a request learns its latency when it
+ * arrives, so scheduling is decided then : row hits take the next
+ * column slot of the open row (first ready) and a conflict precharges
+ * only after the hits already scheduled to that row, everything else
+ * in arrival order. each channel has one data bus and a bounded
+ * request queue ; a full queue holds new requests until the oldest
+ * one completes */
+class dram_controller {
+private:
+  struct bank {
+    bool open = false;
+    uint32_t row = 0;
+    uint64_t act = 0;
+    uint64_t next_col = 0;
+  };
+  struct channel {
+    uint64_t bus_free = 0;
+    /* completion cycle of each queue entry */
+    std::vector<uint64_t> queue;
+  };
+  std::vector<bank> banks;
+  std::vector<channel> channels;
+  uint32_t lg_channels = 0, lg_cols = 0, lg_banks = 0, lg_ranks = 0;
+  uint64_t reads = 0, writes = 0;
+  uint64_t row_hits = 0, row_empty = 0, row_conflicts = 0;
+  uint64_t queue_stalls = 0, total_latency = 0, bus_busy = 0;
+public:
+  friend std::ostream &operator<<(std::ostream &out, const dram_controller &dram);
+  dram_controller();
+  /* cycles from arrival at t until the data is back */
+  uint32_t access(uint32_t addr, uint32_t num_bytes, opType o, uint64_t t);
+};
+
+std::ostream &operator<<(std::ostream &out, const dram_controller &dram);
+
+#endif
@@ -0,0 +1 @@
+const char *githash = "9eaeafd8ecf6d8a80d031c3d2eb7af92814443da";
@@ -5,14 +5,18 @@
 #include <ostream>
 
 namespace global {
+  /* describe the loaded program, shared by every simulation */
   extern bool enClockFuncts;
   extern int sysArgc;
   extern char **sysArgv;
-  extern std::ostream *sim_log;
-  extern bool use_interp_check;
-  extern uint64_t curr_cycle;
-  extern uint64_t pipestart;
-  extern uint64_t pipeend;
+  /* per-simulation ; a sim_instance installs its own values
+   * on the host thread that runs it */
+  extern thread_local std::ostream *sim_log;
+  extern thread_local bool use_interp_check;
+  extern thread_local bool use_dbt;
+  extern thread_local uint64_t curr_cycle;
+  extern thread_local uint64_t pipestart;
+  extern thread_local uint64_t pipeend;
 };
 
 inline uint64_t get_curr_cycle() {
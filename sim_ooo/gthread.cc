@@ -9,12 +9,12 @@ extern "C" {
   void switch_and_start_gthread_asm(uint64_t*,uint8_t*,void*,void*);
 };
 
-gthread::gthread_ptr gthread::head = nullptr;
-static gthread::gthread_ptr curr_thread = nullptr;
+thread_local gthread::gthread_ptr gthread::head = nullptr;
+static thread_local gthread::gthread_ptr curr_thread = nullptr;
 
-std::list<gthread::gthread_ptr> gthread::threads;
+thread_local std::list<gthread::gthread_ptr> gthread::threads;
 
-int64_t gthread::uuidcnt = 0;
+thread_local int64_t gthread::uuidcnt = 0;
 
 void start_gthreads()  {
   assert(gthread::valid_head());
@@ -26,9 +26,9 @@ private:
   typedef void (*callback_t)(void*);
   static const size_t stack_sz = 1<<21;
   enum class thread_status {uninitialized,ready,run};
-  static gthread_ptr head;
-  static std::list<gthread_ptr> threads;
-  static int64_t uuidcnt;
+  static thread_local gthread_ptr head;
+  static thread_local std::list<gthread_ptr> threads;
+  static thread_local int64_t uuidcnt;
   int64_t id = -1;
   callback_t fptr = nullptr;
   void *arg = nullptr;
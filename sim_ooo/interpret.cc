@@ -10,25 +10,20 @@
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <vector>
 
 #include "interpret.hh"
+#include "dbt.hh"
 #include "disassemble.hh"
 #include "sim_cache.hh"
 #include "helper.hh"
 #include "globals.hh"
 
 
-static timeval32_t myTimeVal = {0,0};
-static uint32_t myTime = 1<<20;
+static thread_local timeval32_t myTimeVal = {0,0};
+static thread_local uint32_t myTime = 1<<20;
 
 
-enum class branch_type {
-  beq, bne, blez, bgtz,
-  beql, bnel, blezl, bgtzl,
-  bgez, bgezl, bltz, bltzl,
-  bc1f, bc1t, bc1fl, bc1tl
-};
-
 static inline uint32_t getConditionCode(state_t *s, uint32_t cc) {
   return ((s->fcr1[CP1_CR25] & (1U<<cc)) >> cc) & 0x1;
 }
@@ -42,103 +37,6 @@ static inline void setConditionCode(state_t *s, uint32_t v, uint32_t cc) {
 }
 
 
-template <branch_type bt>
-void branch(uint32_t inst, state_t *s) {
-  uint32_t rt = (inst >> 16) & 31;
-  uint32_t rs = (inst >> 21) & 31;
-  int16_t himm = (int16_t)(inst & ((1<<16) - 1));
-  int32_t imm = ((int32_t)himm) << 2;
-  uint32_t npc = s->pc+4; 
-  bool isLikely = false, takeBranch = false;
-  s->hbuf[(s->icnt-1)%HWINDOW].was_branch_or_jump = true;
-  switch(bt)
-    {
-    case branch_type::beql:
-      isLikely = true;
-    case branch_type::beq:
-      takeBranch = (s->gpr[rt] == s->gpr[rs]);
-      break;
-    case branch_type::bnel:
-      isLikely = true;
-    case branch_type::bne:
-      takeBranch = (s->gpr[rt] != s->gpr[rs]);
-      break;
-    case branch_type::blezl:
-      isLikely = true;
-    case branch_type::blez:
-      takeBranch = (s->gpr[rs] <= 0);
-      break;
-    case branch_type::bgtzl:
-      isLikely = true;
-    case branch_type::bgtz:
-      takeBranch = (s->gpr[rs] > 0);
-      break;
-    case branch_type::bgezl:
-      isLikely = true;
-    case branch_type::bgez:
-      takeBranch = (s->gpr[rs] >= 0);
-      break;
-    case branch_type::bltzl:
-      isLikely = true;
-    case branch_type::bltz:
-      takeBranch = (s->gpr[rs] < 0);
-      break;
-    case branch_type::bc1tl:
-      isLikely = true;
-    case branch_type::bc1t:
-      takeBranch = getConditionCode(s,((inst>>18)&7))==1;
-      break;
-    case branch_type::bc1fl:
-      isLikely = true;
-    case branch_type::bc1f:
-      takeBranch = getConditionCode(s,((inst>>18)&7))==0;
-      break;
-    default:
-      die();
-    }
-  uint32_t idx = (s->icnt-1)%HWINDOW;
-  s->hbuf[idx].was_likely_branch = isLikely;
-  s->hbuf[idx].took_branch_or_jump = takeBranch;
-  s->pc += 4;
-  if(isLikely) {
-    if(takeBranch) {
-      execMips(s);
-      s->pc = (imm+npc);
-    }
-    else {
-      s->pc += 4;
-    }
-  }
-  else {
-    execMips(s);
-    if(takeBranch){
-      s->pc = (imm+npc);
-    }
-  }
-  s->hbuf[idx].next_pc = s->pc;
-
-}
-
-static inline void _bgez_bltz(uint32_t inst, state_t *s) {
-  uint32_t rt = (inst >> 16) & 31;
-  switch(rt&3)
-    {
-    case 0:
-      branch<branch_type::bltz>(inst, s);
-      break;
-    case 1:
-      branch<branch_type::bgez>(inst, s);
-      break;
-    case 2:
-      branch<branch_type::bltzl>(inst, s);
-      break;
-    case 3:
-      branch<branch_type::bgezl>(inst, s);
-      break;
-    }
-}
-
-
 void execRType(uint32_t inst, state_t *s);
 void execJType(uint32_t inst, state_t *s);
 void execIType(uint32_t inst, state_t *s);
@@ -254,395 +152,706 @@ void mkMonitorVectors(state_t *s) {
 }
 
 
-void execMips(state_t *s) {
-  if(s->brk) return;
-  sparse_mem &mem = s->mem;
-  uint32_t inst = bswap(mem.get32(s->pc));
+/* predecoded instruction ; tagged by pc and instruction word so
+ * code rewritten by stores simply misses */
+enum class pd_op : uint8_t {
+  slow,
+  sll, srl, sra, sllv, srlv, srav,
+  jr, jalr, syscall, brk,
+  mfhi, mthi, mflo, mtlo,
+  mult, multu, div, divu,
+  addu, subu, and_, or_, xor_, nor, slt, sltu, movn, movz,
+  monitor,
+  j, jal,
+  beq, bne, blez, bgtz, beql, bnel, blezl, bgtzl,
+  bltz, bgez, bltzl, bgezl,
+  bc1f, bc1t, bc1fl, bc1tl,
+  addiu, slti, sltiu, andi, ori, xori, lui,
+  lb, lh, lw, lbu, lhu, sb, sh, sw,
+  num_ops
+};
+
+struct pd_insn {
+  uint32_t pc = 1;
+  uint32_t inst = 0;
+  pd_op op = pd_op::slow;
+  uint8_t rs = 0, rt = 0, rd = 0;
+  /* immediate, shift amount or branch / jump offset */
+  int32_t imm = 0;
+};
+
+static const uint32_t lg_pd_len = 14;
+static thread_local std::vector<pd_insn> pd_tbl;
+
+static void execSlow(uint32_t inst, state_t *s);
 
+static void predecode(pd_insn &e, uint32_t pc, uint32_t inst) {
   uint32_t opcode = inst>>26;
-  bool isRType = (opcode==0);
-  bool isJType = ((opcode>>1)==1);
-  bool isCoproc0 = (opcode == 0x10);
-  bool isCoproc1 = (opcode == 0x11);
-  bool isCoproc1x = (opcode == 0x13);
-  bool isCoproc2 = (opcode == 0x12);
-  bool isSpecial2 = (opcode == 0x1c); 
-  bool isSpecial3 = (opcode == 0x1f);
-  bool isLoadLinked = (opcode == 0x30);
-  bool isStoreCond = (opcode == 0x38);
-  uint32_t rs = (inst >> 21) & 31;
-  uint32_t rt = (inst >> 16) & 31;
-  uint32_t rd = (inst >> 11) & 31;
-  s->hbuf[s->icnt%HWINDOW].fetch_pc = s->pc;
-  s->hbuf[s->icnt%HWINDOW].next_pc = s->pc+4;
-  s->hbuf[s->icnt%HWINDOW].was_branch_or_jump = false;
-  s->hbuf[s->icnt%HWINDOW].was_likely_branch = false;
-  s->hbuf[s->icnt%HWINDOW].took_branch_or_jump = false;
-  s->hbuf[s->icnt%HWINDOW].icnt = s->icnt;
-  s->icnt++;
-  
-  if(isRType) {
-    uint32_t funct = inst & 63;
-    uint32_t sa = (inst >> 6) & 31;
-    switch(funct) 
-      {
-      case 0x00: /*sll*/
-	s->gpr[rd] = s->gpr[rt] << sa;
-	s->pc += 4;
-	break;
-      case 0x01: /* movci */
-	_movci(inst,s);
-	break;
-      case 0x02: /* srl */
-	s->gpr[rd] = ((uint32_t)s->gpr[rt] >> sa);
-	s->pc += 4;
-	break;
-      case 0x03: /* sra */
-	s->gpr[rd] = s->gpr[rt] >> sa;
-	s->pc += 4;
-	break;
-      case 0x04: /* sllv */
-	s->gpr[rd] = s->gpr[rt] << (s->gpr[rs] & 0x1f);
-	s->pc += 4;
-	break;
-      case 0x05:
-	_monitor(inst,s);
-	break;
-      case 0x06:  
-	s->gpr[rd] = ((uint32_t)s->gpr[rt]) >> (s->gpr[rs] & 0x1f);
-	s->pc += 4;
-	break;
-      case 0x07:  
-	s->gpr[rd] = s->gpr[rt] >> (s->gpr[rs] & 0x1f);
-	s->pc += 4;
-	break;
-      case 0x08: { /* jr */
-	s->hbuf[(s->icnt-1)%HWINDOW].was_branch_or_jump = true;
-	s->hbuf[(s->icnt-1)%HWINDOW].took_branch_or_jump = true;
-	s->hbuf[(s->icnt-1)%HWINDOW].next_pc = s->gpr[rs];
-	uint32_t jaddr = s->gpr[rs];
-	s->pc += 4;
-	execMips(s);
-	s->pc = jaddr;
-	break;
-      }
-      case 0x09: { /* jalr */
-	s->hbuf[(s->icnt-1)%HWINDOW].was_branch_or_jump = true;
-	s->hbuf[(s->icnt-1)%HWINDOW].took_branch_or_jump = true;
-	s->hbuf[(s->icnt-1)%HWINDOW].next_pc = s->gpr[rs];
-	uint32_t jaddr = s->gpr[rs];
-	s->gpr[31] = s->pc+8;
-	s->pc += 4;
-	execMips(s);
-	s->pc = jaddr;
-	break;
-      }
-      case 0x0C: /* syscall */
-	s->syscall = 1;
-	break;
-      case 0x0D: /* break */
-	s->brk = 1;
-	break;
-      case 0x0f: /* sync */
-	s->pc += 4;
-	break;
-      case 0x10: /* mfhi */
-	s->gpr[rd] = s->hi;
-	s->pc += 4;
-	break;
-      case 0x11: /* mthi */ 
-	s->hi = s->gpr[rs];
-	s->pc += 4;
-	break;
-      case 0x12: /* mflo */
-	s->gpr[rd] = s->lo;
-	s->pc += 4;
-	break;
-      case 0x13: /* mtlo */
-	s->lo = s->gpr[rs];
-	s->pc += 4;
-	break;
-      case 0x18: { /* mult */
-	int64_t y;
-	y = (int64_t)s->gpr[rs] * (int64_t)s->gpr[rt];
-	s->lo = (int32_t)(y & 0xffffffff);
-	s->hi = (int32_t)(y >> 32);
-	s->pc += 4;
-	break;
-      }
-      case 0x19: { /* multu */
-	uint64_t y;
-	uint64_t u0 = (uint64_t)*((uint32_t*)&s->gpr[rs]);
-	uint64_t u1 = (uint64_t)*((uint32_t*)&s->gpr[rt]);
-	y = u0*u1;
-	*((uint32_t*)&(s->lo)) = (uint32_t)y;
-	*((uint32_t*)&(s->hi)) = (uint32_t)(y>>32);
-	s->pc += 4;
-	break;
-      }
-      case 0x1A: /* div */
-	if(s->gpr[rt] != 0) {
-	  s->lo = s->gpr[rs] / s->gpr[rt];
-	  s->hi = s->gpr[rs] % s->gpr[rt];
-	}
-	s->pc += 4;
-	break;
-      case 0x1B: /* divu */
-	if(s->gpr[rt] != 0) {
-	  s->lo = (uint32_t)s->gpr[rs] / (uint32_t)s->gpr[rt];
-	  s->hi = (uint32_t)s->gpr[rs] % (uint32_t)s->gpr[rt];
-	}
-	s->pc += 4;
-	break;
-      case 0x20: /* add */
-	s->gpr[rd] = s->gpr[rs] + s->gpr[rt];
-	s->pc += 4;
-	break;
-      case 0x21: { /* addu */
-	uint32_t u_rs = (uint32_t)s->gpr[rs];
-	uint32_t u_rt = (uint32_t)s->gpr[rt];
-	s->gpr[rd] = u_rs + u_rt;
-	s->pc += 4;
-	break;
-      }
-      case 0x22: /* sub */
-	printf("sub()\n");
-	exit(-1);
-	break;
-      case 0x23:{ /*subu*/  
-	uint32_t u_rs = (uint32_t)s->gpr[rs];
-	uint32_t u_rt = (uint32_t)s->gpr[rt];
-	uint32_t y = u_rs - u_rt;
-	s->gpr[rd] = y;
-	s->pc += 4;
-	break;
-      }
-      case 0x24: /* and */
-	s->gpr[rd] = s->gpr[rs] & s->gpr[rt];
-	s->pc += 4;
-	break;
-      case 0x25: /* or */
-	s->gpr[rd] = s->gpr[rs] | s->gpr[rt];
-	s->pc += 4;
-	break;
-      case 0x26: /* xor */
-	s->gpr[rd] = s->gpr[rs] ^ s->gpr[rt];
-	s->pc += 4;
-	break;
-      case 0x27: /* nor */
-	s->gpr[rd] = ~(s->gpr[rs] | s->gpr[rt]);
-	s->pc += 4;
-	break;
-      case 0x2A: /* slt */
-	s->gpr[rd] = s->gpr[rs] < s->gpr[rt];
-	s->pc += 4;
-	break;
-      case 0x2B: { /* sltu */
-	uint32_t urs = (uint32_t)s->gpr[rs];
-	uint32_t urt = (uint32_t)s->gpr[rt];
-	s->gpr[rd] = (urs < urt);
-	s->pc += 4;
-	break;
-      }
-      case 0x0B: /* movn */
-	s->gpr[rd] = (s->gpr[rt] != 0) ? s->gpr[rs] : s->gpr[rd];
-	s->pc +=4;
-	break;
-      case 0x0A: /* movz */
-	s->gpr[rd] = (s->gpr[rt] == 0) ? s->gpr[rs] : s->gpr[rd];
-	s->pc += 4;
-	break;
-      case 0x34: /* teq */
-	if(s->gpr[rs] == s->gpr[rt]) {
-	  printf("teq trap!!!!!\n");
-	  exit(-1);
+  uint32_t funct = inst & 63;
+  e.pc = pc;
+  e.inst = inst;
+  e.op = pd_op::slow;
+  e.rs = (inst >> 21) & 31;
+  e.rt = (inst >> 16) & 31;
+  e.rd = (inst >> 11) & 31;
+  e.imm = (int32_t)((int16_t)(inst & ((1<<16) - 1)));
+  switch(opcode)
+    {
+    case 0x00:
+      switch(funct)
+	{
+	case 0x00: e.op = pd_op::sll; e.imm = (inst >> 6) & 31; break;
+	case 0x02: e.op = pd_op::srl; e.imm = (inst >> 6) & 31; break;
+	case 0x03: e.op = pd_op::sra; e.imm = (inst >> 6) & 31; break;
+	case 0x04: e.op = pd_op::sllv; break;
+	case 0x05: e.op = pd_op::monitor; break;
+	case 0x06: e.op = pd_op::srlv; break;
+	case 0x07: e.op = pd_op::srav; break;
+	case 0x08: e.op = pd_op::jr; break;
+	case 0x09: e.op = pd_op::jalr; break;
+	case 0x0A: e.op = pd_op::movz; break;
+	case 0x0B: e.op = pd_op::movn; break;
+	case 0x0C: e.op = pd_op::syscall; break;
+	case 0x0D: e.op = pd_op::brk; break;
+	case 0x10: e.op = pd_op::mfhi; break;
+	case 0x11: e.op = pd_op::mthi; break;
+	case 0x12: e.op = pd_op::mflo; break;
+	case 0x13: e.op = pd_op::mtlo; break;
+	case 0x18: e.op = pd_op::mult; break;
+	case 0x19: e.op = pd_op::multu; break;
+	case 0x1A: e.op = pd_op::div; break;
+	case 0x1B: e.op = pd_op::divu; break;
+	case 0x20: /* add */
+	case 0x21: e.op = pd_op::addu; break;
+	case 0x23: e.op = pd_op::subu; break;
+	case 0x24: e.op = pd_op::and_; break;
+	case 0x25: e.op = pd_op::or_; break;
+	case 0x26: e.op = pd_op::xor_; break;
+	case 0x27: e.op = pd_op::nor; break;
+	case 0x2A: e.op = pd_op::slt; break;
+	case 0x2B: e.op = pd_op::sltu; break;
+	default:
+	  break;
 	}
-	s->pc += 4;
-	break;
-      default:
-	printf("%sunknown RType instruction %x, funct = %d%s\n", 
-	       KRED, s->pc, funct, KNRM);
-	exit(-1);
-	break;
+      break;
+    case 0x01: {
+      static const pd_op regimm[4] = {pd_op::bltz, pd_op::bgez,
+				      pd_op::bltzl, pd_op::bgezl};
+      e.op = regimm[e.rt & 3];
+      e.imm <<= 2;
+      break;
+    }
+    case 0x02:
+    case 0x03:
+      e.op = (opcode == 0x2) ? pd_op::j : pd_op::jal;
+      e.imm = (inst & ((1<<26)-1)) << 2;
+      break;
+    case 0x04: e.op = pd_op::beq; e.imm <<= 2; break;
+    case 0x05: e.op = pd_op::bne; e.imm <<= 2; break;
+    case 0x06: e.op = pd_op::blez; e.imm <<= 2; break;
+    case 0x07: e.op = pd_op::bgtz; e.imm <<= 2; break;
+    case 0x08: /* addi */
+    case 0x09: e.op = pd_op::addiu; break;
+    case 0x0A: e.op = pd_op::slti; break;
+    case 0x0B: e.op = pd_op::sltiu; break;
+    case 0x0C: e.op = pd_op::andi; e.imm = inst & ((1<<16) - 1); break;
+    case 0x0D: e.op = pd_op::ori; e.imm = inst & ((1<<16) - 1); break;
+    case 0x0E: e.op = pd_op::xori; e.imm = inst & ((1<<16) - 1); break;
+    case 0x0F: e.op = pd_op::lui; e.imm = (inst & ((1<<16) - 1)) << 16; break;
+    case 0x11:
+      if(e.rs == 0x8) {
+	static const pd_op bc1[4] = {pd_op::bc1f, pd_op::bc1t,
+				     pd_op::bc1fl, pd_op::bc1tl};
+	e.op = bc1[e.rt & 3];
+	e.imm <<= 2;
       }
+      break;
+    case 0x14: e.op = pd_op::beql; e.imm <<= 2; break;
+    case 0x15: e.op = pd_op::bnel; e.imm <<= 2; break;
+    case 0x16: e.op = pd_op::blezl; e.imm <<= 2; break;
+    case 0x17: e.op = pd_op::bgtzl; e.imm <<= 2; break;
+    case 0x20: e.op = pd_op::lb; break;
+    case 0x21: e.op = pd_op::lh; break;
+    case 0x23: /* lw */
+    case 0x30: e.op = pd_op::lw; break; /* ll */
+    case 0x24: e.op = pd_op::lbu; break;
+    case 0x25: e.op = pd_op::lhu; break;
+    case 0x28: e.op = pd_op::sb; break;
+    case 0x29: e.op = pd_op::sh; break;
+    case 0x2B: e.op = pd_op::sw; break;
+    default:
+      break;
+    }
+}
+
+/* Direct-threaded interpreter : steps at least once, then runs
+ * until icnt reaches limit, a break or a syscall. Delay slots are
+ * stepped inline ; a branch and its delay slot always retire
+ * together, as before. hbuf is only written when track is set. */
+template <bool track>
+static void interp(state_t *s, uint64_t limit) {
+  static const void *const labels[] = {
+    &&op_slow,
+    &&op_sll, &&op_srl, &&op_sra, &&op_sllv, &&op_srlv, &&op_srav,
+    &&op_jr, &&op_jalr, &&op_syscall, &&op_brk,
+    &&op_mfhi, &&op_mthi, &&op_mflo, &&op_mtlo,
+    &&op_mult, &&op_multu, &&op_div, &&op_divu,
+    &&op_addu, &&op_subu, &&op_and, &&op_or, &&op_xor, &&op_nor,
+    &&op_slt, &&op_sltu, &&op_movn, &&op_movz,
+    &&op_monitor,
+    &&op_j, &&op_jal,
+    &&op_beq, &&op_bne, &&op_blez, &&op_bgtz,
+    &&op_beql, &&op_bnel, &&op_blezl, &&op_bgtzl,
+    &&op_bltz, &&op_bgez, &&op_bltzl, &&op_bgezl,
+    &&op_bc1f, &&op_bc1t, &&op_bc1fl, &&op_bc1tl,
+    &&op_addiu, &&op_slti, &&op_sltiu, &&op_andi, &&op_ori, &&op_xori, &&op_lui,
+    &&op_lb, &&op_lh, &&op_lw, &&op_lbu, &&op_lhu, &&op_sb, &&op_sh, &&op_sw
+  };
+  static_assert(sizeof(labels)/sizeof(labels[0]) ==
+		static_cast<size_t>(pd_op::num_ops),
+		"interp label table out of sync with pd_op");
+  if(s->brk) return;
+  if(pd_tbl.empty()) {
+    pd_tbl.resize(1UL << lg_pd_len);
   }
-  else if(isSpecial2)
-    execSpecial2(inst,s);
-  else if(isSpecial3)
-    execSpecial3(inst,s);
-  else if(isJType) {
-    uint32_t jaddr = inst & ((1<<26)-1);
-    jaddr <<= 2;
-    uint32_t idx = (s->icnt-1)%HWINDOW;
-    if(opcode==0x2) { /* j */
-      s->hbuf[idx].was_branch_or_jump = true;
-      s->hbuf[idx].took_branch_or_jump = true;
-      s->pc += 4;
+  pd_insn *tbl = pd_tbl.data();
+  const uint32_t pd_mask = (1U << lg_pd_len) - 1;
+  int32_t *gpr = s->gpr;
+  pd_insn *e = nullptr;
+  /* branch waiting on its delay slot */
+  bool ds = false, ds_taken = false;
+  uint32_t ds_target = 0;
+  uint64_t ds_idx = 0;
+  /* per-handler scratch */
+  bool take = false, likely = false;
+  uint32_t target = 0;
+  uint64_t idx = 0;
+
+ fetch: {
+    uint32_t inst = bswap(s->mem.get32(s->pc));
+    e = &tbl[(s->pc >> 2) & pd_mask];
+    if(e->pc != s->pc or e->inst != inst) {
+      predecode(*e, s->pc, inst);
     }
-    else if(opcode==0x3) { /* jal */
-      s->hbuf[idx].was_branch_or_jump = true;
-      s->hbuf[idx].took_branch_or_jump = true;
-      s->gpr[31] = s->pc+8;
-      s->pc += 4;
+    if(track) {
+      history_t &h = s->hbuf[s->icnt%HWINDOW];
+      h.fetch_pc = s->pc;
+      h.next_pc = s->pc+4;
+      h.was_branch_or_jump = false;
+      h.was_likely_branch = false;
+      h.took_branch_or_jump = false;
+      h.icnt = s->icnt;
     }
-    else {
-      printf("Unknown JType instruction\n");
-      exit(-1);
+    s->icnt++;
+    goto *labels[static_cast<int>(e->op)];
+  }
+ next:
+  if(ds) {
+    ds = false;
+    if(ds_taken) {
+      s->pc = ds_target;
+    }
+    if(track) {
+      s->hbuf[ds_idx].next_pc = s->pc;
     }
-    jaddr |= (s->pc & (~((1<<28)-1)));
-    execMips(s);
-    s->pc = jaddr;
-    s->hbuf[idx].next_pc = jaddr;
   }
-  else if(isCoproc0) {  
-    switch(rs) 
-      {
-      case 0x0: /*mfc0*/
-	s->gpr[rt] = s->cpr0[rd];
-	break;
-      case 0x4: /*mtc0*/
-	s->cpr0[rd] = s->gpr[rt];
-	break;
-      default:
-	printf("unknown %s instruction @ %x", __func__, s->pc); exit(-1);
-	break;
-      }
+  if(s->icnt >= limit) {
+    return;
+  }
+  goto fetch;
+
+ delay_slot:
+  if(ds) {
+    /* branch in a delay slot ; step its own delay slot by itself */
+    interp<track>(s, s->icnt+1);
+    if(take) {
+      s->pc = target;
+    }
+    if(track) {
+      s->hbuf[idx].next_pc = s->pc;
+    }
+    if(s->syscall or s->brk) {
+      limit = 0;
+    }
+    goto next;
+  }
+  ds = true;
+  ds_taken = take;
+  ds_target = target;
+  ds_idx = idx;
+  goto fetch;
+
+ cond_branch:
+  target = s->pc + 4 + e->imm;
+  idx = (s->icnt-1)%HWINDOW;
+  if(track) {
+    s->hbuf[idx].was_branch_or_jump = true;
+    s->hbuf[idx].was_likely_branch = likely;
+    s->hbuf[idx].took_branch_or_jump = take;
+  }
+  s->pc += 4;
+  if(likely and not(take)) {
     s->pc += 4;
+    if(track) {
+      s->hbuf[idx].next_pc = s->pc;
+    }
+    goto next;
   }
-  else if(isCoproc1) 
-    execCoproc1(inst,s);
-  else if(isCoproc1x)
-    execCoproc1x(inst,s);
-  else if(isCoproc2) {
-    printf("coproc2 unimplemented\n");  exit(-1);
+  goto delay_slot;
+
+ op_slow:
+  execSlow(e->inst, s);
+  goto next;
+ op_sll:
+  gpr[e->rd] = gpr[e->rt] << e->imm;
+  s->pc += 4;
+  goto next;
+ op_srl:
+  gpr[e->rd] = ((uint32_t)gpr[e->rt] >> e->imm);
+  s->pc += 4;
+  goto next;
+ op_sra:
+  gpr[e->rd] = gpr[e->rt] >> e->imm;
+  s->pc += 4;
+  goto next;
+ op_sllv:
+  gpr[e->rd] = gpr[e->rt] << (gpr[e->rs] & 0x1f);
+  s->pc += 4;
+  goto next;
+ op_srlv:
+  gpr[e->rd] = ((uint32_t)gpr[e->rt]) >> (gpr[e->rs] & 0x1f);
+  s->pc += 4;
+  goto next;
+ op_srav:
+  gpr[e->rd] = gpr[e->rt] >> (gpr[e->rs] & 0x1f);
+  s->pc += 4;
+  goto next;
+ op_jr:
+  target = gpr[e->rs];
+  goto jump_reg;
+ op_jalr:
+  target = gpr[e->rs];
+  gpr[31] = s->pc+8;
+ jump_reg:
+  idx = (s->icnt-1)%HWINDOW;
+  if(track) {
+    s->hbuf[idx].was_branch_or_jump = true;
+    s->hbuf[idx].took_branch_or_jump = true;
+    s->hbuf[idx].next_pc = target;
   }
-  else if(isLoadLinked)
-    _lw(inst, s);
-  else if(isStoreCond)
-    _sc(inst, s);
-  else { /* itype */
-    uint32_t uimm32 = inst & ((1<<16) - 1);
-    int16_t simm16 = (int16_t)uimm32;
-    int32_t simm32 = (int32_t)simm16;
-    switch(opcode) 
-      {
-      case 0x01:
-	_bgez_bltz(inst, s); 
-	break;
-      case 0x04:
-	branch<branch_type::beq>(inst, s); 
-	break;
-      case 0x05:
-	branch<branch_type::bne>(inst, s); 
-	break;
-      case 0x06:
-	branch<branch_type::blez>(inst, s); 
-	break;
-      case 0x07:
-	branch<branch_type::bgtz>(inst, s); 
-	break;
-      case 0x08: /* addi */
-	s->gpr[rt] = s->gpr[rs] + simm32;  
-	s->pc+=4;
-	break;
-      case 0x09: /* addiu */
-	s->gpr[rt] = s->gpr[rs] + simm32;  
-	s->pc+=4;
-	break;
-      case 0x0A: /* slti */
-	s->gpr[rt] = (s->gpr[rs] < simm32);
-	s->pc += 4;
-	break;
-      case 0x0B:/* sltiu */
-	s->gpr[rt] = ((uint32_t)s->gpr[rs] < (uint32_t)simm32);
-	s->pc += 4;
-	break;
-      case 0x0c: /* andi */
-	s->gpr[rt] = s->gpr[rs] & uimm32;
-	s->pc += 4;
-	break;
-      case 0x0d: /* ori */
-	s->gpr[rt] = s->gpr[rs] | uimm32;
-	s->pc += 4;
-	break;
-      case 0x0e: /* xori */
-	s->gpr[rt] = s->gpr[rs] ^ uimm32;
-	s->pc += 4;
-	break;
-      case 0x0F: /* lui */
-	uimm32 <<= 16;
-	s->gpr[rt] = uimm32;
-	s->pc += 4;
-	break;
-      case 0x14:
-	branch<branch_type::beql>(inst, s); 
-	break;
-      case 0x16:
-	branch<branch_type::blezl>(inst, s); 
-	break;
-      case 0x15:
-	branch<branch_type::bnel>(inst, s); 
-	break;
-      case 0x17:
-	branch<branch_type::bgtzl>(inst, s); 
-	break;
-      case 0x20:
-	_lb(inst, s);
-	break;
-      case 0x21:
-	_lh(inst, s);
-	break;
-      case 0x22: 
-	_lwl(inst, s);
-	break;
-      case 0x23:
-	_lw(inst, s); 
-	break;
-      case 0x24:
-	_lbu(inst, s);
-	break;
-      case 0x25:
-	_lhu(inst, s);
-	break;
-      case 0x26:
-	_lwr(inst, s);
-	break;
-      case 0x28:
-	_sb(inst, s); 
-	break;
-      case 0x29:
-	_sh(inst, s); 
-	break;
-      case 0x2a:
-	_swl(inst, s); 
-	break;
-      case 0x2B:
-	_sw(inst, s); 
-	break;
-      case 0x2e:
-	_swr(inst, s); 
-	break;
-      case 0x31:
-	_lwc1(inst, s);
-	break;  
-      case 0x35:
-	_ldc1(inst, s);
-	break;
-      case 0x39:
-	_swc1(inst, s);
-	break;
-      case 0x3D:
-	_sdc1(inst, s);
-	break;
-      default:
-	printf("%s: Unknown IType instruction (bits=%x) @ pc=0x%08x\n", 
-	       __func__, inst, s ? s->pc : 0);
-	exit(-1);
-	break;
-      }
+  take = true;
+  s->pc += 4;
+  goto delay_slot;
+ op_syscall:
+  s->syscall = 1;
+  limit = 0;
+  goto next;
+ op_brk:
+  s->brk = 1;
+  limit = 0;
+  goto next;
+ op_mfhi:
+  gpr[e->rd] = s->hi;
+  s->pc += 4;
+  goto next;
+ op_mthi:
+  s->hi = gpr[e->rs];
+  s->pc += 4;
+  goto next;
+ op_mflo:
+  gpr[e->rd] = s->lo;
+  s->pc += 4;
+  goto next;
+ op_mtlo:
+  s->lo = gpr[e->rs];
+  s->pc += 4;
+  goto next;
+ op_mult: {
+    int64_t y = (int64_t)gpr[e->rs] * (int64_t)gpr[e->rt];
+    s->lo = (int32_t)(y & 0xffffffff);
+    s->hi = (int32_t)(y >> 32);
+    s->pc += 4;
+    goto next;
+  }
+ op_multu: {
+    uint64_t y = (uint64_t)((uint32_t)gpr[e->rs]) * (uint64_t)((uint32_t)gpr[e->rt]);
+    *((uint32_t*)&(s->lo)) = (uint32_t)y;
+    *((uint32_t*)&(s->hi)) = (uint32_t)(y>>32);
+    s->pc += 4;
+    goto next;
+  }
+ op_div:
+  if(gpr[e->rt] != 0) {
+    s->lo = gpr[e->rs] / gpr[e->rt];
+    s->hi = gpr[e->rs] % gpr[e->rt];
+  }
+  s->pc += 4;
+  goto next;
+ op_divu:
+  if(gpr[e->rt] != 0) {
+    s->lo = (uint32_t)gpr[e->rs] / (uint32_t)gpr[e->rt];
+    s->hi = (uint32_t)gpr[e->rs] % (uint32_t)gpr[e->rt];
+  }
+  s->pc += 4;
+  goto next;
+ op_addu:
+  gpr[e->rd] = (uint32_t)gpr[e->rs] + (uint32_t)gpr[e->rt];
+  s->pc += 4;
+  goto next;
+ op_subu:
+  gpr[e->rd] = (uint32_t)gpr[e->rs] - (uint32_t)gpr[e->rt];
+  s->pc += 4;
+  goto next;
+ op_and:
+  gpr[e->rd] = gpr[e->rs] & gpr[e->rt];
+  s->pc += 4;
+  goto next;
+ op_or:
+  gpr[e->rd] = gpr[e->rs] | gpr[e->rt];
+  s->pc += 4;
+  goto next;
+ op_xor:
+  gpr[e->rd] = gpr[e->rs] ^ gpr[e->rt];
+  s->pc += 4;
+  goto next;
+ op_nor:
+  gpr[e->rd] = ~(gpr[e->rs] | gpr[e->rt]);
+  s->pc += 4;
+  goto next;
+ op_slt:
+  gpr[e->rd] = gpr[e->rs] < gpr[e->rt];
+  s->pc += 4;
+  goto next;
+ op_sltu:
+  gpr[e->rd] = (uint32_t)gpr[e->rs] < (uint32_t)gpr[e->rt];
+  s->pc += 4;
+  goto next;
+ op_movn:
+  gpr[e->rd] = (gpr[e->rt] != 0) ? gpr[e->rs] : gpr[e->rd];
+  s->pc += 4;
+  goto next;
+ op_movz:
+  gpr[e->rd] = (gpr[e->rt] == 0) ? gpr[e->rs] : gpr[e->rd];
+  s->pc += 4;
+  goto next;
+ op_monitor:
+  _monitor(e->inst, s);
+  if(track) {
+    idx = (s->icnt-1)%HWINDOW;
+    s->hbuf[idx].was_branch_or_jump = true;
+    s->hbuf[idx].took_branch_or_jump = true;
+    s->hbuf[idx].next_pc = s->pc;
+  }
+  goto next;
+ op_jal:
+  gpr[31] = s->pc+8;
+ op_j:
+  idx = (s->icnt-1)%HWINDOW;
+  if(track) {
+    s->hbuf[idx].was_branch_or_jump = true;
+    s->hbuf[idx].took_branch_or_jump = true;
+  }
+  s->pc += 4;
+  target = e->imm | (s->pc & (~((1U<<28)-1)));
+  take = true;
+  goto delay_slot;
+ op_beq:
+  likely = false;
+  take = (gpr[e->rt] == gpr[e->rs]);
+  goto cond_branch;
+ op_bne:
+  likely = false;
+  take = (gpr[e->rt] != gpr[e->rs]);
+  goto cond_branch;
+ op_blez:
+  likely = false;
+  take = (gpr[e->rs] <= 0);
+  goto cond_branch;
+ op_bgtz:
+  likely = false;
+  take = (gpr[e->rs] > 0);
+  goto cond_branch;
+ op_beql:
+  likely = true;
+  take = (gpr[e->rt] == gpr[e->rs]);
+  goto cond_branch;
+ op_bnel:
+  likely = true;
+  take = (gpr[e->rt] != gpr[e->rs]);
+  goto cond_branch;
+ op_blezl:
+  likely = true;
+  take = (gpr[e->rs] <= 0);
+  goto cond_branch;
+ op_bgtzl:
+  likely = true;
+  take = (gpr[e->rs] > 0);
+  goto cond_branch;
+ op_bltz:
+  likely = false;
+  take = (gpr[e->rs] < 0);
+  goto cond_branch;
+ op_bgez:
+  likely = false;
+  take = (gpr[e->rs] >= 0);
+  goto cond_branch;
+ op_bltzl:
+  likely = true;
+  take = (gpr[e->rs] < 0);
+  goto cond_branch;
+ op_bgezl:
+  likely = true;
+  take = (gpr[e->rs] >= 0);
+  goto cond_branch;
+ op_bc1f:
+  likely = false;
+  take = getConditionCode(s,((e->inst>>18)&7))==0;
+  goto cond_branch;
+ op_bc1t:
+  likely = false;
+  take = getConditionCode(s,((e->inst>>18)&7))==1;
+  goto cond_branch;
+ op_bc1fl:
+  likely = true;
+  take = getConditionCode(s,((e->inst>>18)&7))==0;
+  goto cond_branch;
+ op_bc1tl:
+  likely = true;
+  take = getConditionCode(s,((e->inst>>18)&7))==1;
+  goto cond_branch;
+ op_addiu:
+  gpr[e->rt] = (uint32_t)gpr[e->rs] + (uint32_t)e->imm;
+  s->pc += 4;
+  goto next;
+ op_slti:
+  gpr[e->rt] = (gpr[e->rs] < e->imm);
+  s->pc += 4;
+  goto next;
+ op_sltiu:
+  gpr[e->rt] = ((uint32_t)gpr[e->rs] < (uint32_t)e->imm);
+  s->pc += 4;
+  goto next;
+ op_andi:
+  gpr[e->rt] = gpr[e->rs] & e->imm;
+  s->pc += 4;
+  goto next;
+ op_ori:
+  gpr[e->rt] = gpr[e->rs] | e->imm;
+  s->pc += 4;
+  goto next;
+ op_xori:
+  gpr[e->rt] = gpr[e->rs] ^ e->imm;
+  s->pc += 4;
+  goto next;
+ op_lui:
+  gpr[e->rt] = e->imm;
+  s->pc += 4;
+  goto next;
+ op_lb:
+  _lb(e->inst, s);
+  goto next;
+ op_lh:
+  _lh(e->inst, s);
+  goto next;
+ op_lw:
+  _lw(e->inst, s);
+  goto next;
+ op_lbu:
+  _lbu(e->inst, s);
+  goto next;
+ op_lhu:
+  _lhu(e->inst, s);
+  goto next;
+ op_sb:
+  _sb(e->inst, s);
+  goto next;
+ op_sh:
+  _sh(e->inst, s);
+  goto next;
+ op_sw:
+  _sw(e->inst, s);
+  goto next;
+}
+
+void execMips(state_t *s) {
+  if(s->track_history) {
+    interp<true>(s, s->icnt+1);
+  }
+  else {
+    interp<false>(s, s->icnt+1);
   }
 }
 
+void runMips(state_t *s, uint64_t maxicnt) {
+  if(global::use_dbt and not(s->track_history) and (s->l1d == nullptr)
+     and dbtAvailable()) {
+    dbtRun(s, maxicnt);
+  }
+  else if(s->track_history) {
+    interp<true>(s, maxicnt);
+  }
+  else {
+    interp<false>(s, maxicnt);
+  }
+}
+
+/* no icnt or hbuf update ; the slow path of translated code,
+ * which handles control transfers itself */
+void execInsn(uint32_t inst, state_t *s) {
+  pd_insn e;
+  predecode(e, s->pc, inst);
+  int32_t *gpr = s->gpr;
+  switch(e.op)
+    {
+    case pd_op::div:
+      if(gpr[e.rt] != 0) {
+	s->lo = gpr[e.rs] / gpr[e.rt];
+	s->hi = gpr[e.rs] % gpr[e.rt];
+      }
+      s->pc += 4;
+      break;
+    case pd_op::divu:
+      if(gpr[e.rt] != 0) {
+	s->lo = (uint32_t)gpr[e.rs] / (uint32_t)gpr[e.rt];
+	s->hi = (uint32_t)gpr[e.rs] % (uint32_t)gpr[e.rt];
+      }
+      s->pc += 4;
+      break;
+    case pd_op::lb:
+      _lb(inst, s);
+      break;
+    case pd_op::lh:
+      _lh(inst, s);
+      break;
+    case pd_op::lw:
+      _lw(inst, s);
+      break;
+    case pd_op::lbu:
+      _lbu(inst, s);
+      break;
+    case pd_op::lhu:
+      _lhu(inst, s);
+      break;
+    case pd_op::sb:
+      _sb(inst, s);
+      break;
+    case pd_op::sh:
+      _sh(inst, s);
+      break;
+    case pd_op::sw:
+      _sw(inst, s);
+      break;
+    case pd_op::slow:
+      execSlow(inst, s);
+      break;
+    default:
+      die();
+    }
+}
+
+/* everything predecode does not give a handler of its own */
+static void execSlow(uint32_t inst, state_t *s) {
+  uint32_t opcode = inst>>26;
+  uint32_t rs = (inst >> 21) & 31;
+  uint32_t rt = (inst >> 16) & 31;
+  uint32_t rd = (inst >> 11) & 31;
+
+  switch(opcode)
+    {
+    case 0x00: {
+      uint32_t funct = inst & 63;
+      switch(funct)
+	{
+	case 0x01: /* movci */
+	  _movci(inst,s);
+	  break;
+	case 0x0f: /* sync */
+	  s->pc += 4;
+	  break;
+	case 0x22: /* sub */
+	  printf("sub()\n");
+	  exit(-1);
+	  break;
+	case 0x34: /* teq */
+	  if(s->gpr[rs] == s->gpr[rt]) {
+	    printf("teq trap!!!!!\n");
+	    exit(-1);
+	  }
+	  s->pc += 4;
+	  break;
+	default:
+	  printf("%sunknown RType instruction %x, funct = %d%s\n", 
+		 KRED, s->pc, funct, KNRM);
+	  exit(-1);
+	  break;
+	}
+      break;
+    }
+    case 0x10: /* coproc0 */
+      switch(rs) 
+	{
+	case 0x0: /*mfc0*/
+	  s->gpr[rt] = s->cpr0[rd];
+	  break;
+	case 0x4: /*mtc0*/
+	  s->cpr0[rd] = s->gpr[rt];
+	  break;
+	default:
+	  printf("unknown %s instruction @ %x", __func__, s->pc); exit(-1);
+	  break;
+	}
+      s->pc += 4;
+      break;
+    case 0x11:
+      execCoproc1(inst,s);
+      break;
+    case 0x12:
+      printf("coproc2 unimplemented\n");  exit(-1);
+      break;
+    case 0x13:
+      execCoproc1x(inst,s);
+      break;
+    case 0x1c:
+      execSpecial2(inst,s);
+      break;
+    case 0x1f:
+      execSpecial3(inst,s);
+      break;
+    case 0x22: 
+      _lwl(inst, s);
+      break;
+    case 0x26:
+      _lwr(inst, s);
+      break;
+    case 0x2a:
+      _swl(inst, s); 
+      break;
+    case 0x2e:
+      _swr(inst, s); 
+      break;
+    case 0x31:
+      _lwc1(inst, s);
+      break;  
+    case 0x35:
+      _ldc1(inst, s);
+      break;
+    case 0x38:
+      _sc(inst, s);
+      break;
+    case 0x39:
+      _swc1(inst, s);
+      break;
+    case 0x3D:
+      _sdc1(inst, s);
+      break;
+    default:
+      printf("%s: Unknown IType instruction (bits=%x) @ pc=0x%08x\n", 
+	     __func__, inst, s ? s->pc : 0);
+      exit(-1);
+      break;
+    }
+}
+
 
 void execSpecial2(uint32_t inst,state_t *s) {
   uint32_t funct = inst & 63; 
@@ -750,31 +959,13 @@ void execCoproc1(uint32_t inst, state_t *s)
   uint32_t functField = (inst>>21) & 31;
   uint32_t lowop = inst & 63;  
   uint32_t fmt = (inst >> 21) & 31;
-  uint32_t nd_tf = (inst>>16) & 3;
   
   uint32_t lowbits = inst & ((1<<11)-1);
   opcode &= 0x3;
 
-  if(fmt == 0x8)
-    {
-      switch(nd_tf)
-	{
-	case 0x0:
-	  branch<branch_type::bc1f>(inst,s);
-	  break;
-	case 0x1:
-	  branch<branch_type::bc1t>(inst,s);
-	  break;
-	case 0x2:
-	  branch<branch_type::bc1fl>(inst,s);
-	  break;
-	case 0x3:
-	  branch<branch_type::bc1tl>(inst,s);
-	  break;
-	}
-      /*BRANCH*/
-    }
-  else if((lowbits == 0) && ((functField==0x0) || (functField==0x4)))
+  /* bc1 branches are handled by interp */
+  assert(fmt != 0x8);
+  if((lowbits == 0) && ((functField==0x0) || (functField==0x4)))
     {
       if(functField == 0x0)
 	{
@@ -891,7 +1082,7 @@ template <typename T>
 void lxc1(uint32_t inst, state_t *s) {
   mips_t mi(inst);
   uint32_t ea = s->gpr[mi.lc1x.base] + s->gpr[mi.lc1x.index];
-  *reinterpret_cast<T*>(s->cpr1 + mi.lc1x.fd) = bswap(*reinterpret_cast<T*>(s->mem + ea));
+  *reinterpret_cast<T*>(s->cpr1 + mi.lc1x.fd) = bswap(s->mem.get<T>(ea));
   s->pc += 4;
 }
 
@@ -938,7 +1129,7 @@ static void _lw(uint32_t inst, state_t *s) {
   int16_t himm = (int16_t)(inst & ((1<<16) - 1));
   int32_t imm = (int32_t)himm;
   uint32_t ea = (uint32_t)s->gpr[rs] + imm;
-  s->gpr[rt] = bswap(*((int32_t*)(s->mem + ea))); 
+  s->gpr[rt] = bswap(s->mem.get<int32_t>(ea)); 
   if(s->l1d) {
     s->l1d->read(ea&(~3U), 4);
   }
@@ -953,7 +1144,7 @@ static void _lh(uint32_t inst, state_t *s) {
   int32_t imm = (int32_t)himm;
   
   uint32_t ea = s->gpr[rs] + imm;
-  int16_t mem = bswap(*((int16_t*)(s->mem + ea)));
+  int16_t mem = bswap(s->mem.get<int16_t>(ea));
   s->gpr[rt] = (int32_t)mem;
   if(s->l1d) {
     s->l1d->read(ea&(~1U), 2);
@@ -969,7 +1160,7 @@ static void _lb(uint32_t inst, state_t *s) {
   int32_t imm = (int32_t)himm;
   
   uint32_t ea = s->gpr[rs] + imm;
-  int8_t v = *((int8_t*)(s->mem + ea));
+  int8_t v = s->mem.get<int8_t>(ea);
   s->gpr[rt] = (int32_t)v;
   if(s->l1d) {
     s->l1d->read(ea, 1);
@@ -984,7 +1175,7 @@ static void _lbu(uint32_t inst, state_t *s){
   int32_t imm = (int32_t)himm;
   
   uint32_t ea = s->gpr[rs] + imm;
-  uint32_t zExt = (uint32_t)s->mem.at(ea);
+  uint32_t zExt = (uint32_t)s->mem.get<uint8_t>(ea);
   *((uint32_t*)&(s->gpr[rt])) = zExt;
   if(s->l1d) {
     s->l1d->read(ea, 1);
@@ -1000,7 +1191,7 @@ static void _lhu(uint32_t inst, state_t *s) {
   int32_t imm = (int32_t)himm;
   
   uint32_t ea = s->gpr[rs] + imm;
-  uint32_t zExt = bswap(*((uint16_t*)(s->mem + ea)));
+  uint32_t zExt = bswap(s->mem.get<uint16_t>(ea));
   *((uint32_t*)&(s->gpr[rt])) = zExt;
   if(s->l1d) {
     s->l1d->read(ea & (~1U), 2);
@@ -1088,7 +1279,7 @@ static void _swl(uint32_t inst, state_t *s) {
 #ifdef MIPSEL
   ma = 3 - ma;
 #endif
-  uint32_t r = bswap(*((int32_t*)(s->mem + ea))); 
+  uint32_t r = bswap(s->mem.get<int32_t>(ea)); 
   uint32_t xx=0,x = s->gpr[rt];
   
   uint32_t xs = x >> (8*ma);
@@ -1119,7 +1310,7 @@ static void _swr(uint32_t inst, state_t *s) {
   ma = 3 - ma;
 #endif
   ea &= 0xfffffffc;
-  uint32_t r = bswap(*((int32_t*)(s->mem + ea))); 
+  uint32_t r = bswap(s->mem.get<int32_t>(ea)); 
   uint32_t xx=0,x = s->gpr[rt];
   
   uint32_t xs = 8*(3-ma);
@@ -1151,7 +1342,7 @@ static void _lwl(uint32_t inst, state_t *s) {
 #ifdef MIPSEL
   ma = 3 - ma;
 #endif
-  int32_t r = bswap(*((int32_t*)(s->mem + ea))); 
+  int32_t r = bswap(s->mem.get<int32_t>(ea)); 
   int32_t x =  s->gpr[rt];
   
   switch(ma)
@@ -1189,7 +1380,7 @@ static void _lwr(uint32_t inst, state_t *s) {
 #ifdef MIPSEL
   ma = 3-ma;
 #endif
-  uint32_t r = bswap(*((int32_t*)(s->mem + ea))); 
+  uint32_t r = bswap(s->mem.get<int32_t>(ea)); 
   uint32_t x =  s->gpr[rt];
 
   switch(ma)
@@ -1376,9 +1567,6 @@ static void _monitorBody(uint32_t inst, state_t *s) {
       exit(-1);
       break;
     }
-  s->hbuf[(s->icnt-1)%HWINDOW].was_branch_or_jump = true;
-  s->hbuf[(s->icnt-1)%HWINDOW].took_branch_or_jump = true;
-  s->hbuf[(s->icnt-1)%HWINDOW].next_pc = s->gpr[31];
   s->pc = s->gpr[31];
 }
 
@@ -1393,7 +1581,7 @@ static void _ldc1(uint32_t inst, state_t *s)
   uint32_t ea = s->gpr[rs] + imm;
   //std::cout << "FS ldc1 : " << std::hex << "EA=" << ea << ","
   //<< (bswap(*((uint64_t*)(s->mem + ea)))) << std::dec << "\n";
-  *((int64_t*)(s->cpr1 + ft)) = bswap(*((int64_t*)(s->mem + ea))); 
+  *((int64_t*)(s->cpr1 + ft)) = bswap(s->mem.get<int64_t>(ea)); 
   if(s->l1d) {
     s->l1d->read(ea&(~7U), 8);
   }
@@ -1419,7 +1607,7 @@ static void _lwc1(uint32_t inst, state_t *s)
   int16_t himm = (int16_t)(inst & ((1<<16) - 1));
   int32_t imm = (int32_t)himm;
   uint32_t ea = s->gpr[rs] + imm;
-  uint32_t v = bswap(*((uint32_t*)(s->mem + ea))); 
+  uint32_t v = bswap(s->mem.get<uint32_t>(ea)); 
   *((float*)(s->cpr1 + ft)) = *((float*)&v);
   if(s->l1d) {
     s->l1d->read(ea&(~3U), 4);
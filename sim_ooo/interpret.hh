@@ -45,7 +45,14 @@ struct stat32_t {
 
 
 void initState(state_t *s);
+/* one instruction, or a branch and its delay slot */
 void execMips(state_t *s);
+/* step at least once, then run until icnt reaches maxicnt,
+ * a break or a syscall */
+void runMips(state_t *s, uint64_t maxicnt);
+/* one instruction that is not a control transfer, without
+ * touching icnt or hbuf */
+void execInsn(uint32_t inst, state_t *s);
 void mkMonitorVectors(state_t *s);
 
 #endif
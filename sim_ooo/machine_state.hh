@@ -7,18 +7,48 @@
 #include "sim_bitvec.hh"
 #include "sim_list.hh"
 #include "sim_stack.hh"
+#include "sim_pool.hh"
+#include "sim_rs.hh"
+#include "sim_wheel.hh"
+#include "sim_cam.hh"
 #include "mips.hh"
 #include "branch_predictor.hh"
 #include "loop_predictor.hh"
+#include "btb.hh"
+#include "store_sets.hh"
+#include "tlb.hh"
 #include "counter2b.hh"
 #include "perceptron.hh"
 #include "pipeline_record.hh"
 
 #include <array>
+#include <map>
 
 struct state_t;
 class simCache;
 class mips_meta_op;
+class oracle_frontend;
+class decode_cache;
+
+/* retire may stall mid-flight (delay slots, rollback) ;
+ * keep its progress here so it can be stepped once per cycle */
+enum class retire_phase {run, delay_slot_wait, exception,
+			 exception_delay_slot_wait, flash_restart};
+
+struct retire_context {
+  retire_phase phase = retire_phase::run;
+  mips_meta_op *u = nullptr;
+  int retire_amt = 0;
+  bool stop_sim = false;
+  bool exception = false;
+  bool started = false;
+  /* a branch retired, its delay slot has not ; retire never stops
+   * between the two, even at maxicnt */
+  bool delay_slot_owed = false;
+  int64_t sleep_cycles = 0;
+  int stuck_cnt = 0, empty_cnt = 0;
+  uint64_t num_retired_insns = 0;
+};
 
 class sim_state {
 public:
@@ -29,6 +59,7 @@ public:
   bool fetch_blocked = false;
   uint32_t delay_slot_npc = 0;
   uint32_t fetch_pc = 0;
+  uint64_t fetch_resume_cycle = 0;
 
   uint64_t last_retire_cycle = 0;
   uint32_t last_retire_pc = 0;
@@ -84,6 +115,11 @@ public:
   sim_bitvec fcr1_freevec_retire;
   sim_bitvec load_tbl_freevec;
   sim_bitvec store_tbl_freevec;
+  /* executed stores and loads that have read, by address */
+  sim_cam load_cam, store_cam;
+  /* store to load forwards this cycle */
+  int64_t stlf_cycle = -1;
+  int stlf_used = 0;
   
   sim_bitvec gpr_valid;
   sim_bitvec cpr0_valid;
@@ -93,6 +129,11 @@ public:
   sim_queue<mips_meta_op*> fetch_queue;
   sim_queue<mips_meta_op*> decode_queue;
   sim_queue<mips_meta_op*> rob;
+  /* executed ops keyed by complete_cycle */
+  sim_wheel<mips_meta_op*> complete_wheel;
+  /* retired and squashed ops, recycled by fetch */
+  sim_pool<mips_meta_op> op_pool;
+  decode_cache *dcache = nullptr;
 
   sim_bitvec alu_alloc;
   sim_bitvec fpu_alloc;
@@ -104,18 +145,27 @@ public:
   int num_load_rs = -1;
   int num_store_rs = -1;
   
-  typedef sim_list<mips_meta_op*> rs_type;
+  typedef sim_rs<mips_meta_op*> rs_type;
   std::vector<rs_type> alu_rs;
   std::vector<rs_type> fpu_rs;
   rs_type jmp_rs;
   std::vector<rs_type> load_rs;
   std::vector<rs_type> store_rs;
   rs_type system_rs;
+
+  /* rs entries parked until a physical register is written */
+  struct waiter {
+    mips_meta_op *u;
+    rs_type *rs;
+  };
+  typedef std::vector<std::vector<waiter>> waiter_tbl;
+  waiter_tbl gpr_waiters, cpr1_waiters, fcr1_waiters;
   
   sparse_mem *mem = nullptr;
 
   branch_predictor *branch_pred = nullptr;
   loop_predictor *loop_pred = nullptr;
+  branch_target_buffer *btb = nullptr;
   /* use smaller data-type */
   sim_bitvec_template<uint8_t> bhr, spec_bhr;
   std::vector<sim_bitvec> bht;
@@ -129,20 +179,37 @@ public:
   uint64_t mispredicted_jrs = 0;
   uint64_t mispredicted_jalrs = 0;
   uint64_t nukes = 0, branch_nukes = 0, load_nukes = 0;
+  uint64_t stlf_forwards = 0, stlf_replays = 0;
   uint64_t fetched_insns = 0;
   uint64_t total_ready_insns = 0;
   uint64_t total_allocated_insns = 0;
   uint64_t total_dispatched_insns = 0;
   uint64_t total_sched_insns = 0;
+  uint64_t skipped_cycles = 0;
+  int64_t alloc_counter = 0;
+
+  retire_context retire_ctx;
+  /* heartbeat window snapshots */
+  uint64_t hb_icnt = 0, hb_br_and_jmps = 0, hb_mispredicts = 0;
+  uint64_t hb_l1d_hits = 0, hb_l1d_misses = 0;
   
   sim_stack_template<uint32_t> return_stack;
+  store_set_predictor *store_sets = nullptr;
+  std::map<int64_t, int64_t> insn_lifetime_map;
 
   state_t *ref_state = nullptr;
   
   sparse_mem *oracle_mem = nullptr;
   state_t *oracle_state = nullptr;
+  /* non-null when oracle fetch runs on its own host thread */
+  oracle_frontend *frontend = nullptr;
 
   simCache *l1d = nullptr;
+  simCache *l1i = nullptr;
+  sim_mmu *mmu = nullptr;
+  /* l1i line being filled for fetch and the cycle it lands */
+  uint32_t icache_line = ~(0U);
+  uint64_t icache_ready = 0;
 
   
   bool log_execution = false;
@@ -151,15 +218,23 @@ public:
   void initialize_rat_mappings();
   void initialize();
   void copy_state(const state_t *s);
-
-  ~sim_state() {
-    if(gpr_prf) delete [] gpr_prf;
-    if(cpr0_prf) delete [] cpr0_prf;
-    if(cpr1_prf) delete [] cpr1_prf;
-    if(fcr1_prf) delete [] fcr1_prf;
-    if(load_tbl) delete [] load_tbl;
-    if(store_tbl) delete [] store_tbl;
-  }
+  void sync_state(state_t *s) const;
+  mips_meta_op *alloc_op(uint64_t fetch_icnt,
+			 uint32_t pc,
+			 uint32_t inst,
+			 uint32_t fetch_npc,
+			 uint64_t fetch_cycle,
+			 bool predict_taken,
+			 bool pop_return_stack);
+  void free_op(mips_meta_op *op);
+  /* wakeup network */
+  void park(mips_meta_op *u, rs_type *rs);
+  void broadcast(reg_file rf, int32_t prf);
+  void clear_waiters();
+
+  /* out of line, op_pool needs mips_meta_op complete */
+  sim_state();
+  ~sim_state();
 };
 
 
@@ -20,6 +20,8 @@
 
 
 #include "sim_cache.hh"
+#include "prefetcher.hh"
+#include "dram.hh"
 #include "loadelf.hh"
 #include "saveState.hh"
 #include "helper.hh"
@@ -28,22 +30,16 @@
 #include "globals.hh"
 #include "mips_op.hh"
 #include "machine_state.hh"
+#include "simpoint.hh"
+#include "ooo_core.hh"
 
 #define SAVE_SIM_PARAM_LIST
 #include "sim_parameters.hh"
 
 extern const char* githash;
 
-char **global::sysArgv = nullptr;
-int global::sysArgc = 0;
-bool global::enClockFuncts = false;
-std::ostream *global::sim_log = &(std::cout);
-bool global::use_interp_check = true;
-uint64_t global::curr_cycle = 0;
-uint64_t global::pipestart = 0;
-uint64_t global::pipeend = 0;
-
-static simCache* l1d = nullptr, *l2d = nullptr, *l3d = nullptr;
+static simCache* l1d = nullptr, *l1i = nullptr, *l2d = nullptr, *l3d = nullptr;
+static dram_controller *dram = nullptr;
 
 state_t *s = nullptr;
 
@@ -69,23 +65,8 @@ static void catchUnixSignal(int sig) {
 
 }
 
-/* linkage */
-#define SIM_PARAM(A,B,C,D) int sim_param::A = C;
-SIM_PARAM_LIST;
-#undef SIM_PARAM
-
 int buildArgcArgv(const char *filename, const char *sysArgs, char ***argv);
 
-void initialize_ooo_core(sim_state & machine_state,
-			 simCache *l1d,
-			 bool use_oracle,
-			 bool use_syscall_skip,
-			 uint64_t skipicnt, uint64_t maxicnt,
-			 state_t *s, const sparse_mem *sm);
-
-void run_ooo_core(sim_state &machine_state);
-void destroy_ooo_core(sim_state &machine_state);
-
 int main(int argc, char *argv[]) {
   namespace po = boost::program_options;
   
@@ -99,10 +80,19 @@ int main(int argc, char *argv[]) {
   std::string filename, sysArgs, logfile, pipelog;
   bool use_l2 = true, use_l3 = true;
   uint64_t maxicnt = ~(0UL), skipicnt = 0;
+  uint64_t sample_interval = 0, sample_warmup = 0, sample_window = 0;
+  uint64_t bbv_interval = 0;
+  std::string bbv_file, simpoints_file, weights_file;
+  uint64_t checkpoint_every = 0;
+  bool checkpoint_incremental = false;
+  std::string checkpoint_prefix;
+  std::vector<std::string> increments;
+  std::vector<simpoint> simpoints;
   bool use_checkpoint = false, use_oracle = false, hash=false;
   bool use_syscall_skip = false, use_mem_model = false;
   bool clear_checkpoint_icnt = false;
   bool warmstart = true;
+  bool use_gthreads = false, decoupled_fetch = false;
   int uarch_scale = 1;
   po::options_description desc("Options");
   po::variables_map vm;
@@ -124,7 +114,21 @@ int main(int argc, char *argv[]) {
     ("use_l2", po::value<bool>(&use_l2)->default_value(true), "use l2 cache model")
     ("use_l3", po::value<bool>(&use_l3)->default_value(true), "use l3 cache model")
     ("interp,i", po::value<bool>(&global::use_interp_check)->default_value(false), "use interpreter check")
+    ("dbt", po::value<bool>(&global::use_dbt)->default_value(false), "translate guest code to host code when fast-forwarding")
     ("warmstart", po::value<bool>(&warmstart)->default_value(true), "use warmstart with interpreter")
+    ("gthreads", po::value<bool>(&use_gthreads)->default_value(false), "run pipeline stages as gthreads instead of a static cycle loop")
+    ("decoupled_fetch", po::value<bool>(&decoupled_fetch)->default_value(false), "run oracle fetch and decode ahead on a second host thread")
+    ("sample_interval", po::value<uint64_t>(&sample_interval)->default_value(0), "instructions between detailed samples (0 disables sampling)")
+    ("sample_warmup", po::value<uint64_t>(&sample_warmup)->default_value(2000), "detailed warmup instructions before each sample")
+    ("sample_window", po::value<uint64_t>(&sample_window)->default_value(1000), "measured instructions per sample")
+    ("bbv", po::value<std::string>(&bbv_file), "write simpoint basic-block vectors to file and exit")
+    ("bbv_interval", po::value<uint64_t>(&bbv_interval)->default_value(100000000), "instructions per basic-block vector / simpoint interval")
+    ("simpoints", po::value<std::string>(&simpoints_file), "simulate the intervals in a simpoints file")
+    ("weights", po::value<std::string>(&weights_file), "simpoint weights file")
+    ("checkpoint_every", po::value<uint64_t>(&checkpoint_every)->default_value(0), "write a checkpoint every n interpreted instructions and exit")
+    ("checkpoint_prefix", po::value<std::string>(&checkpoint_prefix)->default_value("ckpt"), "checkpoint file name prefix")
+    ("checkpoint_incremental", po::value<bool>(&checkpoint_incremental)->default_value(false), "write only changed pages after the first checkpoint")
+    ("increments", po::value<std::vector<std::string>>(&increments)->multitoken(), "incremental checkpoints to apply in order after loading a checkpoint")
     ("scale", po::value<int>(&uarch_scale)->default_value(1), "scale uarch parameters")
     ("pipestart", po::value<uint64_t>(&global::pipestart)->default_value(~(0UL)), "start recording at instruction")
     ("pipeend", po::value<uint64_t>(&global::pipeend)->default_value(~(0UL)), "stop recording at instruction")
@@ -153,6 +157,26 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 
+  if(not(simpoints_file.empty())) {
+    if(not(read_simpoints(simpoints_file, weights_file, simpoints))) {
+      std::cerr << KRED << "unable to read simpoints" << KNRM << "\n";
+      return -1;
+    }
+  }
+  
+  if((sample_interval != 0) or not(simpoints.empty())) {
+    if(use_oracle) {
+      std::cerr << KRED << "sampling can not be used with the oracle" << KNRM << "\n";
+      return -1;
+    }
+  }
+  if(sample_interval != 0) {
+    if((sample_warmup + sample_window) > sample_interval) {
+      std::cerr << KRED << "sample_interval must cover sample_warmup + sample_window" << KNRM << "\n";
+      return -1;
+    }
+  }
+
 #define SIM_PARAM(A,B,C,D) if(sim_param::A < C) {	\
     std::cout << #A << " has out of range value "	\
 	      << sim_param::A				\
@@ -214,6 +238,9 @@ int main(int argc, char *argv[]) {
   }
   else {
     loadState(*s, filename, use_oracle or clear_checkpoint_icnt);
+    for(const std::string &inc : increments) {
+      loadState(*s, inc, use_oracle or clear_checkpoint_icnt);
+    }
   }
   signal(SIGINT, catchUnixSignal);
 
@@ -226,31 +253,54 @@ int main(int argc, char *argv[]) {
       use_l3 = false;
     }
     if(use_l3) {
-      l3d = new setAssocCache(sim_param::l3d_linesize,
-			      sim_param::l3d_assoc,
-			      sim_param::l3d_sets,
-			      "l3d",
-			      sim_param::l3d_latency,
-			      nullptr);
+      l3d = new flatSetAssocCache(sim_param::l3d_linesize,
+				  sim_param::l3d_assoc,
+				  sim_param::l3d_sets,
+				  "l3d",
+				  sim_param::l3d_latency,
+				  nullptr);
+      l3d->set_miss_handlers(sim_param::l3d_misses_inflight);
+      l3d->set_prefetcher(prefetcher::get_prefetcher(sim_param::l3d_prefetcher,
+						     sim_param::l3d_linesize));
     }
     if(use_l2) {
-      l2d = new setAssocCache(sim_param::l2d_linesize,
-			      sim_param::l2d_assoc,
-			      sim_param::l2d_sets,
-			      "l2d",
-			      sim_param::l2d_latency, l3d);
+      l2d = new flatSetAssocCache(sim_param::l2d_linesize,
+				  sim_param::l2d_assoc,
+				  sim_param::l2d_sets,
+				  "l2d",
+				  sim_param::l2d_latency, l3d);
+      l2d->set_miss_handlers(sim_param::l2d_misses_inflight);
+      l2d->set_prefetcher(prefetcher::get_prefetcher(sim_param::l2d_prefetcher,
+						     sim_param::l2d_linesize));
     }
     
-    l1d = new setAssocCache(sim_param::l1d_linesize,
-			    sim_param::l1d_assoc,
-			    sim_param::l1d_sets,
-			    "l1d",
-			    sim_param::l1d_latency, l2d);
+    l1d = new flatSetAssocCache(sim_param::l1d_linesize,
+				sim_param::l1d_assoc,
+				sim_param::l1d_sets,
+				"l1d",
+				sim_param::l1d_latency, l2d);
+    l1d->set_miss_handlers(sim_param::l1d_misses_inflight);
+    l1d->set_prefetcher(prefetcher::get_prefetcher(sim_param::l1d_prefetcher,
+						   sim_param::l1d_linesize));
+    /* l2d and l3d are unified */
+    l1i = new flatSetAssocCache(sim_param::l1i_linesize,
+				sim_param::l1i_assoc,
+				sim_param::l1i_sets,
+				"l1i",
+				sim_param::l1i_latency, l2d);
+    l1i->set_prefetcher(prefetcher::get_prefetcher(sim_param::l1i_prefetcher,
+						   sim_param::l1i_linesize));
+    if(sim_param::use_dram) {
+      dram = new dram_controller();
+      l1d->set_memory(dram);
+      l1i->set_memory(dram);
+    }
 
     if(warmstart) {
       s->l1d = l1d;
     }
 
+    *global::sim_log << "l1i capacity = " << l1i->capacity() << "\n";
     *global::sim_log << "l1d capacity = " << l1d->capacity() << "\n";
     if(l2d) {
       *global::sim_log << "l2d capacity = " << l2d->capacity() << "\n";
@@ -260,14 +310,31 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  initialize_ooo_core(machine_state, l1d, use_oracle,
+  initialize_ooo_core(machine_state, l1d, l1i, use_oracle,
 		      use_syscall_skip, skipicnt, maxicnt, s, sm);
   
   if(setjmp(jenv)>0) {
     std::cerr << "return from longjmp\n";
   }
   if(not(machine_state.terminate_sim)) {
-    run_ooo_core(machine_state);
+    if(checkpoint_every != 0) {
+      s->l1d = nullptr;
+      checkpoint_run(s, checkpoint_prefix, checkpoint_every,
+		     checkpoint_incremental, maxicnt);
+    }
+    else if(not(bbv_file.empty())) {
+      s->l1d = nullptr;
+      profile_bbv(s, bbv_file, bbv_interval, maxicnt);
+    }
+    else if(not(simpoints.empty())) {
+      run_simpoint_ooo_core(machine_state, simpoints, bbv_interval, sample_warmup);
+    }
+    else if(sample_interval != 0) {
+      run_sampled_ooo_core(machine_state, sample_interval, sample_warmup, sample_window);
+    }
+    else {
+      run_ooo_core(machine_state, use_gthreads, decoupled_fetch);
+    }
   }
   
   //*global::sim_log << "sparse mem bytes allocated = "
@@ -288,9 +355,15 @@ int main(int argc, char *argv[]) {
   delete s;
   delete sm;
 
+  if(l1i) {
+    l1i->print_level(*global::sim_log);
+  }
   if(l1d) {
     *global::sim_log << *l1d;
   }
+  if(dram) {
+    *global::sim_log << *dram;
+  }
   
   if(l3d) {
     delete l3d;
@@ -301,6 +374,12 @@ int main(int argc, char *argv[]) {
   if(l1d) {
     delete l1d;
   }
+  if(l1i) {
+    delete l1i;
+  }
+  if(dram) {
+    delete dram;
+  }
   
   if(global::sysArgv) {
     for(int i = 0; i < global::sysArgc; i++) {
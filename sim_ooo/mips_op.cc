@@ -1,6 +1,7 @@
 #include <cmath>
 #include <map>
 #include <set>
+#include <typeinfo>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -15,11 +16,6 @@
 
 char* get_open_string(sparse_mem &mem, uint32_t offset);
 
-std::map<uint32_t, uint32_t> branch_target_map;
-std::map<uint32_t, int32_t> branch_prediction_map;
-
-std::map<uint32_t, std::set<uint32_t>> load_alias_map;
-
 std::ostream &operator<<(std::ostream &out, const mips_op &op) {
   out << std::hex << op.m->pc << std::dec
       << ":" << getAsmString(op.m->inst, op.m->pc) << ":"
@@ -32,40 +28,134 @@ std::ostream &operator<<(std::ostream &out, const mips_op &op) {
   return out;
 }
 
-bool mips_load::stall_for_load(sim_state &machine_state) const {
-  //std::cout << "CHECKING LOAD TABLE for "
-  //<< std::hex << m->pc << std::dec
-  //	    << "@ cycle " << get_curr_cycle() << "\n";
-  auto it = load_alias_map.find(m->pc);
-  if(it != load_alias_map.end()) {
-    for(size_t i = 0, s = machine_state.store_tbl_freevec.size(); i < s; i++) {
-      if(machine_state.store_tbl[i] != nullptr) {
-	//std::cout << std::hex << machine_state.store_tbl[i]->pc
-	//<< std::dec << "\n";
-	auto st = machine_state.store_tbl[i];
-	assert(machine_state.rob.at(st->rob_idx)==st);
-	auto st_it = it->second.find(st->pc);
-	bool st_found = st_it != it->second.end();
-	//if(st_found and (st->alloc_cycle <= m->alloc_cycle)) {
-	if(st_found and (st->alloc_id < m->alloc_id)) {
-#if 0
-	  std::cout << *(st->op) << " blocks issse\n";
-	  std::cout << "store alloc'd @ "<< st->alloc_cycle << "\n";
-	  std::cout << "store ready @ "<< st->ready_cycle << "\n";
-	  std::cout << "store rob idx " << st->rob_idx << "\n";
-	  std::cout << "store retired @ "<< st->retire_cycle << "\n";
-	  std::cout << "load  alloc'd @ "<< m->alloc_cycle << "\n";
-	  std::cout << "now @  "<< get_curr_cycle() << "\n";
-#endif
-	  return true;
-	}
+bool mips_op::stall_for_store(sim_state &machine_state) const {
+  /* predicted store is older and hasn't executed */
+  if(m->dep_store_tbl_idx == -1) {
+    return false;
+  }
+  const mips_meta_op *st = machine_state.store_tbl[m->dep_store_tbl_idx];
+  return (st != nullptr) and (st->alloc_id == m->dep_store_alloc_id) and
+    (st->alloc_id < m->alloc_id) and not(st->is_complete);
+}
+
+/* youngest executed store older than this load that overlaps it */
+const mips_meta_op *mips_load::older_store(sim_state &machine_state, bool &covers) const {
+  const mips_meta_op *y = nullptr;
+  machine_state.store_cam.search(ld_addr, ld_len, [&](int32_t idx) {
+      const mips_meta_op *st = machine_state.store_tbl[idx];
+      if((st->alloc_id > m->alloc_id) or ((y != nullptr) and (st->alloc_id <= y->alloc_id))) {
+	return;
       }
+      if(static_cast<const mips_store*>(st->op)->overlaps(ld_addr, ld_len)) {
+	y = st;
+      }
+    });
+  covers = (y != nullptr) and static_cast<const mips_store*>(y->op)->covers(ld_addr, ld_len);
+  return y;
+}
+
+void mips_load::lsq_execute(sim_state &machine_state, uint32_t addr, uint32_t len,
+			    uint32_t cache_addr, uint32_t cache_len) {
+  ld_addr = addr;
+  ld_len = len;
+  bool covers = false;
+  if(not(m->load_exception) and (older_store(machine_state, covers) != nullptr) and covers) {
+    if(machine_state.stlf_cycle != static_cast<int64_t>(get_curr_cycle())) {
+      machine_state.stlf_cycle = get_curr_cycle();
+      machine_state.stlf_used = 0;
+    }
+    /* past the forwarding bandwidth the load goes to the cache */
+    if(machine_state.stlf_used < sim_param::stlf_per_cycle) {
+      machine_state.stlf_used++;
+      machine_state.stlf_forwards++;
+      m->complete_cycle = get_curr_cycle() + sim_param::stlf_latency;
+      return;
     }
   }
-  return false;
+  if(machine_state.l1d) {
+    uint32_t delay = machine_state.mmu ? machine_state.mmu->translate_data(addr, m->pc) : 0;
+    machine_state.l1d->read(m, cache_addr, cache_len, delay);
+  }
+  else {
+    m->complete_cycle = get_curr_cycle() + sim_param::l1d_latency;
+  }
+}
+
+/* assemble the load bytes ; false when an older store only partly
+ * covers them, the load replays next cycle until that store drains */
+bool mips_load::lsq_read(sim_state &machine_state) {
+  bool covers = false;
+  const mips_meta_op *st = older_store(machine_state, covers);
+  if((st != nullptr) and not(covers)) {
+    machine_state.stlf_replays++;
+    m->complete_cycle = get_curr_cycle() + 1;
+    machine_state.complete_wheel.schedule(get_curr_cycle(), m->complete_cycle, m);
+    return false;
+  }
+  if(st != nullptr) {
+    auto s = static_cast<const mips_store*>(st->op);
+    for(uint32_t i = 0; i < ld_len; i++) {
+      ld_bytes[i] = s->byte_at(ld_addr + i);
+    }
+    fwd_alloc_id = st->alloc_id;
+  }
+  else {
+    sparse_mem &mem = *(machine_state.mem);
+    for(uint32_t i = 0; i < ld_len; i++) {
+      ld_bytes[i] = mem.get<uint8_t>(ld_addr + i);
+    }
+    fwd_alloc_id = -1;
+  }
+  machine_state.load_cam.insert(ld_addr, ld_len, m->load_tbl_idx);
+  in_cam = true;
+  return true;
+}
+
+void mips_load::lsq_release(sim_state &machine_state) {
+  if(in_cam) {
+    machine_state.load_cam.erase(ld_addr, ld_len, m->load_tbl_idx);
+    in_cam = false;
+  }
+}
+
+void mips_store::set_store_bytes(sim_state &machine_state, uint32_t addr, uint32_t len, uint64_t v) {
+  assert(len <= sizeof(st_bytes));
+  st_addr = addr;
+  st_len = len;
+  for(uint32_t i = 0; i < len; i++) {
+    st_bytes[i] = static_cast<uint8_t>(v >> (8*(len-1-i)));
+  }
+  machine_state.store_cam.insert(st_addr, st_len, m->store_tbl_idx);
+  /* younger loads that already read these bytes without us */
+  machine_state.load_cam.search(st_addr, st_len, [&](int32_t idx) {
+      mips_meta_op *ld = machine_state.load_tbl[idx];
+      auto l = static_cast<const mips_load*>(ld->op);
+      if((ld->alloc_id < m->alloc_id) or ld->load_exception or
+	 not(l->overlaps(st_addr, st_len)) or (l->fwd_alloc_id > m->alloc_id)) {
+	return;
+      }
+      ld->load_exception = true;
+      machine_state.store_sets->violation(ld->pc, m->pc);
+    });
+}
+
+void mips_store::write_store_bytes(sim_state &machine_state) {
+  sparse_mem &mem = *(machine_state.mem);
+  for(uint32_t i = 0; i < st_len; i++) {
+    mem.at(st_addr + i) = st_bytes[i];
+  }
+  release_store_bytes(machine_state);
+}
+
+void mips_store::release_store_bytes(sim_state &machine_state) {
+  if(st_len != 0) {
+    machine_state.store_cam.erase(st_addr, st_len, m->store_tbl_idx);
+    st_len = 0;
+  }
 }
 
 class mtc0 : public mips_op {
+  MIPS_OP_CLONE(mtc0)
 public:
   mtc0(sim_op op) : mips_op(op) {
     this->op_class = oper_type::alu;
@@ -90,7 +180,7 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(m->src0_prf != -1 and not(machine_state.gpr_valid.get_bit(m->src0_prf))) {
+    if(m->src0_prf != -1 and not(src_ready(machine_state, reg_file::gpr, m->src0_prf))) {
       return false;
     }
     return true;
@@ -105,7 +195,7 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.cpr0_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::cpr0, m->prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -133,6 +223,7 @@ public:
 };
 
 class mtc1 : public mips_op {
+  MIPS_OP_CLONE(mtc1)
 public:
   mtc1(sim_op op) : mips_op(op) {
     this->op_class = oper_type::alu;
@@ -158,7 +249,7 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(m->src0_prf != -1 and not(machine_state.gpr_valid.get_bit(m->src0_prf))) {
+    if(m->src0_prf != -1 and not(src_ready(machine_state, reg_file::gpr, m->src0_prf))) {
       return false;
     }
     return true;
@@ -170,7 +261,7 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.cpr1_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::cpr1, m->prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -197,6 +288,7 @@ public:
 };
 
 class mfc1 : public mips_op {
+  MIPS_OP_CLONE(mfc1)
 public:
   mfc1(sim_op op) : mips_op(op) {
     this->op_class = oper_type::alu;
@@ -220,7 +312,7 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(m->src0_prf != -1 and not(machine_state.cpr1_valid.get_bit(m->src0_prf))) {
+    if(m->src0_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src0_prf))) {
       return false;
     }
     return true;
@@ -235,7 +327,7 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.gpr_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::gpr, m->prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -269,6 +361,7 @@ public:
 
 
 class lo_hi_move : public mips_op {
+  MIPS_OP_CLONE(lo_hi_move)
 public:
   enum class lo_hi_type {mfhi, mflo, mthi, mtlo};
 protected:
@@ -318,7 +411,7 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.gpr_valid.get_bit(m->src0_prf))) {
+    if(not(src_ready(machine_state, reg_file::gpr, m->src0_prf))) {
       return false;
     }
     return true;
@@ -331,7 +424,7 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.gpr_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::gpr, m->prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -359,6 +452,7 @@ public:
 };
 
 class nop : public mips_op {
+  MIPS_OP_CLONE(nop)
 public:
   nop(sim_op op) : mips_op(op) {
     this->op_class = oper_type::alu;
@@ -385,6 +479,7 @@ public:
 };
 
 class rtype_alu_op : public mips_op {
+  MIPS_OP_CLONE(rtype_alu_op)
 public:
   enum class r_type {
     sll, srl, sra, srlv, srav,
@@ -446,13 +541,13 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(m->src0_prf != -1 and not(machine_state.gpr_valid.get_bit(m->src0_prf))) {
+    if(m->src0_prf != -1 and not(src_ready(machine_state, reg_file::gpr, m->src0_prf))) {
       return false;
     }
-    if(m->src1_prf != -1 and not(machine_state.gpr_valid.get_bit(m->src1_prf))) {
+    if(m->src1_prf != -1 and not(src_ready(machine_state, reg_file::gpr, m->src1_prf))) {
       return false;
     }
-    if(m->src2_prf != -1 and not(machine_state.gpr_valid.get_bit(m->src2_prf))) {
+    if(m->src2_prf != -1 and not(src_ready(machine_state, reg_file::gpr, m->src2_prf))) {
       return false;
     }
     return true;
@@ -544,7 +639,7 @@ public:
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
       if(m->prf_idx != -1) {
-	machine_state.gpr_valid.set_bit(m->prf_idx);
+	machine_state.broadcast(reg_file::gpr, m->prf_idx);
       }
     }
   }
@@ -587,6 +682,7 @@ public:
 
 
 class itype_alu_op : public mips_op {
+  MIPS_OP_CLONE(itype_alu_op)
 protected:
   itype i_;
 public:
@@ -618,7 +714,7 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override  {
-    if(m->src0_prf != -1 and not(machine_state.gpr_valid.get_bit(m->src0_prf))) {
+    if(m->src0_prf != -1 and not(src_ready(machine_state, reg_file::gpr, m->src0_prf))) {
       return false;
     }
     return true;
@@ -658,7 +754,7 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.gpr_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::gpr, m->prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -694,6 +790,7 @@ public:
 
 
 class itype_lui_op : public itype_alu_op {
+  MIPS_OP_CLONE(itype_lui_op)
 public:
   itype_lui_op(sim_op op) : itype_alu_op(op) {}
   int get_src0() const override {
@@ -709,6 +806,7 @@ public:
 
 
 class jump_op : public mips_op {
+  MIPS_OP_CLONE(jump_op)
 public:
   enum class jump_type {jalr, jr, j, jal}; 
 protected:
@@ -762,7 +860,7 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override  {
-    if(m->src0_prf != -1 and not(machine_state.gpr_valid.get_bit(m->src0_prf))) {
+    if(m->src0_prf != -1 and not(src_ready(machine_state, reg_file::gpr, m->src0_prf))) {
       return false;
     }
     return true;
@@ -771,7 +869,7 @@ public:
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
       if(m->prf_idx != -1) {
-	machine_state.gpr_valid.set_bit(m->prf_idx);
+	machine_state.broadcast(reg_file::gpr, m->prf_idx);
       }
     }
   }
@@ -841,9 +939,10 @@ public:
     machine_state.icnt++;
     machine_state.n_jumps++;
     
-    /* strongly taken */
-    branch_target_map[m->pc] = m->correct_pc;
-    branch_prediction_map[m->pc] = 3;
+    /* jr predicts from the return stack, fetch never reads the btb for it */
+    if(jt != jump_type::jr) {
+      machine_state.btb->update(m->pc, m->correct_pc);
+    }
 
 
     machine_state.branch_pred->update(m->pc, m->pht_idx, true);
@@ -895,6 +994,7 @@ public:
 
 
 class branch_op : public mips_op {
+  MIPS_OP_CLONE(branch_op)
 public:
   enum class branch_type {
     beq, bne, blez, bgtz,
@@ -938,16 +1038,16 @@ protected:
     return false;
   }
   bool gpr_ready(sim_state &machine_state) const {
-    if(m->src0_prf != -1 and not(machine_state.gpr_valid[m->src0_prf])) {
+    if(m->src0_prf != -1 and not(src_ready(machine_state, reg_file::gpr, m->src0_prf))) {
       return false;
     }
-    if(m->src1_prf != -1 and not(machine_state.gpr_valid[m->src1_prf])) {
+    if(m->src1_prf != -1 and not(src_ready(machine_state, reg_file::gpr, m->src1_prf))) {
       return false;
     }
     return true;
   }
   bool fp_ready(sim_state &machine_state) const {
-    return machine_state.fcr1_valid[m->src0_prf];
+    return src_ready(machine_state, reg_file::fcr1, m->src0_prf);
   }
 public:
   branch_op(sim_op op, branch_type bt) :
@@ -1139,18 +1239,7 @@ public:
       machine_state.bht.at(bht_idx).set_bit(0);
     }
     
-    branch_target_map[m->pc] = branch_target;
-    if(branch_prediction_map.find(m->pc)==branch_prediction_map.end()) {
-      /* initialize as either weakly taken or weakly not-taken */
-      branch_prediction_map[m->pc] = take_br ? 2 : 1;
-    }
-    else {
-      int32_t counter = branch_prediction_map.at(m->pc);
-      counter = take_br ? counter + 1 : counter - 1;
-      counter = std::min(3, counter);
-      counter = std::max(0, counter);
-      branch_prediction_map.at(m->pc) = counter;
-    }
+    machine_state.btb->update(m->pc, branch_target);
     m->retire_cycle = get_curr_cycle();
     log_retire(machine_state);
     return true;
@@ -1162,6 +1251,7 @@ public:
 
 
 class load_op : public mips_load {
+  MIPS_OP_CLONE(load_op)
 protected:
   int32_t prev_value;
 public:
@@ -1205,13 +1295,13 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.gpr_valid.get_bit(m->src0_prf))) {
+    if(not(src_ready(machine_state, reg_file::gpr, m->src0_prf))) {
       return false;
     }
-    if(m->src1_prf != -1 and not(machine_state.gpr_valid.get_bit(m->src1_prf))) {
+    if(m->src1_prf != -1 and not(src_ready(machine_state, reg_file::gpr, m->src1_prf))) {
       return false;
     }
-    if(stall_for_load(machine_state)) {
+    if(stall_for_store(machine_state)) {
       return false;
     }
     return true;
@@ -1234,13 +1324,25 @@ public:
       default:
 	break;
       }
-
-    if(machine_state.l1d) {
-      machine_state.l1d->read(m, effective_address & (~3U), 4);
-    }
-    else {
-      m->complete_cycle = get_curr_cycle() + sim_param::l1d_latency;
-    }
+    uint32_t addr = effective_address, len = 4;
+    switch(lt)
+      {
+      case load_type::lb:
+      case load_type::lbu:
+	len = 1;
+	break;
+      case load_type::lh:
+      case load_type::lhu:
+	len = 2;
+	break;
+      case load_type::lwl:
+      case load_type::lwr:
+	addr &= ~3U;
+	break;
+      default:
+	break;
+      }
+    lsq_execute(machine_state, addr, len, effective_address & (~3U), 4);
   }
   int64_t get_latency() const override {
     return sim_param::l1d_latency;
@@ -1248,34 +1350,36 @@ public:
   
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
+      if(not(m->load_exception) and not(lsq_read(machine_state))) {
+	return;
+      }
       m->is_complete = true;
-      sparse_mem & mem = *(machine_state.mem);
       if(not(m->load_exception)) {
 	switch(lt)
 	  {
 	  case load_type::lb:
 	    machine_state.gpr_prf[m->prf_idx] = 
-	      bswap(*reinterpret_cast<int8_t*>(mem + effective_address));
+	      bswap(ld_get<int8_t>(effective_address));
 	    break;
 	  case load_type::lbu:
 	    *reinterpret_cast<uint32_t*>(&machine_state.gpr_prf[m->prf_idx]) = 
-	      static_cast<uint32_t>(mem.at(effective_address));
+	      static_cast<uint32_t>(ld_get<uint8_t>(effective_address));
 	    break;
 	  case load_type::lh:
 	    machine_state.gpr_prf[m->prf_idx] = 
-	      bswap(*reinterpret_cast<int16_t*>(mem + effective_address));
+	      bswap(ld_get<int16_t>(effective_address));
 	    break;
 	  case load_type::lhu:
 	    *reinterpret_cast<uint32_t*>(&machine_state.gpr_prf[m->prf_idx]) = 
-	      static_cast<uint32_t>(bswap(*reinterpret_cast<uint16_t*>(mem + effective_address)));
+	      static_cast<uint32_t>(bswap(ld_get<uint16_t>(effective_address)));
 	    break;
 	  case load_type::lw:
 	    machine_state.gpr_prf[m->prf_idx] =
-	      bswap(*reinterpret_cast<int32_t*>(mem + effective_address));
+	      bswap(ld_get<int32_t>(effective_address));
 	    break;
 	  case load_type::lwl: {
 	    uint32_t ea = effective_address & 0xfffffffc;
-	    uint32_t r = bswap(*reinterpret_cast<uint32_t*>(mem + ea));
+	    uint32_t r = bswap(ld_get<uint32_t>(ea));
 	    uint32_t x = *reinterpret_cast<uint32_t*>(&prev_value);
 	    uint32_t *d = reinterpret_cast<uint32_t*>(&machine_state.gpr_prf[m->prf_idx]);
 	    switch(effective_address & 3)
@@ -1297,7 +1401,7 @@ public:
 	  }
 	  case load_type::lwr: {
 	    uint32_t ea = effective_address & 0xfffffffc;
-	    uint32_t r = bswap(*reinterpret_cast<uint32_t*>(mem + ea));
+	    uint32_t r = bswap(ld_get<uint32_t>(ea));
 	    uint32_t x = *reinterpret_cast<uint32_t*>(&prev_value);
 	    uint32_t *d = reinterpret_cast<uint32_t*>(&machine_state.gpr_prf[m->prf_idx]);
 	    switch(effective_address & 3)
@@ -1321,7 +1425,7 @@ public:
 	    std::cerr << *this << "\n";
 	    die();
 	  }
-	machine_state.gpr_valid.set_bit(m->prf_idx);
+	machine_state.broadcast(reg_file::gpr, m->prf_idx);
       }
     }
   }
@@ -1330,6 +1434,7 @@ public:
       die();
     }
 
+    lsq_release(machine_state);
     machine_state.load_tbl[m->load_tbl_idx] = nullptr;
     machine_state.load_tbl_freevec.clear_bit(m->load_tbl_idx);
     machine_state.gpr_freevec.clear_bit(m->prev_prf_idx);
@@ -1353,6 +1458,7 @@ public:
     machine_state.gpr_rat[get_dest()] = m->prev_prf_idx;
     machine_state.gpr_freevec.clear_bit(m->prf_idx);
     machine_state.gpr_valid.clear_bit(m->prf_idx);
+    lsq_release(machine_state);
     machine_state.load_tbl_freevec.clear_bit(m->load_tbl_idx);
     machine_state.load_tbl[m->load_tbl_idx] = nullptr;
     log_rollback(machine_state);
@@ -1360,6 +1466,7 @@ public:
 };
 
 class store_op : public mips_store {
+  MIPS_OP_CLONE(store_op)
 public:
   enum class store_type {sb, sh, sw, swl, swr}; 
 protected:
@@ -1386,8 +1493,11 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.gpr_valid.get_bit(m->src0_prf)) or
-       not(machine_state.gpr_valid.get_bit(m->src1_prf))) {
+    if(not(src_ready(machine_state, reg_file::gpr, m->src0_prf)) or
+       not(src_ready(machine_state, reg_file::gpr, m->src1_prf))) {
+      return false;
+    }
+    if(stall_for_store(machine_state)) {
       return false;
     }
     return true;
@@ -1395,8 +1505,33 @@ public:
   void execute(sim_state &machine_state) override {
     effective_address = machine_state.gpr_prf[m->src1_prf] + imm;
     store_data = machine_state.gpr_prf[m->src0_prf];
+    uint32_t sd = static_cast<uint32_t>(store_data), ma = effective_address & 3;
+    switch(st)
+      {
+      case store_type::sb:
+	set_store_bytes(machine_state, effective_address, 1, sd);
+	break;
+      case store_type::sh:
+	set_store_bytes(machine_state, effective_address, 2, sd);
+	break;
+      case store_type::sw:
+	set_store_bytes(machine_state, effective_address, 4, sd);
+	break;
+      case store_type::swl:
+	/* ea up to the end of the word */
+	set_store_bytes(machine_state, effective_address, 4-ma, sd >> (8*ma));
+	break;
+      case store_type::swr:
+	/* start of the word up to ea */
+	set_store_bytes(machine_state, effective_address & 0xfffffffc, ma+1, sd);
+	break;
+      default:
+	std::cerr << *this << "\n";
+	die();
+      }
     if(machine_state.l1d) {
-      machine_state.l1d->write(m,effective_address & (~3U), 4);
+      uint32_t delay = machine_state.mmu ? machine_state.mmu->translate_data(effective_address, m->pc) : 0;
+      machine_state.l1d->write(m,effective_address & (~3U), 4, delay);
     }
     else {
       m->complete_cycle = get_curr_cycle() + 1;/*sim_param::l1d_latency;*/
@@ -1411,85 +1546,10 @@ public:
     }
   }
   bool retire(sim_state &machine_state) override {
-    sparse_mem & mem = *(machine_state.mem);
-    switch(st)
-      {
-      case store_type::sb:
-	mem.at(effective_address) = static_cast<int8_t>(store_data);
-	break;
-      case store_type::sh:
-	mem.set<int16_t>(effective_address,
-			 bswap(static_cast<int16_t>(store_data)));
-	break;
-      case store_type::sw:
-	mem.set<int32_t>(effective_address, bswap(store_data));
-	break;
-      case store_type::swl: {
-	uint32_t ma = effective_address & 3;
-	uint32_t ea = effective_address & 0xfffffffc;
-	uint32_t sd = store_data >> (8*ma);
-	uint32_t r = bswap(*reinterpret_cast<uint32_t*>(mem + ea));
-	uint32_t m =
-	  ma==0 ? 0x00000000 :
-	  ma==1 ? 0xff000000 :
-	  ma==2 ? 0xffff0000 :
-	  0xffffff00;
-	
-	sd |= (r&m);
-	mem.set<int32_t>(ea, bswap(sd));
-	break;
-      }
-      case store_type::swr: {	
-	uint32_t ma = effective_address & 3;
-	uint32_t ea = effective_address & 0xfffffffc;
-	uint32_t sd = store_data << ((3-ma)*8);
-	uint32_t r = bswap(*reinterpret_cast<uint32_t*>(mem + ea));
-	uint32_t m =
-	  ma==0 ? 0x00ffffff :
-	  ma==1 ? 0x0000ffff :
-	  ma==2 ? 0x000000ff :
-	  0x00000000;
-	sd |= (m & r);
-	mem.set<int32_t>(ea, bswap(sd));
-	break;
-      }
-	
-      default:
-	std::cerr << *this << "\n";
-	die();
-      }
+    write_store_bytes(machine_state);
     retired = true;
     machine_state.icnt++;
 
-    bool load_violation = false;
-    for(size_t i = 0; i < machine_state.load_tbl_freevec.size(); i++ ){
-      if(machine_state.load_tbl[i]==nullptr) {
-	continue;
-      }
-      mips_meta_op *mmo = machine_state.load_tbl[i];
-      if(mmo->alloc_cycle < m->alloc_cycle) {
-	continue;
-      }
-
-      auto ld = reinterpret_cast<mips_load*>(mmo->op);
-      if(ld == nullptr) {
-	die();
-      }
-      if(mmo->is_complete and (effective_address>>3) == (ld->getEA()>>3)) {
-	load_violation = true;
-	load_alias_map[mmo->pc].insert(m->pc);
-	//std::cout << "load / store exception, store pc = " << std::hex << m->pc
-	//<< ", load pc = " << mmo->pc << std::dec << "\n";
-
-      }
-    }
-
-    for(size_t i = 0; load_violation and (i < machine_state.load_tbl_freevec.size()); i++ ){
-      if(machine_state.load_tbl[i]!=nullptr) {
-	machine_state.load_tbl[i]->load_exception = true;
-      }
-    }
-    
     machine_state.store_tbl_freevec.clear_bit(m->store_tbl_idx);
     machine_state.store_tbl[m->store_tbl_idx] = nullptr;
     m->retire_cycle = get_curr_cycle();
@@ -1501,7 +1561,7 @@ public:
 		<< *this
 		<< " "
 		<< std::hex
-		<< mem.crc32()
+		<< machine_state.mem->crc32()
 		<< std::dec
 		<< "\n";
     }
@@ -1510,6 +1570,7 @@ public:
     return true;
   }
   void rollback(sim_state &machine_state) override {
+    release_store_bytes(machine_state);
     machine_state.store_tbl_freevec.clear_bit(m->store_tbl_idx);
     machine_state.store_tbl[m->store_tbl_idx] = nullptr;
     log_rollback(machine_state);
@@ -1518,6 +1579,7 @@ public:
 
 
 class fp_load_op : public mips_load {
+  MIPS_OP_CLONE(fp_load_op)
 public:
   fp_load_op(sim_op op, load_type lt) : mips_load(op) {
     this->lt = lt;
@@ -1574,14 +1636,14 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.gpr_valid.get_bit(m->src0_prf)))
+    if(not(src_ready(machine_state, reg_file::gpr, m->src0_prf)))
       return false;
 
-    if(get_src1()!=-1 and not(machine_state.gpr_valid.get_bit(m->src1_prf))) {
+    if(get_src1()!=-1 and not(src_ready(machine_state, reg_file::gpr, m->src1_prf))) {
       return false;
     }
     
-    if(stall_for_load(machine_state))
+    if(stall_for_store(machine_state))
       return false;
 
     return true;
@@ -1607,33 +1669,30 @@ public:
 	break;
       }
 
-    if(machine_state.l1d) {
-      machine_state.l1d->read(m, effective_address, b);
-    }
-    else {
-      m->complete_cycle = get_curr_cycle() + sim_param::l1d_latency;
-    }
+    lsq_execute(machine_state, effective_address, b, effective_address, b);
   }
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
+      if(not(m->load_exception) and not(lsq_read(machine_state))) {
+	return;
+      }
       m->is_complete = true;
-      sparse_mem & mem = *(machine_state.mem);
       if(not(m->load_exception)) {
 	switch(lt)
 	  {
 	  case load_type::ldxc1:
 	  case load_type::ldc1: {
-	    load_thunk<uint64_t> ld(bswap(*((uint64_t*)(mem + effective_address))));
+	    load_thunk<uint64_t> ld(bswap(ld_get<uint64_t>(effective_address)));
 	    machine_state.cpr1_prf[m->prf_idx] = ld[0];
 	    machine_state.cpr1_prf[m->aux_prf_idx] = ld[1];
-	    machine_state.cpr1_valid.set_bit(m->prf_idx);
-	    machine_state.cpr1_valid.set_bit(m->aux_prf_idx);
+	    machine_state.broadcast(reg_file::cpr1, m->prf_idx);
+	    machine_state.broadcast(reg_file::cpr1, m->aux_prf_idx);
 	    break;
 	  }
 	  case load_type::lwxc1:
 	  case load_type::lwc1:
-	    machine_state.cpr1_prf[m->prf_idx] = bswap(*((uint32_t*)(mem + effective_address)));
-	    machine_state.cpr1_valid.set_bit(m->prf_idx);
+	    machine_state.cpr1_prf[m->prf_idx] = bswap(ld_get<uint32_t>(effective_address));
+	    machine_state.broadcast(reg_file::cpr1, m->prf_idx);
 	    break;
 	  default:
 	    std::cerr << "unimplemented.." << __PRETTY_FUNCTION__ << "\n";
@@ -1643,6 +1702,7 @@ public:
     }
   }
   bool retire(sim_state &machine_state) override {
+    lsq_release(machine_state);
     machine_state.load_tbl[m->load_tbl_idx] = nullptr;
     machine_state.load_tbl_freevec.clear_bit(m->load_tbl_idx);
 
@@ -1671,6 +1731,7 @@ public:
     return true;
   }
   void rollback(sim_state &machine_state) override {
+    lsq_release(machine_state);
     machine_state.load_tbl[m->load_tbl_idx] = nullptr;
     machine_state.load_tbl_freevec.clear_bit(m->load_tbl_idx);
     machine_state.cpr1_rat[get_dest()] = m->prev_prf_idx;
@@ -1686,6 +1747,7 @@ public:
 };
 
 class fp_store_op : public mips_store {
+  MIPS_OP_CLONE(fp_store_op)
 public:
   enum class store_type {sdc1, swc1}; 
 protected:
@@ -1718,13 +1780,16 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.cpr1_valid.get_bit(m->src0_prf))) {
+    if(not(src_ready(machine_state, reg_file::cpr1, m->src0_prf))) {
+      return false;
+    }
+    if(not(src_ready(machine_state, reg_file::gpr, m->src1_prf))) {
       return false;
     }
-    if(not(machine_state.gpr_valid.get_bit(m->src1_prf))) {
+    if(m->src2_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src2_prf))) {
       return false;
     }
-    if(m->src2_prf != -1 and not(machine_state.cpr1_valid.get_bit(m->src2_prf))) {
+    if(stall_for_store(machine_state)) {
       return false;
     }
     return true;
@@ -1743,8 +1808,12 @@ public:
 	store_data[0] = *reinterpret_cast<uint32_t*>(&machine_state.cpr1_prf[m->src0_prf]);
 	break;
       }
+    set_store_bytes(machine_state, effective_address, b,
+		    (b == 8) ? ((static_cast<uint64_t>(store_data[1]) << 32) | store_data[0]) :
+		    store_data[0]);
     if(machine_state.l1d) {
-      machine_state.l1d->write(m,effective_address, b);
+      uint32_t delay = machine_state.mmu ? machine_state.mmu->translate_data(effective_address, m->pc) : 0;
+      machine_state.l1d->write(m,effective_address, b, delay);
     }
     else {
       m->complete_cycle = get_curr_cycle() + sim_param::l1d_latency;
@@ -1759,70 +1828,7 @@ public:
     }
   }
   bool retire(sim_state &machine_state) override {
-    sparse_mem & mem = *(machine_state.mem);
-    switch(st)
-      {
-      case store_type::swc1:
-	mem.set<uint32_t>(effective_address, bswap(store_data[0]));
-	break;
-      case store_type::sdc1: {
-	load_thunk<uint64_t> ld;
-	ld[0] = store_data[0];
-	ld[1] = store_data[1];
-	mem.set<uint64_t>(effective_address, bswap(ld.DT()));
-	break;
-      }
-      default:
-	die();
-      }
-
-    bool load_violation = false;
-    for(size_t i = 0; i < machine_state.load_tbl_freevec.size(); i++ ){
-      if(machine_state.load_tbl[i]==nullptr) {
-	continue;
-      }
-      mips_meta_op *mmo = machine_state.load_tbl[i];
-      if(mmo->alloc_cycle < m->alloc_cycle) {
-	continue;
-      }
-      auto ld = reinterpret_cast<mips_load*>(mmo->op);
-      if(ld == nullptr) {
-	die();
-      }
-      if(mmo->is_complete and ((effective_address>>3) == (ld->getEA()>>3))) {
-	load_violation = true;
-#if 0
-	auto it = load_alias_map.find(mmo->pc);
-	if(it != load_alias_map.end()) {
-	  bool seen_st = (it->second.find(m->pc) != it->second.end());
-	  std::cout << "load exception @ curr cycle " << get_curr_cycle() << "\n";;
-	  std::cout << "\tload pc 0x"
-		    << std::hex << mmo->pc << std::dec << "\n";
-	  if(seen_st) {
-	    std::cout << std::hex << "\tstore pc 0x" << m->pc << std::dec << "\n";
-	  }
-	  std::cout << "\tstore tbl slot " << m->store_tbl_idx << "\n";
-	  std::cout << "\tload alloc "<< mmo->alloc_cycle << "\n";
-	  std::cout << "\tload ready "<< mmo->ready_cycle << "\n";
-	  std::cout << "\tload complete "<< mmo->complete_cycle << "\n";
-	  std::cout << "\tstore alloc "<< m->alloc_cycle << "\n";
-	  std::cout << "\tstore ready "<< m->ready_cycle << "\n";
-
-	  //exit(-1);
-	}
-#endif
-	load_alias_map[mmo->pc].insert(m->pc);
-	//std::cout << "load / store exception, store pc = " << std::hex << m->pc
-	//<< ", load pc = " << mmo->pc << std::dec << "\n";
-	
-      }
-    }
-    for(size_t i = 0; load_violation and (i < machine_state.load_tbl_freevec.size()); i++ ){
-      if(machine_state.load_tbl[i]!=nullptr) {
-	machine_state.load_tbl[i]->load_exception = true;
-      }
-    }
-
+    write_store_bytes(machine_state);
     machine_state.store_tbl_freevec.clear_bit(m->store_tbl_idx);
     machine_state.store_tbl[m->store_tbl_idx] = nullptr;
     
@@ -1833,6 +1839,7 @@ public:
     return true;
   }
   void rollback(sim_state &machine_state) override {
+    release_store_bytes(machine_state);
     machine_state.store_tbl_freevec.clear_bit(m->store_tbl_idx);
     machine_state.store_tbl[m->store_tbl_idx] = nullptr;
     log_rollback(machine_state);
@@ -1841,6 +1848,7 @@ public:
 
 
 class mul_op : public mips_op {
+  MIPS_OP_CLONE(mul_op)
 public:
   mul_op(sim_op op) : mips_op(op) {
     this->op_class = oper_type::alu;
@@ -1868,10 +1876,10 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.gpr_valid.get_bit(m->src0_prf))) {
+    if(not(src_ready(machine_state, reg_file::gpr, m->src0_prf))) {
       return false;
     }
-    if(not(machine_state.gpr_valid.get_bit(m->src1_prf))) {
+    if(not(src_ready(machine_state, reg_file::gpr, m->src1_prf))) {
       return false;
     }
     return true;
@@ -1889,7 +1897,7 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.gpr_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::gpr, m->prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -1916,6 +1924,7 @@ public:
 };
 
 class clz_op : public mips_op {
+  MIPS_OP_CLONE(clz_op)
 public:
   clz_op(sim_op op) : mips_op(op) {
     this->op_class = oper_type::alu;
@@ -1939,7 +1948,7 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.gpr_valid.get_bit(m->src0_prf))) {
+    if(not(src_ready(machine_state, reg_file::gpr, m->src0_prf))) {
       return false;
     }
     return true;
@@ -1956,7 +1965,7 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.gpr_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::gpr, m->prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -1984,6 +1993,7 @@ public:
 
 
 class mult_div_op : public mips_op {
+  MIPS_OP_CLONE(mult_div_op)
 public:
   enum class mult_div_types {mult, multu, div, divu, madd, msub, maddu};
 protected:
@@ -2059,14 +2069,14 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.gpr_valid.get_bit(m->src0_prf)) or
-       not(machine_state.gpr_valid.get_bit(m->src1_prf))) {
+    if(not(src_ready(machine_state, reg_file::gpr, m->src0_prf)) or
+       not(src_ready(machine_state, reg_file::gpr, m->src1_prf))) {
       return false;
     }
-    if(m->src2_prf != -1 and not(machine_state.gpr_valid.get_bit(m->src2_prf))) {
+    if(m->src2_prf != -1 and not(src_ready(machine_state, reg_file::gpr, m->src2_prf))) {
       return false;
     }
-    if(m->src3_prf != -1 and not(machine_state.gpr_valid.get_bit(m->src3_prf))) {
+    if(m->src3_prf != -1 and not(src_ready(machine_state, reg_file::gpr, m->src3_prf))) {
       return false;
     }
     return true;
@@ -2159,8 +2169,8 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.gpr_valid.set_bit(m->lo_prf_idx);
-      machine_state.gpr_valid.set_bit(m->hi_prf_idx);
+      machine_state.broadcast(reg_file::gpr, m->lo_prf_idx);
+      machine_state.broadcast(reg_file::gpr, m->hi_prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -2199,6 +2209,7 @@ public:
 
 
 class se_op : public mips_op {
+  MIPS_OP_CLONE(se_op)
 public:
   enum class se_type {seb, seh};
 protected:
@@ -2225,7 +2236,7 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    return machine_state.gpr_valid.get_bit(m->src0_prf);
+    return src_ready(machine_state, reg_file::gpr, m->src0_prf);
   }
   void execute(sim_state &machine_state) override {
     switch(st)
@@ -2244,7 +2255,7 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.gpr_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::gpr, m->prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -2271,6 +2282,7 @@ public:
 };
 
 class ext_op : public mips_op {
+  MIPS_OP_CLONE(ext_op)
 public:
   ext_op(sim_op op) : mips_op(op) {
     this->op_class = oper_type::alu;
@@ -2293,7 +2305,7 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    return machine_state.gpr_valid.get_bit(m->src0_prf);
+    return src_ready(machine_state, reg_file::gpr, m->src0_prf);
   }
   void execute(sim_state &machine_state) override {
     uint32_t pos = (m->inst >> 6) & 31;
@@ -2305,7 +2317,7 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.gpr_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::gpr, m->prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -2331,6 +2343,7 @@ public:
 
 
 class ins_op : public mips_op {
+  MIPS_OP_CLONE(ins_op)
 public:
   ins_op(sim_op op) : mips_op(op) {
     this->op_class = oper_type::alu;
@@ -2357,9 +2370,9 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.gpr_valid.get_bit(m->src0_prf)))
+    if(not(src_ready(machine_state, reg_file::gpr, m->src0_prf)))
       return false;
-    if(not(machine_state.gpr_valid.get_bit(m->src1_prf)))
+    if(not(src_ready(machine_state, reg_file::gpr, m->src1_prf)))
       return false;
     return true;
   }
@@ -2377,7 +2390,7 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.gpr_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::gpr, m->prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -2403,6 +2416,7 @@ public:
 
 
 class movci_op : public mips_op {
+  MIPS_OP_CLONE(movci_op)
 public:
   movci_op(sim_op op) : mips_op(op) {
     this->op_class = oper_type::alu;
@@ -2430,11 +2444,11 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.gpr_valid.get_bit(m->src0_prf)))
+    if(not(src_ready(machine_state, reg_file::gpr, m->src0_prf)))
       return false;
-    if(not(machine_state.gpr_valid.get_bit(m->src1_prf)))
+    if(not(src_ready(machine_state, reg_file::gpr, m->src1_prf)))
       return false;
-    if(not(machine_state.fcr1_valid.get_bit(m->src2_prf)))
+    if(not(src_ready(machine_state, reg_file::fcr1, m->src2_prf)))
       return false;
     return true;
   }
@@ -2455,7 +2469,7 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.gpr_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::gpr, m->prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -2481,6 +2495,7 @@ public:
 
 
 class fmovc_op : public mips_op {
+  MIPS_OP_CLONE(fmovc_op)
 protected:
   uint32_t fmt;
   void execute_double(sim_state &machine_state) {
@@ -2555,19 +2570,19 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.cpr1_valid[m->src0_prf])) {
+    if(not(src_ready(machine_state, reg_file::cpr1, m->src0_prf))) {
       return false;
     }
-    if(not(machine_state.cpr1_valid[m->src1_prf])) {
+    if(not(src_ready(machine_state, reg_file::cpr1, m->src1_prf))) {
       return false;
     }
-    if(not(machine_state.fcr1_valid[m->src4_prf])) {
+    if(not(src_ready(machine_state, reg_file::fcr1, m->src4_prf))) {
       return false;
     }
-    if(m->src2_prf != -1 and not(machine_state.cpr1_valid[m->src2_prf])) {
+    if(m->src2_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src2_prf))) {
       return false;
     }
-    if(m->src3_prf != -1 and not(machine_state.cpr1_valid[m->src3_prf])) {
+    if(m->src3_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src3_prf))) {
       return false;
     }
     return true;
@@ -2575,9 +2590,9 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.cpr1_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::cpr1, m->prf_idx);
       if(fmt == FMT_D) {
-	machine_state.cpr1_valid.set_bit(m->aux_prf_idx);
+	machine_state.broadcast(reg_file::cpr1, m->aux_prf_idx);
       }
     }
   }
@@ -2686,19 +2701,19 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.cpr1_valid[m->src0_prf])) {
+    if(not(src_ready(machine_state, reg_file::cpr1, m->src0_prf))) {
       return false;
     }
-    if(not(machine_state.cpr1_valid[m->src1_prf])) {
+    if(not(src_ready(machine_state, reg_file::cpr1, m->src1_prf))) {
       return false;
     }
-    if(not(machine_state.gpr_valid[m->src4_prf])) {
+    if(not(src_ready(machine_state, reg_file::gpr, m->src4_prf))) {
       return false;
     }
-    if(m->src2_prf != -1 and not(machine_state.cpr1_valid[m->src2_prf])) {
+    if(m->src2_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src2_prf))) {
       return false;
     }
-    if(m->src3_prf != -1 and not(machine_state.cpr1_valid[m->src3_prf])) {
+    if(m->src3_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src3_prf))) {
       return false;
     }
     return true;
@@ -2706,9 +2721,9 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.cpr1_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::cpr1, m->prf_idx);
       if(fmt == FMT_D) {
-	machine_state.cpr1_valid.set_bit(m->aux_prf_idx);
+	machine_state.broadcast(reg_file::cpr1, m->aux_prf_idx);
       }
     }
   }
@@ -2761,6 +2776,7 @@ public:
 };
 
 class fmovn_op : public fmov_op {
+  MIPS_OP_CLONE(fmovn_op)
 protected:
   void execute_double(sim_state &machine_state) override {
     /* src0 - fs, src1 - old fd */
@@ -2780,6 +2796,7 @@ public:
 };
 
 class fmovz_op : public fmov_op {
+  MIPS_OP_CLONE(fmovz_op)
 protected:
   void execute_double(sim_state &machine_state) override {
     /* src0 - fs, src1 - old fd */
@@ -2801,6 +2818,7 @@ public:
 
 
 class fp_cmp : public mips_op {
+  MIPS_OP_CLONE(fp_cmp)
 protected:
   uint32_t fmt;
   template <typename T>
@@ -2881,19 +2899,19 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.cpr1_valid[m->src0_prf])) {
+    if(not(src_ready(machine_state, reg_file::cpr1, m->src0_prf))) {
       return false;
     }
-    if(not(machine_state.cpr1_valid[m->src1_prf])) {
+    if(not(src_ready(machine_state, reg_file::cpr1, m->src1_prf))) {
       return false;
     }
-    if(not(machine_state.fcr1_valid[m->src4_prf])) {
+    if(not(src_ready(machine_state, reg_file::fcr1, m->src4_prf))) {
       return false;
     }
-    if(m->src2_prf != -1 and not(machine_state.cpr1_valid[m->src2_prf])) {
+    if(m->src2_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src2_prf))) {
       return false;
     }
-    if(m->src3_prf != -1 and not(machine_state.cpr1_valid[m->src3_prf])) {
+    if(m->src3_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src3_prf))) {
       return false;
     }
     return true;
@@ -2901,7 +2919,7 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.fcr1_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::fcr1, m->prf_idx);
     }
   }
   void execute(sim_state &machine_state) override {
@@ -2942,6 +2960,7 @@ public:
 };
 
 class fp_arith_op : public mips_op {
+  MIPS_OP_CLONE(fp_arith_op)
 public:
   enum class fp_op_type {add, sub, mul, div, sqrt, abs, mov, neg, recip, rsqrt};
 protected:
@@ -3124,16 +3143,16 @@ public:
   }
 					
   bool ready(sim_state &machine_state) const override {
-    if(m->src0_prf != -1 and not(machine_state.cpr1_valid[m->src0_prf])) {
+    if(m->src0_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src0_prf))) {
       return false;
     }
-    if(m->src1_prf != -1 and not(machine_state.cpr1_valid[m->src1_prf])) {
+    if(m->src1_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src1_prf))) {
       return false;
     }
-    if(m->src2_prf != -1 and not(machine_state.cpr1_valid[m->src2_prf])) {
+    if(m->src2_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src2_prf))) {
       return false;
     }
-    if(m->src3_prf != -1 and not(machine_state.cpr1_valid[m->src3_prf])) {
+    if(m->src3_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src3_prf))) {
       return false;
     }
     return true;
@@ -3142,9 +3161,9 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.cpr1_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::cpr1, m->prf_idx);
       if(m->aux_prf_idx != -1) {
-	machine_state.cpr1_valid.set_bit(m->aux_prf_idx);
+	machine_state.broadcast(reg_file::cpr1, m->aux_prf_idx);
       }
     }
   }
@@ -3185,6 +3204,7 @@ public:
 };
 
 class fp_fma : public mips_op {
+  MIPS_OP_CLONE(fp_fma)
 public:
   enum class op_type {f32, f64};
 protected:
@@ -3295,22 +3315,22 @@ public:
     return allocated;
   }
   bool ready(sim_state &machine_state) const override {
-    if(m->src0_prf != -1 and not(machine_state.cpr1_valid[m->src0_prf])) {
+    if(m->src0_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src0_prf))) {
       return false;
     }
-    if(m->src1_prf != -1 and not(machine_state.cpr1_valid[m->src1_prf])) {
+    if(m->src1_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src1_prf))) {
       return false;
     }
-    if(m->src2_prf != -1 and not(machine_state.cpr1_valid[m->src2_prf])) {
+    if(m->src2_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src2_prf))) {
       return false;
     }
-    if(m->src3_prf != -1 and not(machine_state.cpr1_valid[m->src3_prf])) {
+    if(m->src3_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src3_prf))) {
       return false;
     }
-    if(m->src4_prf != -1 and not(machine_state.cpr1_valid[m->src4_prf])) {
+    if(m->src4_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src4_prf))) {
       return false;
     }
-    if(m->src5_prf != -1 and not(machine_state.cpr1_valid[m->src5_prf])) {
+    if(m->src5_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src5_prf))) {
       return false;
     }
     return true;
@@ -3318,9 +3338,9 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.cpr1_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::cpr1, m->prf_idx);
       if(m->aux_prf_idx != -1) {
-	machine_state.cpr1_valid.set_bit(m->aux_prf_idx);
+	machine_state.broadcast(reg_file::cpr1, m->aux_prf_idx);
       }
     }
   }
@@ -3367,6 +3387,7 @@ public:
 
 
 class cvts_truncw_op : public mips_op {
+  MIPS_OP_CLONE(cvts_truncw_op)
 public:
   enum class op_type {cvts, truncw};
 protected:
@@ -3430,9 +3451,9 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.cpr1_valid.get_bit(m->src0_prf)))
+    if(not(src_ready(machine_state, reg_file::cpr1, m->src0_prf)))
       return false;
-    if(m->src1_prf != -1 and not(machine_state.cpr1_valid.get_bit(m->src1_prf)))
+    if(m->src1_prf != -1 and not(src_ready(machine_state, reg_file::cpr1, m->src1_prf)))
       return false;
     return true;
   }
@@ -3453,7 +3474,7 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.cpr1_valid.set_bit(m->prf_idx);
+      machine_state.broadcast(reg_file::cpr1, m->prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -3481,6 +3502,7 @@ public:
 
 
 class cvtd_op : public mips_op {
+  MIPS_OP_CLONE(cvtd_op)
 protected:
   uint32_t fmt;
 public:
@@ -3512,7 +3534,7 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    return machine_state.cpr1_valid.get_bit(m->src0_prf);
+    return src_ready(machine_state, reg_file::cpr1, m->src0_prf);
   }
   void execute(sim_state &machine_state) override {
     load_thunk<double> dest;
@@ -3540,8 +3562,8 @@ public:
   void complete(sim_state &machine_state) override {
     if(not(m->is_complete) and (get_curr_cycle() == m->complete_cycle)) {
       m->is_complete = true;
-      machine_state.cpr1_valid.set_bit(m->prf_idx);
-      machine_state.cpr1_valid.set_bit(m->aux_prf_idx);
+      machine_state.broadcast(reg_file::cpr1, m->prf_idx);
+      machine_state.broadcast(reg_file::cpr1, m->aux_prf_idx);
     }
   }
   bool retire(sim_state &machine_state) override {
@@ -3582,6 +3604,7 @@ public:
 
 
 class break_op : public mips_op {
+  MIPS_OP_CLONE(break_op)
 public:
   break_op(sim_op op) : mips_op(op) {
     this->op_class = oper_type::system;
@@ -3617,6 +3640,7 @@ public:
 
 
 class sync_op : public mips_op {
+  MIPS_OP_CLONE(sync_op)
 public:
   sync_op(sim_op op) : mips_op(op) {
     this->op_class = oper_type::system;
@@ -3652,6 +3676,7 @@ public:
 
 
 class monitor_op : public mips_op {
+  MIPS_OP_CLONE(monitor_op)
 protected:
   int32_t src_regs[4] = {0};
   
@@ -3693,16 +3718,16 @@ public:
     return true;
   }
   bool ready(sim_state &machine_state) const override {
-    if(not(machine_state.gpr_valid.get_bit(m->src0_prf))) {
+    if(not(src_ready(machine_state, reg_file::gpr, m->src0_prf))) {
       return false;
     }
-    if(not(machine_state.gpr_valid.get_bit(m->src1_prf))) {
+    if(not(src_ready(machine_state, reg_file::gpr, m->src1_prf))) {
       return false;
     }
-    if(not(machine_state.gpr_valid.get_bit(m->src2_prf))) {
+    if(not(src_ready(machine_state, reg_file::gpr, m->src2_prf))) {
       return false;
     }
-    if(not(machine_state.gpr_valid.get_bit(m->src3_prf))) {
+    if(not(src_ready(machine_state, reg_file::gpr, m->src3_prf))) {
       return false;
     }
     return true;
@@ -3848,7 +3873,7 @@ public:
     }
     
     /* not valid until after this instruction retires */
-    machine_state.gpr_valid.set_bit(m->prf_idx);
+    machine_state.broadcast(reg_file::gpr, m->prf_idx);
     machine_state.gpr_freevec.clear_bit(m->prev_prf_idx);
 
     retired = true;
@@ -3875,6 +3900,7 @@ public:
 };
 
 class rtype_const_shift_alu_op : public rtype_alu_op {
+  MIPS_OP_CLONE(rtype_const_shift_alu_op)
 public:
   rtype_const_shift_alu_op(sim_op op, rtype_alu_op::r_type rt) : rtype_alu_op(op, rt) {}
    int get_src1() const override {
@@ -4287,6 +4313,61 @@ mips_op* decode_insn(sim_op m_op) {
   }
 }
 
+decode_cache::decode_cache(int lg_entries) {
+  entries.resize(1UL << lg_entries);
+  mask = (1U << lg_entries) - 1;
+}
+
+decode_cache::~decode_cache() {
+  for(entry &e : entries) {
+    if(e.proto) {
+      delete e.proto;
+    }
+  }
+}
+
+mips_op *decode_cache::decode(sim_op m_op) {
+  entry &e = entries[(m_op->pc >> 2) & mask];
+  if(e.proto and (e.pc == m_op->pc) and (e.inst == m_op->inst)) {
+    hits++;
+    m_op->could_cause_exception |= e.could_cause_exception;
+    m_op->is_branch_or_jump |= e.is_branch_or_jump;
+    m_op->is_jal |= e.is_jal;
+    m_op->is_jr |= e.is_jr;
+    m_op->has_delay_slot |= e.has_delay_slot;
+    m_op->is_store |= e.is_store;
+    m_op->is_fp_store |= e.is_fp_store;
+    return e.proto->clone(m_op);
+  }
+  misses++;
+  mips_op *op = decode_insn(m_op);
+  if(op == nullptr) {
+    return op;
+  }
+  mips_op *proto = op->clone(nullptr);
+  /* a subclass without its own clone would copy as its base */
+  if(proto == nullptr or (typeid(*proto) != typeid(*op))) {
+    if(proto) {
+      delete proto;
+    }
+    return op;
+  }
+  if(e.proto) {
+    delete e.proto;
+  }
+  e.pc = m_op->pc;
+  e.inst = m_op->inst;
+  e.proto = proto;
+  e.could_cause_exception = m_op->could_cause_exception;
+  e.is_branch_or_jump = m_op->is_branch_or_jump;
+  e.is_jal = m_op->is_jal;
+  e.is_jr = m_op->is_jr;
+  e.has_delay_slot = m_op->has_delay_slot;
+  e.is_store = m_op->is_store;
+  e.is_fp_store = m_op->is_fp_store;
+  return op;
+}
+
 mips_meta_op::~mips_meta_op() {
   if(op) {
     delete op;
@@ -4300,6 +4381,81 @@ void mips_meta_op::release() {
   }
 }
 
+namespace {
+/* per-thread free lists, one per 16 byte size class ; blocks
+ * freed on another thread (oracle frontend) just land here */
+struct op_slabs {
+  static const size_t gran = 16;
+  static const size_t n_bins = 32;
+  size_t limit = 0;
+  std::vector<void*> bins[n_bins];
+  ~op_slabs() {
+    for(size_t b = 0; b < n_bins; b++) {
+      for(void *p : bins[b]) {
+	::operator delete(p);
+      }
+    }
+  }
+};
+thread_local op_slabs slabs;
+}
+
+void *mips_op::operator new(size_t sz) {
+  size_t b = (sz + op_slabs::gran - 1) / op_slabs::gran;
+  if(b >= op_slabs::n_bins) {
+    return ::operator new(sz);
+  }
+  std::vector<void*> &bin = slabs.bins[b];
+  if(bin.empty()) {
+    return ::operator new(b * op_slabs::gran);
+  }
+  void *p = bin.back();
+  bin.pop_back();
+  return p;
+}
+
+void mips_op::operator delete(void *p, size_t sz) {
+  size_t b = (sz + op_slabs::gran - 1) / op_slabs::gran;
+  if(b >= op_slabs::n_bins or slabs.bins[b].size() >= slabs.limit) {
+    ::operator delete(p);
+    return;
+  }
+  slabs.bins[b].push_back(p);
+}
+
+void mips_op::set_pool_limit(size_t limit) {
+  slabs.limit = limit;
+  for(size_t b = 0; b < op_slabs::n_bins; b++) {
+    slabs.bins[b].reserve(limit);
+  }
+}
+
+bool mips_op::src_ready(sim_state &machine_state, reg_file rf, int32_t prf) const {
+  bool v = false;
+  switch(rf)
+    {
+    case reg_file::gpr:
+      v = machine_state.gpr_valid.get_bit(prf);
+      break;
+    case reg_file::cpr0:
+      v = machine_state.cpr0_valid.get_bit(prf);
+      break;
+    case reg_file::cpr1:
+      v = machine_state.cpr1_valid.get_bit(prf);
+      break;
+    case reg_file::fcr1:
+      v = machine_state.fcr1_valid.get_bit(prf);
+      break;
+    default:
+      die();
+    }
+  if(not(v)) {
+    m->wait_rf = rf;
+    m->wait_prf = prf;
+  }
+  return v;
+}
+
 bool mips_op::allocate(sim_state &machine_state) {
   die();
   return false;
@@ -5,12 +5,14 @@
 #include <vector>
 #include <list>
 #include <cassert>
+#include <cstring>
 #include "state.hh"
 #include "globals.hh"
 #include "sparse_mem.hh"
 #include "sim_queue.hh"
 #include "sim_bitvec.hh"
 #include "sim_list.hh"
+#include "sim_rs.hh"
 #include "sim_stack.hh"
 #include "mips.hh"
 #include "branch_predictor.hh"
@@ -115,12 +117,18 @@ public:
   int32_t prev_prf_idx = -1, aux_prev_prf_idx = -1;
   int32_t src0_prf = -1, src1_prf = -1, src2_prf = -1, src3_prf = -1, src4_prf = -1, src5_prf = -1;
   int32_t load_tbl_idx = -1, store_tbl_idx = -1;
+  /* store set prediction : older store this load or store waits on */
+  int32_t dep_store_tbl_idx = -1;
+  int64_t dep_store_alloc_id = -1;
   int32_t hi_prf_idx = -1, lo_prf_idx = -1;
   int32_t prev_hi_prf_idx = -1, prev_lo_prf_idx = -1;
   
   mips_op* op = nullptr;
   bool push_return_stack = false;
   int64_t return_stack_idx = -1;
+  /* first unready source seen by the last ready() call */
+  reg_file wait_rf = reg_file::none;
+  int32_t wait_prf = -1;
 
   void reinit(uint32_t pc,
 	      uint32_t inst,
@@ -169,6 +177,8 @@ public:
     src5_prf = -1;
     load_tbl_idx = -1;
     store_tbl_idx = -1;
+    dep_store_tbl_idx = -1;
+    dep_store_alloc_id = -1;
     hi_prf_idx = -1;
     lo_prf_idx = -1;
     prev_hi_prf_idx = -1;
@@ -177,8 +187,26 @@ public:
     op = nullptr;
     return_stack_idx = -1;
     push_return_stack = false;
+    wait_rf = reg_file::none;
+    wait_prf = -1;
   }
 
+  void reinit(uint64_t fetch_icnt,
+	      uint32_t pc,
+	      uint32_t inst,
+	      uint32_t fetch_npc,
+	      uint64_t fetch_cycle,
+	      bool predict_taken,
+	      bool pop_return_stack) {
+    reinit(pc, inst, fetch_cycle);
+    this->fetch_icnt = fetch_icnt;
+    this->fetch_npc = fetch_npc;
+    this->predict_taken = predict_taken;
+    this->pop_return_stack = pop_return_stack;
+  }
+
+  mips_meta_op() {}
+
   mips_meta_op(uint64_t fetch_icnt,
 	       uint32_t pc,
 	       uint32_t inst,
@@ -217,12 +245,25 @@ protected:
   bool getConditionCode(uint32_t cr, uint32_t cc) {
     return ((cr & (1U<<cc)) >> cc) & 0x1;
   }
+  /* valid bit for ready() ; a miss is recorded as the wakeup tag */
+  bool src_ready(sim_state &machine_state, reg_file rf, int32_t prf) const;
+  /* the older store the store sets tie this load or store to has
+   * not executed yet */
+  bool stall_for_store(sim_state &machine_state) const;
 public:
   sim_op m = nullptr;
   bool retired = false;
   oper_type op_class = oper_type::unknown;
   mips_op(sim_op m) : m(m), retired(false) {}
   virtual ~mips_op() {}
+  /* copy of a decoded, never executed op for another instance */
+  virtual mips_op *clone(sim_op /*op*/) const {
+    return nullptr;
+  }
+  /* decoded ops recycle storage binned by subclass size */
+  static void *operator new(size_t sz);
+  static void operator delete(void *p, size_t sz);
+  static void set_pool_limit(size_t limit);
   virtual bool allocate(sim_state &machine_state);
   virtual void execute(sim_state &machine_state);
   virtual void complete(sim_state &machine_state);
@@ -258,11 +299,49 @@ public:
   }
 };
 
+#define MIPS_OP_CLONE(T)			\
+  mips_op *clone(sim_op op) const override {	\
+    T *c = new T(*this);			\
+    c->m = op;					\
+    return c;					\
+  }
+
+/* decoded prototypes by pc, tagged with the instruction word so a
+ * store that rewrites code just misses ; not shared across threads */
+class decode_cache {
+private:
+  struct entry {
+    uint32_t pc = 0, inst = 0;
+    mips_op *proto = nullptr;
+    /* meta op flags set by the op constructors */
+    bool could_cause_exception = false;
+    bool is_branch_or_jump = false;
+    bool is_jal = false, is_jr = false;
+    bool has_delay_slot = false;
+    bool is_store = false, is_fp_store = false;
+  };
+  std::vector<entry> entries;
+  uint32_t mask = 0;
+public:
+  uint64_t hits = 0, misses = 0;
+  decode_cache(int lg_entries);
+  ~decode_cache();
+  mips_op *decode(sim_op m_op);
+};
+
 class mips_store : public mips_op {
 protected:
   itype i_;
   int32_t imm = -1;
   uint32_t effective_address = ~0;
+  /* bytes written in memory order from st_addr, held from execute
+   * until retire so younger loads can forward */
+  uint32_t st_addr = 0, st_len = 0;
+  uint8_t st_bytes[8] = {0};
+  /* low len bytes of v, big endian */
+  void set_store_bytes(sim_state &machine_state, uint32_t addr, uint32_t len, uint64_t v);
+  void write_store_bytes(sim_state &machine_state);
+  void release_store_bytes(sim_state &machine_state);
 public:
   mips_store(sim_op op) : mips_op(op), i_(op->inst) {
     this->op_class = oper_type::store;
@@ -270,6 +349,15 @@ public:
     imm = static_cast<int32_t>(himm);
     op->is_store = true;
   }
+  bool overlaps(uint32_t addr, uint32_t len) const {
+    return (st_len != 0) and (addr < (st_addr + st_len)) and (st_addr < (addr + len));
+  }
+  bool covers(uint32_t addr, uint32_t len) const {
+    return (st_len != 0) and (st_addr <= addr) and ((addr + len) <= (st_addr + st_len));
+  }
+  uint8_t byte_at(uint32_t addr) const {
+    return st_bytes[addr - st_addr];
+  }
 };
 
 class mips_load : public mips_op {
@@ -280,8 +368,27 @@ protected:
   load_type lt;
   int32_t imm = -1;
   uint32_t effective_address = ~0;
-  bool stall_for_load(sim_state &machine_state) const;
+  /* bytes read in memory order from ld_addr, from memory or the
+   * youngest older store that covers them */
+  uint32_t ld_addr = 0, ld_len = 0;
+  uint8_t ld_bytes[8] = {0};
+  bool in_cam = false;
+  const mips_meta_op *older_store(sim_state &machine_state, bool &covers) const;
+  void lsq_execute(sim_state &machine_state, uint32_t addr, uint32_t len,
+		   uint32_t cache_addr, uint32_t cache_len);
+  bool lsq_read(sim_state &machine_state);
+  void lsq_release(sim_state &machine_state);
+  template <typename T>
+  T ld_get(uint32_t addr) const {
+    T v;
+    assert((addr >= ld_addr) and ((addr + sizeof(T)) <= (ld_addr + ld_len)));
+    memcpy(&v, ld_bytes + (addr - ld_addr), sizeof(T));
+    return v;
+  }
 public:
+  /* alloc id of the store that supplied every byte, -1 when any
+   * byte came from memory */
+  int64_t fwd_alloc_id = -1;
   mips_load(sim_op op) : mips_op(op), i_(op->inst), lt(load_type::bogus) {
     this->op_class = oper_type::load;
     int16_t himm = static_cast<int16_t>(m->inst & ((1<<16) - 1));
@@ -291,6 +398,9 @@ public:
   uint32_t getEA() const {
     return effective_address;
   }
+  bool overlaps(uint32_t addr, uint32_t len) const {
+    return in_cam and (addr < (ld_addr + ld_len)) and (ld_addr < (addr + len));
+  }
 };
 
 template <typename T>
@@ -3,6 +3,8 @@
 #include <set>
 #include <fstream>
 #include <map>
+#include <cmath>
+#include <algorithm>
 
 #include <sys/stat.h>
 #include <sys/time.h>
@@ -28,10 +30,9 @@
 #include "sim_parameters.hh"
 #include "sim_cache.hh"
 #include "machine_state.hh"
-
-extern std::map<uint32_t, uint32_t> branch_target_map;
-extern std::map<uint32_t, int32_t> branch_prediction_map;
-static std::map<int64_t, int64_t> insn_lifetime_map;
+#include "oracle_frontend.hh"
+#include "simpoint.hh"
+#include "ooo_core.hh"
 
 
 static inline bool is_likely_branch(uint32_t inst) {
@@ -65,6 +66,24 @@ static inline bool is_nonlikely_branch(uint32_t inst) {
   return false;
 }
 
+/* everything but jr, which uses the return stack */
+static inline bool uses_btb(uint32_t inst) {
+  uint32_t opcode = inst>>26;
+  switch(opcode)
+    {
+    case 0x00:
+      return (inst & 63) == 0x09;
+    case 0x02:
+    case 0x03:
+      return true;
+    case 0x11:
+      return ((inst >> 21) & 31) == 0x8;
+    default:
+      break;
+    }
+  return is_likely_branch(inst) or is_nonlikely_branch(inst);
+}
+
 
 class rollback_rob_entry : public sim_queue<sim_op>::funcobj {
 protected:
@@ -75,225 +94,608 @@ public:
   virtual bool operator()(sim_op e){
     if(e) {
       e->op->rollback(machine_state);
-      delete e;
+      machine_state.free_op(e);
       return true;
     }
     return false;
   }
 };
 
+/* fetch reads at most one l1i line per cycle and a miss holds fetch
+ * until the line lands. false when pc cannot be fetched this cycle */
+static bool icache_fetch(sim_state &machine_state, uint32_t pc, uint32_t &cycle_line) {
+  simCache *l1i = machine_state.l1i;
+  if(l1i == nullptr) {
+    return true;
+  }
+  const uint32_t line = pc & ~(sim_param::l1i_linesize-1);
+  if(line == cycle_line) {
+    return true;
+  }
+  if(cycle_line != ~(0U)) {
+    return false;
+  }
+  if(line == machine_state.icache_line) {
+    if(global::curr_cycle < machine_state.icache_ready) {
+      return false;
+    }
+    machine_state.icache_line = ~(0U);
+  }
+  else {
+    uint32_t delay = machine_state.mmu ? machine_state.mmu->translate_fetch(line, pc) : 0;
+    if(uint32_t stall = l1i->fetch(line, pc, delay)) {
+      machine_state.icache_line = line;
+      machine_state.icache_ready = global::curr_cycle + stall;
+      return false;
+    }
+  }
+  cycle_line = line;
+  return true;
+}
+
+/* fetch cannot move until the l1i fill lands */
+static bool icache_stalled(sim_state &machine_state) {
+  if((machine_state.l1i == nullptr) or machine_state.fetch_blocked or
+     (global::curr_cycle >= machine_state.icache_ready)) {
+    return false;
+  }
+  uint32_t pc = machine_state.fetch_pc;
+  if(machine_state.frontend) {
+    pc = machine_state.frontend->peek_pc();
+  }
+  else if(machine_state.delay_slot_npc) {
+    pc = machine_state.delay_slot_npc;
+  }
+  return (pc & ~(sim_param::l1i_linesize-1)) == machine_state.icache_line;
+}
+
+/* watchdog : the last retirement, or the last l1i fill as a miss
+ * there drains the rob before the next data miss can start */
+static uint64_t last_progress_cycle(const sim_state &machine_state) {
+  return std::max(machine_state.last_retire_cycle,
+		  std::min(machine_state.icache_ready, global::curr_cycle));
+}
+
+/* a data miss may sit behind a page walk of two dependent misses */
+static uint64_t watchdog_cycles(const sim_state &machine_state) {
+  return sim_param::mem_latency * (machine_state.mmu ? 5 : 2);
+}
+
+/* dram latency grows with load, a fill still on its way is not a
+ * hang however long it takes */
+static bool memory_pending(const sim_state &machine_state) {
+  return machine_state.l1d and (machine_state.l1d->next_inflight_cycle() != -1);
+}
+
+/* oracle fetch fed by the frontend thread ; same bandwidth and
+ * taken-branch limits as fetch_stage<true> */
+static void decoupled_fetch_stage(sim_state &machine_state) {
+  auto &fetch_queue = machine_state.fetch_queue;
+  oracle_frontend *frontend = machine_state.frontend;
+  int fetch_amt = 0, taken_branches = 0;
+  uint32_t cycle_line = ~(0U);
+  while(not(fetch_queue.full()) and (fetch_amt < sim_param::fetch_bw) and not(machine_state.nuke) and not(machine_state.fetch_blocked)) {
+    if(not(icache_fetch(machine_state, frontend->peek_pc(), cycle_line))) {
+      break;
+    }
+    bool delay_slot = false;
+    mips_meta_op *f = frontend->next(global::curr_cycle, delay_slot);
+    if(is_monitor(f->inst)) {
+      machine_state.fetch_blocked = true;
+    }
+    fetch_queue.push(f);
+    fetch_amt++;
+    machine_state.fetched_insns++;
+    if(delay_slot) {
+      if(taken_branches == sim_param::taken_branches_per_cycle)
+	break;
+      continue;
+    }
+    if(f->predict_taken)
+      taken_branches++;
+  }
+}
+
 template <bool enable_oracle>
-void fetch(sim_state &machine_state) {
+static void fetch_stage(sim_state &machine_state) {
+  if(enable_oracle and machine_state.frontend) {
+    decoupled_fetch_stage(machine_state);
+    return;
+  }
   auto &fetch_queue = machine_state.fetch_queue;
   auto &return_stack = machine_state.return_stack;
   sparse_mem &mem = *(machine_state.mem);
   
-  while(not(machine_state.terminate_sim)) {
-    int fetch_amt = 0, taken_branches = 0;
-    for(; not(fetch_queue.full()) and (fetch_amt < sim_param::fetch_bw) and not(machine_state.nuke) and not(machine_state.fetch_blocked); ) {
+  int fetch_amt = 0, taken_branches = 0;
+  uint32_t cycle_line = ~(0U);
+  for(; not(fetch_queue.full()) and (fetch_amt < sim_param::fetch_bw) and not(machine_state.nuke) and not(machine_state.fetch_blocked); ) {
       
-      if(machine_state.delay_slot_npc) {
-	uint32_t inst = bswap(mem.get32(machine_state.delay_slot_npc));
+    if(machine_state.delay_slot_npc) {
+      if(not(icache_fetch(machine_state, machine_state.delay_slot_npc, cycle_line))) {
+	break;
+      }
+      uint32_t inst = bswap(mem.get32(machine_state.delay_slot_npc));
 
-	if(is_monitor(inst)) {
-	  machine_state.fetch_blocked = true;
-	}
+      if(is_monitor(inst)) {
+	machine_state.fetch_blocked = true;
+      }
 	
-	auto f = new mips_meta_op(machine_state.fetched_insns,
-				  machine_state.delay_slot_npc,
-				  inst,
-				  machine_state.delay_slot_npc+4,
-				  global::curr_cycle,
-				  false,
-				  false);
-	fetch_queue.push(f);
-	fetch_amt++;
-	machine_state.fetched_insns++;
-	machine_state.delay_slot_npc = 0;
+      auto f = machine_state.alloc_op(machine_state.fetched_insns,
+				      machine_state.delay_slot_npc,
+				      inst,
+				      machine_state.delay_slot_npc+4,
+				      global::curr_cycle,
+				      false,
+				      false);
+      fetch_queue.push(f);
+      fetch_amt++;
+      machine_state.fetched_insns++;
+      machine_state.delay_slot_npc = 0;
 
-	if(taken_branches == sim_param::taken_branches_per_cycle)
-	  break;
-	continue;
-      }
+      if(taken_branches == sim_param::taken_branches_per_cycle)
+	break;
+      continue;
+    }
       
-      uint32_t inst = bswap(mem.get32(machine_state.fetch_pc));
-      uint32_t npc = machine_state.fetch_pc + 4;
-      bool predict_taken = false;
-      bool oracle_taken = false, oracle_nullify = false;
-      uint32_t oracle_npc = 0;
-
-      if(enable_oracle) {
-	if(not(machine_state.oracle_state->brk)) {
+    /* btb miss : the target waits for decode */
+    if(global::curr_cycle < machine_state.fetch_resume_cycle) {
+      break;
+    }
+    if(not(icache_fetch(machine_state, machine_state.fetch_pc, cycle_line))) {
+      break;
+    }
+    uint32_t inst = bswap(mem.get32(machine_state.fetch_pc));
+    uint32_t npc = machine_state.fetch_pc + 4;
+    bool predict_taken = false;
+    bool oracle_taken = false, oracle_nullify = false;
+    uint32_t oracle_npc = 0;
+
+    if(enable_oracle) {
+      if(not(machine_state.oracle_state->brk)) {
 	  
-	  if(machine_state.fetched_insns == machine_state.oracle_state->icnt) {
-	    execMips(machine_state.oracle_state);
-	  }
+	if(machine_state.fetched_insns == machine_state.oracle_state->icnt) {
+	  execMips(machine_state.oracle_state);
+	}
 
-	  auto &hh = machine_state.oracle_state->hbuf[machine_state.fetched_insns%HWINDOW];
+	auto &hh = machine_state.oracle_state->hbuf[machine_state.fetched_insns%HWINDOW];
 #if 0
-	  std::cout << std::hex
-		    << "oracle pc = " << hh.fetch_pc
-	    	    << " oracle npc = " << hh.next_pc
-		    << " fetch pc = " << machine_state.fetch_pc
-		    << " was_branch_or_jump = "
-		    << hh.was_branch_or_jump
-		    << ", was_likely_branch = "
-		    << hh.was_likely_branch
-		    << ", took_branch_or_jump = "
-		    << hh.took_branch_or_jump
+	std::cout << std::hex
+		  << "oracle pc = " << hh.fetch_pc
+		  << " oracle npc = " << hh.next_pc
+		  << " fetch pc = " << machine_state.fetch_pc
+		  << " was_branch_or_jump = "
+		  << hh.was_branch_or_jump
+		  << ", was_likely_branch = "
+		  << hh.was_likely_branch
+		  << ", took_branch_or_jump = "
+		  << hh.took_branch_or_jump
+		  << std::dec
+		  << " uarch sim fetched "
+		  << machine_state.fetched_insns
+		  << " oracle fetched "
+		  << hh.icnt
+		  << "\n";
+#endif	  
+	if(hh.icnt != machine_state.fetched_insns or
+	   hh.fetch_pc != machine_state.fetch_pc) {
+	  std::cerr << "hh.fetch_pc = "
+		    << std::hex
+		    << hh.fetch_pc
+		    << ",machine_state.fetch_pc = "
+		    << machine_state.fetch_pc
 		    << std::dec
-		    << " uarch sim fetched "
-		    << machine_state.fetched_insns
-		    << " oracle fetched "
+		    << " hh.icnt = "
 		    << hh.icnt
+		    << ",machine_state.fetched_insns = "
+		    << machine_state.fetched_insns
 		    << "\n";
-#endif	  
-	  if(hh.icnt != machine_state.fetched_insns or
-	     hh.fetch_pc != machine_state.fetch_pc) {
-	    std::cerr << "hh.fetch_pc = "
-		      << std::hex
-		      << hh.fetch_pc
-		      << ",machine_state.fetch_pc = "
-		      << machine_state.fetch_pc
-		      << std::dec
-		      << " hh.icnt = "
-		      << hh.icnt
-		      << ",machine_state.fetched_insns = "
-		      << machine_state.fetched_insns
-		      << "\n";
-	    die();
-	  }
+	  die();
+	}
 
-	  bool jump = is_jal(inst) or is_jr(inst) or is_j(inst);
-	  if(jump) {
-	    assert(hh.was_branch_or_jump and hh.took_branch_or_jump);
-	  }
+	bool jump = is_jal(inst) or is_jr(inst) or is_j(inst);
+	if(jump) {
+	  assert(hh.was_branch_or_jump and hh.took_branch_or_jump);
+	}
 	  
-	  if(hh.was_branch_or_jump and hh.took_branch_or_jump) {
-	    oracle_taken = true;
-	    oracle_npc = hh.next_pc;
-	  }
-	  else if(hh.was_likely_branch and not(hh.took_branch_or_jump)) {
-	    oracle_nullify = true;
-	  }
+	if(hh.was_branch_or_jump and hh.took_branch_or_jump) {
+	  oracle_taken = true;
+	  oracle_npc = hh.next_pc;
+	}
+	else if(hh.was_likely_branch and not(hh.took_branch_or_jump)) {
+	  oracle_nullify = true;
 	}
       }
+    }
 	
-      auto it = branch_prediction_map.find(machine_state.fetch_pc);
-      bool used_return_addr_stack = false;
+    bool used_return_addr_stack = false;
+    /* a taken prediction whose target came from decoding */
+    bool decode_redirect = false;
       
-      mips_meta_op *f = new mips_meta_op(machine_state.fetched_insns,
-					 machine_state.fetch_pc,
-					 inst,
-					 global::curr_cycle);
-      bool backwards_br = (get_branch_target(machine_state.fetch_pc, inst) < machine_state.fetch_pc);
-
-      if(is_monitor(inst)) {
-	machine_state.fetch_blocked = true;
-      }
+    mips_meta_op *f = machine_state.alloc_op(machine_state.fetched_insns,
+					     machine_state.fetch_pc,
+					     inst,
+					     0,
+					     global::curr_cycle,
+					     false,
+					     false);
+    bool backwards_br = (get_branch_target(machine_state.fetch_pc, inst) < machine_state.fetch_pc);
+
+    if(is_monitor(inst)) {
+      machine_state.fetch_blocked = true;
+    }
 
       
-      if(enable_oracle) {
-	if(oracle_taken) {
-	  machine_state.delay_slot_npc = machine_state.fetch_pc + 4;
-	  npc = oracle_npc;
-	  predict_taken = true;
-	  //std::cerr << "PREDICT TAKEN with npc of " << std::hex << npc << std::dec << "\n";
-	}
-	else if(oracle_nullify) {
-	  //std::cerr << "PREDICT NULLIFY\n";
-	  npc = machine_state.fetch_pc + 8;
-	}
+    if(enable_oracle) {
+      if(oracle_taken) {
+	machine_state.delay_slot_npc = machine_state.fetch_pc + 4;
+	npc = oracle_npc;
+	predict_taken = true;
+	//std::cerr << "PREDICT TAKEN with npc of " << std::hex << npc << std::dec << "\n";
+      }
+      else if(oracle_nullify) {
+	//std::cerr << "PREDICT NULLIFY\n";
+	npc = machine_state.fetch_pc + 8;
+      }
+    }
+    else {
+      f->prediction = machine_state.branch_pred->predict(f->pht_idx);
+      uint32_t btb_target = 0;
+      bool btb_hit = false;
+      if(uses_btb(inst)) {
+	btb_hit = machine_state.btb->lookup(machine_state.fetch_pc, btb_target);
       }
-      else {
-	f->prediction = machine_state.branch_pred->predict(f->pht_idx);
 	
-	if(is_jr(inst)) {
-	  f->return_stack_idx = return_stack.get_tos_idx();
-	  npc = return_stack.pop();
-	  machine_state.delay_slot_npc = machine_state.fetch_pc + 4;
-	  used_return_addr_stack = true;
-	}
-	else if(is_jal(inst)) {
-	  machine_state.delay_slot_npc = machine_state.fetch_pc + 4;
-	  npc = get_jump_target(machine_state.fetch_pc, inst);
-	  predict_taken = true;
-	  f->return_stack_idx = return_stack.get_tos_idx();
-	  return_stack.push(machine_state.fetch_pc + 8);
-	  fetch_amt++;
-	}
-	else if(is_j(inst)) {
-	  machine_state.delay_slot_npc = machine_state.fetch_pc + 4;
-	  npc = get_jump_target(machine_state.fetch_pc, inst);
-	  predict_taken = true;
-	}
-	else if(it != branch_prediction_map.end()) {
-	  predict_taken = (f->prediction > 1);
-
-	  /* check if backwards branch with valid loop predictor entry */	  
-	  if(backwards_br and (machine_state.loop_pred !=nullptr) ) {
-	    if(machine_state.loop_pred->valid_loop_branch(machine_state.fetch_pc)) {
-	      predict_taken = machine_state.loop_pred->predict(machine_state.fetch_pc, f->prediction);
-	    }
+      if(is_jr(inst)) {
+	f->return_stack_idx = return_stack.get_tos_idx();
+	npc = return_stack.pop();
+	machine_state.delay_slot_npc = machine_state.fetch_pc + 4;
+	used_return_addr_stack = true;
+      }
+      else if(is_jal(inst)) {
+	machine_state.delay_slot_npc = machine_state.fetch_pc + 4;
+	npc = btb_hit ? btb_target : get_jump_target(machine_state.fetch_pc, inst);
+	decode_redirect = not(btb_hit);
+	predict_taken = true;
+	f->return_stack_idx = return_stack.get_tos_idx();
+	return_stack.push(machine_state.fetch_pc + 8);
+	fetch_amt++;
+      }
+      else if(is_j(inst)) {
+	machine_state.delay_slot_npc = machine_state.fetch_pc + 4;
+	npc = btb_hit ? btb_target : get_jump_target(machine_state.fetch_pc, inst);
+	decode_redirect = not(btb_hit);
+	predict_taken = true;
+      }
+      else if(btb_hit) {
+	predict_taken = (f->prediction > 1);
+
+	/* check if backwards branch with valid loop predictor entry */	  
+	if(backwards_br and (machine_state.loop_pred !=nullptr) ) {
+	  if(machine_state.loop_pred->valid_loop_branch(machine_state.fetch_pc)) {
+	    predict_taken = machine_state.loop_pred->predict(machine_state.fetch_pc, f->prediction);
 	  }
+	}
 
 	  
-	  if(predict_taken) {
-	    machine_state.delay_slot_npc = machine_state.fetch_pc + 4;
-	    npc = branch_target_map.at(machine_state.fetch_pc);
-	  }
+	if(predict_taken) {
+	  machine_state.delay_slot_npc = machine_state.fetch_pc + 4;
+	  npc = btb_target;
 	}
-	else if(is_likely_branch(inst)) {
+      }
+      else if(is_likely_branch(inst)) {
+	machine_state.delay_slot_npc = machine_state.fetch_pc + 4;
+	npc = get_branch_target(machine_state.fetch_pc, inst);
+	predict_taken = true;
+	decode_redirect = true;
+      }
+      else if(is_nonlikely_branch(inst)) {
+	uint32_t target = get_branch_target(machine_state.fetch_pc, inst);
+	if(target < machine_state.fetch_pc) {
 	  machine_state.delay_slot_npc = machine_state.fetch_pc + 4;
 	  npc = get_branch_target(machine_state.fetch_pc, inst);
 	  predict_taken = true;
-	}
-	else if(is_nonlikely_branch(inst)) {
-	  uint32_t target = get_branch_target(machine_state.fetch_pc, inst);
-	  if(target < machine_state.fetch_pc) {
-	    machine_state.delay_slot_npc = machine_state.fetch_pc + 4;
-	    npc = get_branch_target(machine_state.fetch_pc, inst);
-	    predict_taken = true;
-	  }
+	  decode_redirect = true;
 	}
       }
-      f->fetch_npc = npc;
-      f->predict_taken = predict_taken;
-      f->pop_return_stack = used_return_addr_stack;
+    }
+    f->fetch_npc = npc;
+    f->predict_taken = predict_taken;
+    f->pop_return_stack = used_return_addr_stack;
       
-      fetch_queue.push(f);
-      fetch_amt++;
-      machine_state.fetched_insns++;
-      machine_state.fetch_pc = npc;
-      if(predict_taken)
-	taken_branches++;
+    fetch_queue.push(f);
+    fetch_amt++;
+    machine_state.fetched_insns++;
+    machine_state.fetch_pc = npc;
+    if(predict_taken)
+      taken_branches++;
+    if(decode_redirect) {
+      machine_state.fetch_resume_cycle = global::curr_cycle + sim_param::btb_miss_penalty;
+    }
+  }
+}
+
+static void finish_nuke(sim_state &machine_state) {
+  machine_state.rob.clear();
+  
+  for(size_t i = 0; i < machine_state.fetch_queue.capacity(); i++) {
+    auto f = machine_state.fetch_queue.at(i);
+    if(f) {
+      machine_state.free_op(f);
     }
+  }
+  for(size_t i = 0; i < machine_state.decode_queue.capacity(); i++) {
+    auto d = machine_state.decode_queue.at(i);
+    if(d) {
+      machine_state.free_op(d);
+    }
+  }
 
-    gthread_yield();
+  //machine_state.return_stack.clear();
+  machine_state.decode_queue.clear();
+  machine_state.fetch_queue.clear();
+  machine_state.delay_slot_npc = 0;
+  machine_state.fetch_resume_cycle = 0;
+  machine_state.alloc_blocked = false;
+  machine_state.fetch_blocked = false;
+  for(int i = 0; i < machine_state.num_alu_rs; i++) {
+    machine_state.alu_rs.at(i).clear();
+  }
+  for(int i = 0; i < machine_state.num_fpu_rs; i++) {
+    machine_state.fpu_rs.at(i).clear();
+  }
+  for(int i = 0; i < machine_state.num_load_rs; i++) {
+    machine_state.load_rs.at(i).clear();
   }
-  gthread_terminate();
+  machine_state.jmp_rs.clear();
+  for(int i = 0; i < machine_state.num_store_rs;i++) {
+    machine_state.store_rs.at(i).clear();
+  }
+  machine_state.system_rs.clear();
+  machine_state.clear_waiters();
+  machine_state.complete_wheel.clear();
+  machine_state.load_tbl_freevec.clear();
+  machine_state.store_tbl_freevec.clear();
+  machine_state.load_cam.clear();
+  machine_state.store_cam.clear();
+  for(size_t i = 0; i < machine_state.load_tbl_freevec.size(); i++) {
+    machine_state.load_tbl[i] = nullptr;
+  }
+  for(size_t i = 0; i < machine_state.store_tbl_freevec.size(); i++) {
+    machine_state.store_tbl[i] = nullptr;
+  }
+  machine_state.nuke = false;
 }
 
 template<bool enable_oracle>
-void retire(sim_state &machine_state) {
+static void retire_exception(sim_state &machine_state) {
   state_t *s = machine_state.ref_state;
   auto &rob = machine_state.rob;
-  int stuck_cnt = 0, empty_cnt = 0;
-  uint64_t num_retired_insns = 0;
-  while(not(machine_state.terminate_sim)) {
-    int retire_amt = 0;
-    sim_op u = nullptr;
-    bool stop_sim = false;
-    bool exception = false;
-      
-    if(rob.empty()) {
-      empty_cnt++;
-      if(empty_cnt > 64) {
-	std::cerr << "empty ROB for 64 cycles at " << get_curr_cycle() << "\n";
+  retire_context &ctx = machine_state.retire_ctx;
+  int &stuck_cnt = ctx.stuck_cnt;
+  uint64_t &num_retired_insns = ctx.num_retired_insns;
+  int &retire_amt = ctx.retire_amt;
+  sim_op u = ctx.u;
+  bool resume_delay_slot = (ctx.phase == retire_phase::exception_delay_slot_wait);
+  bool delay_slot_exception = false;
+  ctx.phase = retire_phase::run;
+  
+  if(u->exception==exception_type::branch) {
+    if(u->has_delay_slot) {
+      /* wait for branch delay instr to allocate */
+      if(not(resume_delay_slot)) {
+	machine_state.alloc_blocked = false;
+      }
+      sim_op uu = rob.peek_next_pop();
+      if((uu == nullptr) or not(uu->is_complete) or (uu->complete_cycle == get_curr_cycle())) {
+	ctx.phase = retire_phase::exception_delay_slot_wait;
+	return;
+      }
+      if(uu->exception==exception_type::branch or uu->load_exception) {
+	delay_slot_exception = true;
+      }
+      else {
+	//std::cerr << "retire for " << *(u->op) << "\n";
+	u->op->retire(machine_state);
+	num_retired_insns++;
+	int64_t lifetime_cycles = static_cast<int64_t>(u->retire_cycle)-static_cast<int64_t>(u->fetch_cycle);
+	//if(lifetime_cycles > 1000) {
+	//std::cerr << "@ cycle " << get_curr_cycle() << ":" << *(u->op) << " has a huge lifetime!\n";
+	// die();
+	//}
+	machine_state.insn_lifetime_map[lifetime_cycles]++;
+	machine_state.last_retire_cycle = get_curr_cycle();
+	machine_state.last_retire_pc = u->pc;
+	//std::cout << std::hex << u->pc << ":" << std::hex
+	//<< getAsmString(u->inst, u->pc) << "\n";
+
+	//std::cerr << "retire for " << *(uu->op) << "\n";
+	uu->op->retire(machine_state);
+	num_retired_insns++;
+	machine_state.last_retire_cycle = get_curr_cycle();
+	machine_state.last_retire_pc = uu->pc;
+	lifetime_cycles = static_cast<int64_t>(uu->retire_cycle)-static_cast<int64_t>(uu->fetch_cycle);
+	//if(lifetime_cycles > 1000) {
+	//std::cerr << "@ cycle " << get_curr_cycle() << ":" << *(uu->op) << " has a huge lifetime!\n";
+	//die();
+	//}
+	machine_state.insn_lifetime_map[lifetime_cycles]++;
+	//std::cout << std::hex << uu->pc << ":" << std::hex
+	//<< getAsmString(uu->inst, uu->pc) << "\n";
+	if(global::use_interp_check and (s->pc == u->pc)) {
+	  s->call_site = __LINE__;
+	  execMips(s);
+	}
+	rob.pop();
+	rob.pop();
+	retire_amt+=2;
+	machine_state.free_op(uu);
+      }
+    }
+    else {
+      //std::cerr << "retire for " << *(u->op) << "\n";
+      u->op->retire(machine_state);
+      num_retired_insns++;
+      int64_t lifetime_cycles = static_cast<int64_t>(u->retire_cycle)-static_cast<int64_t>(u->fetch_cycle);
+      //if(lifetime_cycles > 1000) {
+      //std::cerr << "@ cycle " << get_curr_cycle() << ":" << *(u->op) << " has a huge lifetime!\n";
+      //die();
+      //}
+      machine_state.insn_lifetime_map[lifetime_cycles]++;
+      machine_state.last_retire_cycle = get_curr_cycle();
+      machine_state.last_retire_pc = u->pc;
+      if(global::use_interp_check and (s->pc == u->pc)) {
+	s->call_site = __LINE__;
+	execMips(s);
+      }
+      rob.pop();
+      retire_amt++;
+    }
+  }
+  machine_state.nuke = true;
+  stuck_cnt = 0;
+  if(delay_slot_exception) {
+    assert(not(enable_oracle));
+    machine_state.fetch_pc = u->pc;
+  }
+  else {
+    if(u->exception == exception_type::branch) {
+      machine_state.fetch_pc = u->correct_pc;
+      if(enable_oracle) {
+	assert((u->fetch_icnt+1)==machine_state.fetched_insns);
+      }
+      machine_state.free_op(u);
+    }
+    else {
+      machine_state.fetch_pc = u->pc;
+      if(enable_oracle) {
+	machine_state.fetched_insns = u->fetch_icnt;
       }
     }
+  }
+
+  if(machine_state.l1d) {
+    machine_state.l1d->nuke_inflight();
+  }
+
+
+  /* quick way to reset rob with flash copied tables */
+  int64_t c = 0;
+  for(size_t i = 0, len = rob.capacity(); i < len; i++) {
+    if(rob.at(i)) {
+      machine_state.free_op(rob.at(i));
+      rob.at(i) = nullptr;
+      c++;
+    }
+  }
+      
+  memcpy(&machine_state.gpr_rat, &machine_state.gpr_rat_retire,
+	 sizeof(int32_t)*sim_state::num_gpr_regs);
+  memcpy(&machine_state.cpr0_rat, &machine_state.cpr0_rat_retire,
+	 sizeof(int32_t)*sim_state::num_cpr0_regs);
+  memcpy(&machine_state.cpr1_rat, &machine_state.cpr1_rat_retire,
+	 sizeof(int32_t)*sim_state::num_cpr1_regs);
+  memcpy(&machine_state.fcr1_rat, &machine_state.fcr1_rat_retire,
+	 sizeof(int32_t)*sim_state::num_fcr1_regs);
+      
+  machine_state.gpr_freevec.copy(machine_state.gpr_freevec_retire);
+  machine_state.cpr0_freevec.copy(machine_state.cpr0_freevec_retire);
+  machine_state.cpr1_freevec.copy(machine_state.cpr1_freevec_retire);
+  machine_state.fcr1_freevec.copy(machine_state.fcr1_freevec_retire);
+  machine_state.spec_bhr.copy(machine_state.bhr);
       
-    while(not(rob.empty()) and (retire_amt < sim_param::retire_bw) and (machine_state.icnt < machine_state.maxicnt)) {
+  //std::cerr << "gpr freevec used = "
+  //<< machine_state.gpr_freevec.popcount()
+  //<< "\n";
+  //std::cerr << "cpr1 freevec used = "
+  //<< machine_state.cpr1_freevec.popcount()
+  //<< "\n";
+
+  assert(machine_state.gpr_freevec.popcount()==sim_state::num_gpr_regs);
+  assert(machine_state.cpr1_freevec.popcount()==sim_state::num_cpr1_regs);
+      
+  machine_state.gpr_valid.clear();
+  machine_state.cpr0_valid.clear();
+  machine_state.cpr1_valid.clear();
+  machine_state.fcr1_valid.clear();
+
+  for(int i = 0; i < sim_state::num_gpr_regs; i++) {
+    machine_state.gpr_valid.set_bit(machine_state.gpr_rat[i]);
+  }
+  for(int i = 0; i < sim_state::num_cpr0_regs; i++) {
+    machine_state.cpr0_valid.set_bit(machine_state.cpr0_rat[i]);
+  }
+  for(int i = 0; i < sim_state::num_cpr1_regs; i++) {
+    machine_state.cpr1_valid.set_bit(machine_state.cpr1_rat[i]);
+  }
+  for(int i = 0; i < sim_state::num_fcr1_regs; i++) {
+    machine_state.fcr1_valid.set_bit(machine_state.fcr1_rat[i]);
+  }
+  
+  if(sim_param::flash_restart==0) {
+    ctx.sleep_cycles = (c + sim_param::retire_bw - 1) / sim_param::retire_bw;
+    if(ctx.sleep_cycles > 0) {
+      ctx.phase = retire_phase::flash_restart;
+      return;
+    }
+  }
+  finish_nuke(machine_state);
+}
+
+template<bool enable_oracle>
+static void retire_stage(sim_state &machine_state) {
+  state_t *s = machine_state.ref_state;
+  auto &rob = machine_state.rob;
+  retire_context &ctx = machine_state.retire_ctx;
+  int &stuck_cnt = ctx.stuck_cnt, &empty_cnt = ctx.empty_cnt;
+  uint64_t &num_retired_insns = ctx.num_retired_insns;
+  int &retire_amt = ctx.retire_amt;
+  sim_op &u = ctx.u;
+  bool &stop_sim = ctx.stop_sim;
+  bool &exception = ctx.exception;
+  bool resume_delay_slot = false;
+
+  switch(ctx.phase)
+    {
+    case retire_phase::run:
+      if(ctx.started and (((machine_state.icnt >= machine_state.maxicnt) and
+			   not(ctx.delay_slot_owed)) or stop_sim)) {
+	machine_state.terminate_sim = true;
+	return;
+      }
+      ctx.started = true;
+      retire_amt = 0;
+      u = nullptr;
+      stop_sim = false;
+      exception = false;
+      
+      if(rob.empty()) {
+	/* an l1i miss drains the rob */
+	empty_cnt = icache_stalled(machine_state) ? 0 : (empty_cnt + 1);
+	if(empty_cnt > 64) {
+	  std::cerr << "empty ROB for 64 cycles at " << get_curr_cycle() << "\n";
+	}
+      }
+      break;
+    case retire_phase::delay_slot_wait:
+      resume_delay_slot = true;
+      break;
+    case retire_phase::exception:
+    case retire_phase::exception_delay_slot_wait:
+      retire_amt = 0;
+      retire_exception<enable_oracle>(machine_state);
+      return;
+    case retire_phase::flash_restart:
+      if(--ctx.sleep_cycles == 0) {
+	ctx.phase = retire_phase::run;
+	finish_nuke(machine_state);
+      }
+      return;
+    }
+  ctx.phase = retire_phase::run;
+  
+  while(resume_delay_slot or (not(rob.empty()) and (retire_amt < sim_param::retire_bw) and
+			      ((machine_state.icnt < machine_state.maxicnt) or ctx.delay_slot_owed))) {
+    if(not(resume_delay_slot)) {
       u = rob.peek();
       empty_cnt = 0;
       if(not(u->is_complete)) {
@@ -324,357 +726,134 @@ void retire(sim_state &machine_state) {
 	exception = true;
 	break;
       }
+    }
 
-      if(u->has_delay_slot) {
-	while(rob.peek_next_pop() == nullptr) {
-	  stuck_cnt++;
-	  gthread_yield();
-	}
-	sim_op uu = rob.peek_next_pop();
-	while(not(uu->is_complete)) {
-	  stuck_cnt++;
-	  gthread_yield();
-	}
-	if(u->exception==exception_type::branch or uu->load_exception) {
-	  machine_state.nukes++;
-	  if(uu->exception == exception_type::branch) {
-	    machine_state.branch_nukes++;
-	  }
-	  else {
-	    machine_state.load_nukes++;
-	  }
-	  exception = true;
-	  break;
-	}
+    if(resume_delay_slot or u->has_delay_slot) {
+      /* wait for the delay slot instruction to allocate and complete */
+      resume_delay_slot = false;
+      sim_op uu = rob.peek_next_pop();
+      if((uu == nullptr) or not(uu->is_complete)) {
+	stuck_cnt++;
+	ctx.phase = retire_phase::delay_slot_wait;
+	return;
       }
-
-      if(global::use_interp_check and (s->pc == u->pc)) {
-	assert(not(exception));
-	bool error = false;
-	for(int i = 0; i < 32; i++) {
-	  if(s->gpr[i] != machine_state.arch_grf[i]) {
-	    std::cerr << "uarch reg " << getGPRName(i) << " : " 
-		      << std::hex << machine_state.arch_grf[i] << std::dec << "\n"; 
-	    std::cerr << "func reg " << getGPRName(i) << " : " 
-		      << std::hex << s->gpr[i] << std::dec << "\n"; 
-	    error = true;
-	  }
-	}
-	
-	for(int i = 0; i < 32; i++) {
-	  if(s->cpr1[i] != machine_state.arch_cpr1[i]) {
-	    std::cerr << "uarch cpr1 " << i << " : " 
-		      << std::hex << machine_state.arch_cpr1[i] << std::dec << "\n"; 
-	    std::cerr << "func cpr1 " << i << " : " 
-		      << std::hex << s->cpr1[i] << std::dec << "\n";
-	    error = true;
-	  }
-	}
-
-	for(int i = 0; i < 5; i++) {
-	  if(s->fcr1[i] != machine_state.arch_fcr1[i]) {
-	    std::cerr << "uarch fcr1 " << i << " : " 
-		      << std::hex << machine_state.arch_fcr1[i]
-		      << std::dec << "\n"; 
-	    std::cerr << "func fcr1 " << i << " : " 
-		      << std::hex << s->fcr1[i]
-		      << std::dec << "\n";
-
-	    error = true;
-	  }
-	}
-	  
-	  	  
-	if(u->is_store and false) {
-	  error |= (machine_state.mem->equal(s->mem)==false);
-	}
-	if(error) {
-	  std::cerr << "bad insn : " << std::hex << u->pc << ":" << std::dec
-		    << getAsmString(u->inst, u->pc)
-		    << " after " << machine_state.icnt << " uarch isns and "
-		    << s->icnt << " arch isns\n";
-	  std::cerr << "known good at pc " << std::hex << machine_state.last_compare_pc
-		    << std::dec << " after " << machine_state.last_compare_icnt
-		    << " isnsns\n";
-	  std::cerr << "execMips call site = " << s->call_site << "\n";
-	  machine_state.terminate_sim = true;
-	  break;
+      if(u->exception==exception_type::branch or uu->load_exception) {
+	machine_state.nukes++;
+	if(uu->exception == exception_type::branch) {
+	  machine_state.branch_nukes++;
 	}
 	else {
-	  machine_state.last_compare_pc = u->pc;
-	  machine_state.last_compare_icnt = machine_state.icnt;
+	  machine_state.load_nukes++;
 	}
-	s->call_site = __LINE__;
-	execMips(s);
-      }
-
-      u->op->retire(machine_state);
-
-
-      num_retired_insns++;
-#if 0
-      if(true) {	
-	std::cerr << num_retired_insns
-		  << " : "
-		  << *(u->op)
-		  << "\n";
-      }
-#endif
-      stuck_cnt = 0;
-      int64_t insn_lifetime = static_cast<int64_t>(u->retire_cycle) - static_cast<int64_t>(u->fetch_cycle);
-      insn_lifetime_map[insn_lifetime]++;
-      machine_state.last_retire_cycle = get_curr_cycle();
-      machine_state.last_retire_pc = u->pc;
-	
-      stop_sim = u->op->stop_sim();
-      delete u;
-      u = nullptr;
-      retire_amt++;
-      rob.pop();
-      if(stop_sim) {
+	exception = true;
 	break;
       }
-
     }
 
-
-    if(u!=nullptr and exception) {
-      assert(u->could_cause_exception);
-	
-      if((retire_amt - sim_param::retire_bw) < 2) {
-	gthread_yield();
-	retire_amt = 0;
-      }
-	
-      bool is_load_exception = u->load_exception;
-      uint32_t exc_pc = u->pc;
-      bool delay_slot_exception = false;
-      
-      if(u->exception==exception_type::branch) {
-	if(u->has_delay_slot) {
-	  /* wait for branch delay instr to allocate */
-	  machine_state.alloc_blocked = false;
-	  while(rob.peek_next_pop() == nullptr) {
-	    gthread_yield();
-	    retire_amt = 0;
-	  }
-	  sim_op uu = rob.peek_next_pop();
-	  while(not(uu->is_complete) or (uu->complete_cycle == get_curr_cycle())) {
-	    gthread_yield();
-	    retire_amt = 0;
-	  }
-	  if(uu->exception==exception_type::branch or uu->load_exception) {
-	    delay_slot_exception = true;
-	  }
-	  else {
-	    //std::cerr << "retire for " << *(u->op) << "\n";
-	    u->op->retire(machine_state);
-	    num_retired_insns++;
-	    int64_t lifetime_cycles = static_cast<int64_t>(u->retire_cycle)-static_cast<int64_t>(u->fetch_cycle);
-	    //if(lifetime_cycles > 1000) {
-	    //std::cerr << "@ cycle " << get_curr_cycle() << ":" << *(u->op) << " has a huge lifetime!\n";
-	    // die();
-	    //}
-	    insn_lifetime_map[lifetime_cycles]++;
-	    machine_state.last_retire_cycle = get_curr_cycle();
-	    machine_state.last_retire_pc = u->pc;
-	    //std::cout << std::hex << u->pc << ":" << std::hex
-	    //<< getAsmString(u->inst, u->pc) << "\n";
-
-	    //std::cerr << "retire for " << *(uu->op) << "\n";
-	    uu->op->retire(machine_state);
-	    num_retired_insns++;
-	    machine_state.last_retire_cycle = get_curr_cycle();
-	    machine_state.last_retire_pc = uu->pc;
-	    lifetime_cycles = static_cast<int64_t>(uu->retire_cycle)-static_cast<int64_t>(uu->fetch_cycle);
-	    //if(lifetime_cycles > 1000) {
-	    //std::cerr << "@ cycle " << get_curr_cycle() << ":" << *(uu->op) << " has a huge lifetime!\n";
-	    //die();
-	    //}
-	    insn_lifetime_map[lifetime_cycles]++;
-	    //std::cout << std::hex << uu->pc << ":" << std::hex
-	    //<< getAsmString(uu->inst, uu->pc) << "\n";
-	    if(global::use_interp_check and (s->pc == u->pc)) {
-	      s->call_site = __LINE__;
-	      execMips(s);
-	    }
-	    rob.pop();
-	    rob.pop();
-	    retire_amt+=2;
-	    delete uu;
-	  }
-	}
-	else {
-	  //std::cerr << "retire for " << *(u->op) << "\n";
-	  u->op->retire(machine_state);
-	  num_retired_insns++;
-	  int64_t lifetime_cycles = static_cast<int64_t>(u->retire_cycle)-static_cast<int64_t>(u->fetch_cycle);
-	  //if(lifetime_cycles > 1000) {
-	  //std::cerr << "@ cycle " << get_curr_cycle() << ":" << *(u->op) << " has a huge lifetime!\n";
-	  //die();
-	  //}
-	  insn_lifetime_map[lifetime_cycles]++;
-	  machine_state.last_retire_cycle = get_curr_cycle();
-	  machine_state.last_retire_pc = u->pc;
-	  if(global::use_interp_check and (s->pc == u->pc)) {
-	    s->call_site = __LINE__;
-	    execMips(s);
-	  }
-	  rob.pop();
-	  retire_amt++;
+    if(global::use_interp_check and (s->pc == u->pc)) {
+      assert(not(exception));
+      bool error = false;
+      for(int i = 0; i < 32; i++) {
+	if(s->gpr[i] != machine_state.arch_grf[i]) {
+	  std::cerr << "uarch reg " << getGPRName(i) << " : " 
+		    << std::hex << machine_state.arch_grf[i] << std::dec << "\n"; 
+	  std::cerr << "func reg " << getGPRName(i) << " : " 
+		    << std::hex << s->gpr[i] << std::dec << "\n"; 
+	  error = true;
 	}
       }
-      machine_state.nuke = true;
-      stuck_cnt = 0;
-      if(delay_slot_exception) {
-	assert(not(enable_oracle));
-	machine_state.fetch_pc = u->pc;
-      }
-      else {
-	if(u->exception == exception_type::branch) {
-	  machine_state.fetch_pc = u->correct_pc;
-	  if(enable_oracle) {
-	    assert((u->fetch_icnt+1)==machine_state.fetched_insns);
-	  }
-	  delete u;
-	}
-	else {
-	  machine_state.fetch_pc = u->pc;
-	  if(enable_oracle) {
-	    machine_state.fetched_insns = u->fetch_icnt;
-	  }
+	
+      for(int i = 0; i < 32; i++) {
+	if(s->cpr1[i] != machine_state.arch_cpr1[i]) {
+	  std::cerr << "uarch cpr1 " << i << " : " 
+		    << std::hex << machine_state.arch_cpr1[i] << std::dec << "\n"; 
+	  std::cerr << "func cpr1 " << i << " : " 
+		    << std::hex << s->cpr1[i] << std::dec << "\n";
+	  error = true;
 	}
       }
 
-      if(machine_state.l1d) {
-	machine_state.l1d->nuke_inflight();
-      }
+      for(int i = 0; i < 5; i++) {
+	if(s->fcr1[i] != machine_state.arch_fcr1[i]) {
+	  std::cerr << "uarch fcr1 " << i << " : " 
+		    << std::hex << machine_state.arch_fcr1[i]
+		    << std::dec << "\n"; 
+	  std::cerr << "func fcr1 " << i << " : " 
+		    << std::hex << s->fcr1[i]
+		    << std::dec << "\n";
 
-
-      /* quick way to reset rob with flash copied tables */
-      int64_t c = 0;
-      for(size_t i = 0, len = rob.capacity(); i < len; i++) {
-	if(rob.at(i)) {
-	  delete rob.at(i);
-	  rob.at(i) = nullptr;
-	  c++;
+	  error = true;
 	}
       }
-      
-      memcpy(&machine_state.gpr_rat, &machine_state.gpr_rat_retire,
-	     sizeof(int32_t)*sim_state::num_gpr_regs);
-      memcpy(&machine_state.cpr0_rat, &machine_state.cpr0_rat_retire,
-	     sizeof(int32_t)*sim_state::num_cpr0_regs);
-      memcpy(&machine_state.cpr1_rat, &machine_state.cpr1_rat_retire,
-	     sizeof(int32_t)*sim_state::num_cpr1_regs);
-      memcpy(&machine_state.fcr1_rat, &machine_state.fcr1_rat_retire,
-	     sizeof(int32_t)*sim_state::num_fcr1_regs);
-      
-      machine_state.gpr_freevec.copy(machine_state.gpr_freevec_retire);
-      machine_state.cpr0_freevec.copy(machine_state.cpr0_freevec_retire);
-      machine_state.cpr1_freevec.copy(machine_state.cpr1_freevec_retire);
-      machine_state.fcr1_freevec.copy(machine_state.fcr1_freevec_retire);
-      machine_state.spec_bhr.copy(machine_state.bhr);
-      
-      //std::cerr << "gpr freevec used = "
-      //<< machine_state.gpr_freevec.popcount()
-      //<< "\n";
-      //std::cerr << "cpr1 freevec used = "
-      //<< machine_state.cpr1_freevec.popcount()
-      //<< "\n";
-
-      assert(machine_state.gpr_freevec.popcount()==sim_state::num_gpr_regs);
-      assert(machine_state.cpr1_freevec.popcount()==sim_state::num_cpr1_regs);
-      
-      machine_state.gpr_valid.clear();
-      machine_state.cpr0_valid.clear();
-      machine_state.cpr1_valid.clear();
-      machine_state.fcr1_valid.clear();
-
-      for(int i = 0; i < sim_state::num_gpr_regs; i++) {
-	machine_state.gpr_valid.set_bit(machine_state.gpr_rat[i]);
-      }
-      for(int i = 0; i < sim_state::num_cpr0_regs; i++) {
-	machine_state.cpr0_valid.set_bit(machine_state.cpr0_rat[i]);
-      }
-      for(int i = 0; i < sim_state::num_cpr1_regs; i++) {
-	machine_state.cpr1_valid.set_bit(machine_state.cpr1_rat[i]);
-      }
-      for(int i = 0; i < sim_state::num_fcr1_regs; i++) {
-	machine_state.fcr1_valid.set_bit(machine_state.fcr1_rat[i]);
-      }
-      
-      if(sim_param::flash_restart==0) {
-	int64_t sleep_cycles = (c + sim_param::retire_bw - 1) / sim_param::retire_bw;
-	for(int64_t i = 0; i < sleep_cycles; i++) {
-	  gthread_yield();
-	}
+	  
+	  	  
+      if(u->is_store and false) {
+	error |= (machine_state.mem->equal(s->mem)==false);
       }
-      rob.clear();
-	
-      for(size_t i = 0; i < machine_state.fetch_queue.capacity(); i++) {
-	auto f = machine_state.fetch_queue.at(i);
-	if(f) {
-	  delete f;
-	}
+      if(error) {
+	std::cerr << "bad insn : " << std::hex << u->pc << ":" << std::dec
+		  << getAsmString(u->inst, u->pc)
+		  << " after " << machine_state.icnt << " uarch isns and "
+		  << s->icnt << " arch isns\n";
+	std::cerr << "known good at pc " << std::hex << machine_state.last_compare_pc
+		  << std::dec << " after " << machine_state.last_compare_icnt
+		  << " isnsns\n";
+	std::cerr << "execMips call site = " << s->call_site << "\n";
+	machine_state.terminate_sim = true;
+	break;
       }
-      for(size_t i = 0; i < machine_state.decode_queue.capacity(); i++) {
-	auto d = machine_state.decode_queue.at(i);
-	if(d) {
-	  delete d;
-	}
+      else {
+	machine_state.last_compare_pc = u->pc;
+	machine_state.last_compare_icnt = machine_state.icnt;
       }
+      s->call_site = __LINE__;
+      execMips(s);
+    }
 
-      //machine_state.return_stack.clear();
-      machine_state.decode_queue.clear();
-      machine_state.fetch_queue.clear();
-      machine_state.delay_slot_npc = 0;
-      machine_state.alloc_blocked = false;
-      machine_state.fetch_blocked = false;
-      for(int i = 0; i < machine_state.num_alu_rs; i++) {
-	machine_state.alu_rs.at(i).clear();
-      }
-      for(int i = 0; i < machine_state.num_fpu_rs; i++) {
-	machine_state.fpu_rs.at(i).clear();
-      }
-      for(int i = 0; i < machine_state.num_load_rs; i++) {
-	machine_state.load_rs.at(i).clear();
-      }
-      machine_state.jmp_rs.clear();
-      for(int i = 0; i < machine_state.num_store_rs;i++) {
-	machine_state.store_rs.at(i).clear();
-      }
-      machine_state.system_rs.clear();
-      machine_state.load_tbl_freevec.clear();
-      machine_state.store_tbl_freevec.clear();
-      for(size_t i = 0; i < machine_state.load_tbl_freevec.size(); i++) {
-	machine_state.load_tbl[i] = nullptr;
-      }
-      for(size_t i = 0; i < machine_state.store_tbl_freevec.size(); i++) {
-	machine_state.store_tbl[i] = nullptr;
-      }
-      machine_state.nuke = false;
+    u->op->retire(machine_state);
 
-      // if(enable_oracle) {
-      // 	machine_state.oracle_state->copy(machine_state.ref_state);
-      // 	machine_state.oracle_mem->copy(machine_state.ref_state->mem);
-      // }
-	
-      gthread_yield();
-      //std::cout << "rolling back complete @ cycle " << get_curr_cycle() << "\n";
+
+    num_retired_insns++;
+#if 0
+    if(true) {	
+      std::cerr << num_retired_insns
+		<< " : "
+		<< *(u->op)
+		<< "\n";
     }
-    else {
-      gthread_yield();
+#endif
+    stuck_cnt = 0;
+    int64_t insn_lifetime = static_cast<int64_t>(u->retire_cycle) - static_cast<int64_t>(u->fetch_cycle);
+    machine_state.insn_lifetime_map[insn_lifetime]++;
+    machine_state.last_retire_cycle = get_curr_cycle();
+    machine_state.last_retire_pc = u->pc;
+	
+    stop_sim = u->op->stop_sim();
+    ctx.delay_slot_owed = u->has_delay_slot;
+    machine_state.free_op(u);
+    u = nullptr;
+    retire_amt++;
+    rob.pop();
+    if(stop_sim) {
+      break;
     }
-    if(machine_state.icnt >= machine_state.maxicnt or stop_sim) {
-      machine_state.terminate_sim = true;
+
+  }
+
+  if(u!=nullptr and exception) {
+    assert(u->could_cause_exception);
+    if((retire_amt - sim_param::retire_bw) < 2) {
+      /* pick up the rollback next cycle */
+      ctx.phase = retire_phase::exception;
+      return;
     }
+    retire_exception<enable_oracle>(machine_state);
   }
-  gthread_terminate();
 }
 
 void initialize_ooo_core(sim_state &machine_state,
 			 simCache *l1d,
+			 simCache *l1i,
 			 bool use_oracle,
 			 bool use_syscall_skip,
 			 uint64_t skipicnt, 
@@ -683,16 +862,17 @@ void initialize_ooo_core(sim_state &machine_state,
 			 const sparse_mem *sm) {
 
   machine_state.l1d = l1d;
+  machine_state.l1i = l1i;
   
   if(use_syscall_skip) {
     while(s->syscall==0 and not(s->brk)) {
-      execMips(s);
+      runMips(s, ~(0UL));
     }
     s->pc+=4;
   }
   else if(skipicnt != 0) {
     while((s->icnt < skipicnt) and not(s->brk)) {
-      execMips(s);
+      runMips(s, skipicnt);
     }
   }
   
@@ -703,6 +883,7 @@ void initialize_ooo_core(sim_state &machine_state,
     machine_state.oracle_mem = new sparse_mem(*sm);
     machine_state.oracle_state = new state_t(*machine_state.oracle_mem);
     machine_state.oracle_state->silent = true;
+    machine_state.oracle_state->track_history = true;
     machine_state.oracle_state->copy(s);
   }
   machine_state.mem = new sparse_mem(*sm);
@@ -719,423 +900,579 @@ void destroy_ooo_core(sim_state &machine_state) {
   for(size_t i = 0; i < machine_state.fetch_queue.capacity(); i++) {
     auto f = machine_state.fetch_queue.at(i);
     if(f) {
-      delete f;
+      machine_state.free_op(f);
     }
   }
   for(size_t i = 0; i < machine_state.decode_queue.capacity(); i++) {
     auto d = machine_state.decode_queue.at(i);
     if(d) {
-      delete d;
+      machine_state.free_op(d);
     }
   }
   for(size_t i = 0; i < machine_state.rob.capacity(); i++) {
     auto r = machine_state.rob.at(i);
     if(r) {
-      delete r;
+      machine_state.free_op(r);
     }
   }
-  if(machine_state.oracle_mem) {
-    delete machine_state.oracle_mem;
+  /* stop the frontend thread before freeing the oracle */
+  if(machine_state.frontend) {
+    delete machine_state.frontend;
+  }
+  if(machine_state.oracle_mem) {
+    delete machine_state.oracle_mem;
+  }
+  if(machine_state.oracle_state) {
+    delete machine_state.oracle_state;
+  }
+  /* sampling runs the pipeline on the interpreter's image */
+  if(machine_state.mem != &(machine_state.ref_state->mem)) {
+    delete machine_state.mem;
+  }
+  delete machine_state.branch_pred;
+  delete machine_state.btb;
+  delete machine_state.store_sets;
+  delete machine_state.mmu;
+  if(machine_state.loop_pred != nullptr) {
+    delete machine_state.loop_pred;
+  }
+  machine_state.op_pool.clear();
+  
+  gthread::free_threads();
+}
+
+
+
+/* per-cycle watchdog and heartbeat, run after curr_cycle advances */
+static void check_cycle(sim_state &machine_state) {
+  uint64_t &prev_icnt = machine_state.hb_icnt;
+  uint64_t &prev_br_and_jmps = machine_state.hb_br_and_jmps;
+  uint64_t &prev_mispredicts = machine_state.hb_mispredicts;
+    
+  simCache *l1d = machine_state.l1d;
+  uint64_t &last_hits = machine_state.hb_l1d_hits, &last_misses = machine_state.hb_l1d_misses;
+  uint64_t delta = global::curr_cycle - last_progress_cycle(machine_state);
+  if((sim_param::mem_latency >= 100) and (delta > watchdog_cycles(machine_state)) and
+     not(memory_pending(machine_state))) {
+    std::cerr << "no retirement in "
+	      << watchdog_cycles(machine_state)
+	      << " cycles, last pc = "
+	      << std::hex
+	      << machine_state.last_retire_pc
+	      << std::dec
+	      << "\n";
+    machine_state.terminate_sim = true;
+  }
+  if((global::curr_cycle & (sim_param::heartbeat-1)) == 0) {
+    uint64_t curr_icnt = (machine_state.icnt-machine_state.skipicnt);
+    double ipc = static_cast<double>(curr_icnt) / global::curr_cycle;
+    double wipc = static_cast<double>(curr_icnt-prev_icnt) / sim_param::heartbeat;
+
+    uint64_t br_and_jmps = machine_state.n_branches + machine_state.n_jumps;
+    uint64_t mispredicts = machine_state.mispredicted_branches + machine_state.mispredicted_jumps;
+
+    uint64_t w_br_and_jmps = br_and_jmps - prev_br_and_jmps;
+    uint64_t w_mispredicts = mispredicts - prev_mispredicts;
+	
+    double pr = 1000.0 * (static_cast<double>(mispredicts) / curr_icnt);
+    double w_pr = 1000.0 * (static_cast<double>(w_mispredicts) / (curr_icnt-prev_icnt));
+
+	
+    *global::sim_log << "c " << global::curr_cycle 
+			  << ", i " << curr_icnt
+			  << ", a ipc "<< ipc
+			  << ", w ipc " << wipc
+			  << ", a mpki " << pr
+			  << ", w mpki " << w_pr;
+	
+    if(l1d) {
+      uint64_t hits = l1d->getHits()-last_hits;
+      uint64_t misses = l1d->getMisses()-last_misses;
+      double w_hit_rate = static_cast<double>(hits) / (hits+misses);
+      double hit_rate = static_cast<double>(l1d->getHits()) / (l1d->getHits()+l1d->getMisses());
+      *global::sim_log << ", a dcu " << hit_rate
+			    << ", w dcu " << w_hit_rate ;
+      last_hits = l1d->getHits();
+      last_misses = l1d->getMisses();
+    }
+    *global::sim_log <<"\n";
+    global::sim_log->flush();
+    prev_icnt = curr_icnt;
+    prev_br_and_jmps = br_and_jmps;
+    prev_mispredicts = mispredicts;
+  }
+}
+
+static bool rs_has_ready(const sim_state::rs_type &rs, sim_state &machine_state) {
+  /* parked entries are not ready, woken ones may be */
+  if(rs.has_woken()) {
+    return true;
+  }
+  for(auto it = rs.begin(); it != rs.end(); it++) {
+    if((*it)->op->ready(machine_state)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* if no stage can make progress before some later cycle, return that
+ * cycle ; otherwise return the current one. every stage must be a no-op
+ * in the cycles skipped over, so this errs on the side of returning now */
+static uint64_t next_event_cycle(sim_state &machine_state) {
+  const uint64_t now = get_curr_cycle();
+  const retire_context &ctx = machine_state.retire_ctx;
+  auto &rob = machine_state.rob;
+
+  if(machine_state.nuke or (ctx.phase != retire_phase::run) or ctx.stop_sim or
+     (machine_state.icnt >= machine_state.maxicnt)) {
+    return now;
+  }
+  /* retire waits on the rob head */
+  if(rob.empty() or rob.peek()->is_complete) {
+    return now;
+  }
+  /* fetch, decode and allocate are all stalled */
+  const bool icache_stall = icache_stalled(machine_state);
+  if(not(machine_state.fetch_queue.full() or machine_state.fetch_blocked or icache_stall)) {
+    return now;
+  }
+  if(not(machine_state.fetch_queue.empty() or machine_state.decode_queue.full())) {
+    return now;
+  }
+  if(not(machine_state.decode_queue.empty() or rob.full() or machine_state.alloc_blocked)) {
+    return now;
+  }
+  /* nothing can dispatch */
+  for(int i = 0; i < machine_state.num_alu_rs; i++) {
+    if(rs_has_ready(machine_state.alu_rs.at(i), machine_state))
+      return now;
+  }
+  for(int i = 0; i < machine_state.num_fpu_rs; i++) {
+    if(rs_has_ready(machine_state.fpu_rs.at(i), machine_state))
+      return now;
+  }
+  for(int i = 0; i < machine_state.num_load_rs; i++) {
+    if(rs_has_ready(machine_state.load_rs.at(i), machine_state))
+      return now;
+  }
+  for(int i = 0; i < machine_state.num_store_rs; i++) {
+    if(rs_has_ready(machine_state.store_rs.at(i), machine_state))
+      return now;
+  }
+  if(rs_has_ready(machine_state.jmp_rs, machine_state) or
+     rs_has_ready(machine_state.system_rs, machine_state)) {
+    return now;
+  }
+  
+  /* earliest completion or cache response */
+  uint64_t next = ~(0UL);
+  int64_t cc = machine_state.complete_wheel.next_event(now);
+  if(cc == static_cast<int64_t>(now)) {
+    return now;
+  }
+  if(cc != -1) {
+    next = static_cast<uint64_t>(cc);
   }
-  if(machine_state.oracle_state) {
-    delete machine_state.oracle_state;
+  if(machine_state.l1d) {
+    int64_t c = machine_state.l1d->next_inflight_cycle();
+    if(c != -1) {
+      next = std::min(next, static_cast<uint64_t>(c));
+    }
   }
-  delete machine_state.mem;
-  delete machine_state.branch_pred;
-  if(machine_state.loop_pred != nullptr) {
-    delete machine_state.loop_pred;
+  if(icache_stall) {
+    next = std::min(next, machine_state.icache_ready);
   }
   
-  gthread::free_threads();
+  /* land on heartbeat and watchdog cycles so they still fire */
+  next = std::min(next, (now | (sim_param::heartbeat-1)) + 1);
+  if(sim_param::mem_latency >= 100) {
+    next = std::min(next, last_progress_cycle(machine_state) + watchdog_cycles(machine_state) + 1);
+  }
+  return next;
 }
 
+static void cycle_count_stage(sim_state &machine_state) {
+  global::curr_cycle++;
+  check_cycle(machine_state);
+  if(not(sim_param::skip_idle_cycles) or machine_state.terminate_sim) {
+    return;
+  }
+  uint64_t next = next_event_cycle(machine_state);
+  if(next <= global::curr_cycle) {
+    return;
+  }
+  /* account for what each skipped cycle would have done */
+  uint64_t n = next - global::curr_cycle;
+  for(uint64_t c = global::curr_cycle; c < next and c < (global::curr_cycle+sim_state::max_op_lat); c++) {
+    machine_state.wr_ports[c % sim_state::max_op_lat] = 0;
+  }
+  machine_state.alu_alloc.clear();
+  machine_state.fpu_alloc.clear();
+  machine_state.load_alloc.clear();
+  machine_state.store_alloc.clear();
+  machine_state.retire_ctx.stuck_cnt += n;
+  machine_state.retire_ctx.empty_cnt = 0;
+  machine_state.skipped_cycles += n;
+  global::curr_cycle = next;
+  check_cycle(machine_state);
+}
 
+static void decode_stage(sim_state &machine_state) {
+  auto &fetch_queue = machine_state.fetch_queue;
+  auto &decode_queue = machine_state.decode_queue;
+  auto &return_stack = machine_state.return_stack;
+  int decode_amt = 0;
+  while(not(fetch_queue.empty()) and not(decode_queue.full()) and (decode_amt < sim_param::decode_bw) and not(machine_state.nuke)) {
+    auto u = fetch_queue.peek();
+    if(not((u->fetch_cycle+1) < global::curr_cycle)) {
+      break;
+    }
+    fetch_queue.pop();
+    u->decode_cycle = global::curr_cycle;
+    /* the frontend thread may have predecoded this op */
+    if(u->op == nullptr) {
+      u->op = machine_state.dcache->decode(u);
+    }
+    decode_queue.push(u);
+    decode_amt++;
+  }
+}
 
-extern "C" {
-  void cycle_count(void *arg) {
-    sim_state &machine_state = *reinterpret_cast<sim_state*>(arg);
-    uint64_t prev_icnt = 0;
-    uint64_t prev_br_and_jmps = 0;
-    uint64_t prev_mispredicts = 0;
-    
-    simCache *l1d = machine_state.l1d;
-    uint64_t last_hits = 0, last_misses = 0;
-    while(not(machine_state.terminate_sim)) {
-      global::curr_cycle++;
-      uint64_t delta = global::curr_cycle - machine_state.last_retire_cycle;
-      if((sim_param::mem_latency >= 100) and (delta > (sim_param::mem_latency*2))) {
-	std::cerr << "no retirement in "
-		  << sim_param::mem_latency*2
-		  << " cycles, last pc = "
-		  << std::hex
-		  << machine_state.last_retire_pc
-		  << std::dec
-		  << "\n";
-	machine_state.terminate_sim = true;
-      }
-      if((global::curr_cycle & (sim_param::heartbeat-1)) == 0) {
-	uint64_t curr_icnt = (machine_state.icnt-machine_state.skipicnt);
-	double ipc = static_cast<double>(curr_icnt) / global::curr_cycle;
-	double wipc = static_cast<double>(curr_icnt-prev_icnt) / sim_param::heartbeat;
+static void allocate_stage(sim_state &machine_state) {
+  auto &decode_queue = machine_state.decode_queue;
+  auto &rob = machine_state.rob;
+  auto &alu_alloc = machine_state.alu_alloc;
+  auto &fpu_alloc = machine_state.fpu_alloc;
+  auto &load_alloc = machine_state.load_alloc;
+  auto &store_alloc = machine_state.store_alloc;
+  int64_t &alloc_counter = machine_state.alloc_counter;
+  int alloc_amt = 0;
+  std::map<oper_type, int> alloc_histo;
+  alu_alloc.clear();
+  fpu_alloc.clear();
+  load_alloc.clear();
+  store_alloc.clear();
 
-	uint64_t br_and_jmps = machine_state.n_branches + machine_state.n_jumps;
-	uint64_t mispredicts = machine_state.mispredicted_branches + machine_state.mispredicted_jumps;
+      
+  while(not(decode_queue.empty())
+	and not(rob.full())
+	and (alloc_amt < sim_param::alloc_bw)
+	and not(machine_state.nuke)
+	and not(machine_state.alloc_blocked)) {
+    auto u = decode_queue.peek();
+
+    bool jmp_avail = true, store_avail = true, system_avail = true;
+    sim_state::rs_type *rs_queue = nullptr;
+    bool rs_available = false;
+
+    if(u->op == nullptr) {
+      std::cout << "u->op == nullptr @ " << get_curr_cycle() << ",pc = "
+		<< std::hex << u->pc << std::dec << "\n";
+      die();
 
-	uint64_t w_br_and_jmps = br_and_jmps - prev_br_and_jmps;
-	uint64_t w_mispredicts = mispredicts - prev_mispredicts;
-	
-	double pr = 1000.0 * (static_cast<double>(mispredicts) / curr_icnt);
-	double w_pr = 1000.0 * (static_cast<double>(w_mispredicts) / (curr_icnt-prev_icnt));
+      break;
+    }
+    else if(u->decode_cycle == global::curr_cycle) {
+      break;
+    }
 
-	
-	*global::sim_log << "c " << global::curr_cycle 
-			      << ", i " << curr_icnt
-			      << ", a ipc "<< ipc
-			      << ", w ipc " << wipc
-			      << ", a mpki " << pr
-			      << ", w mpki " << w_pr;
-	
-	if(l1d) {
-	  uint64_t hits = l1d->getHits()-last_hits;
-	  uint64_t misses = l1d->getMisses()-last_misses;
-	  double w_hit_rate = static_cast<double>(hits) / (hits+misses);
-	  double hit_rate = static_cast<double>(l1d->getHits()) / (l1d->getHits()+l1d->getMisses());
-	  *global::sim_log << ", a dcu " << hit_rate
-				<< ", w dcu " << w_hit_rate ;
-	  last_hits = l1d->getHits();
-	  last_misses = l1d->getMisses();
+    switch(u->op->get_op_class())
+      {
+      case oper_type::unknown:
+	die();
+      case oper_type::alu: {
+	int64_t p = alu_alloc.find_first_unset_rr();
+	int64_t rs_id = mod(static_cast<int>(p),sim_param::num_alu_ports);
+	if(p!=-1 and not(machine_state.alu_rs.at(rs_id).full())) {
+	  rs_available = true;
+	  rs_queue = &(machine_state.alu_rs.at(rs_id));
+	  alu_alloc.set_bit(p);
+	  alloc_histo[u->op->get_op_class()]++;
 	}
-	*global::sim_log <<"\n";
-	global::sim_log->flush();
-	prev_icnt = curr_icnt;
-	prev_br_and_jmps = br_and_jmps;
-	prev_mispredicts = mispredicts;
       }
-      gthread_yield();
-    }
-    gthread_terminate();
-  }
-  void cache(void *arg) {
-    sim_state &machine_state = *reinterpret_cast<sim_state*>(arg);
-    if(machine_state.l1d != nullptr)  {
-      while(not(machine_state.terminate_sim)) {
-	machine_state.l1d->tick();
-	gthread_yield();
+	break;
+      case oper_type::fp: {
+	int64_t p = fpu_alloc.find_first_unset_rr();
+	int64_t rs_id = mod(static_cast<int>(p),sim_param::num_fpu_ports);
+	if(p!=-1 and not(machine_state.fpu_rs.at(rs_id).full())) {
+	  rs_available = true;
+	  rs_queue = &(machine_state.fpu_rs.at(rs_id));
+	  fpu_alloc.set_bit(p);
+	  alloc_histo[u->op->get_op_class()]++;
+	}
       }
-    }
-    gthread_terminate();
-  }
-  void fetch(void *arg) {
-    sim_state &machine_state = *reinterpret_cast<sim_state*>(arg);
-    if(machine_state.oracle_mem) {
-      fetch<true>(machine_state);
-    }
-    else {
-      fetch<false>(machine_state);
-    }
-  }
-  void decode(void *arg) {
-    sim_state &machine_state = *reinterpret_cast<sim_state*>(arg);
-    auto &fetch_queue = machine_state.fetch_queue;
-    auto &decode_queue = machine_state.decode_queue;
-    auto &return_stack = machine_state.return_stack;
-    while(not(machine_state.terminate_sim)) {
-      int decode_amt = 0;
-      while(not(fetch_queue.empty()) and not(decode_queue.full()) and (decode_amt < sim_param::decode_bw) and not(machine_state.nuke)) {
-	auto u = fetch_queue.peek();
-	if(not((u->fetch_cycle+1) < global::curr_cycle)) {
-	  break;
+	break;
+      case oper_type::jmp:
+	if(jmp_avail and not(machine_state.jmp_rs.full())) {
+	  rs_available = true;
+	  rs_queue = &(machine_state.jmp_rs);
+	  alloc_histo[u->op->get_op_class()]++;
+	  jmp_avail = false;
+	}
+	break;
+      case oper_type::load: {
+	int64_t p = load_alloc.find_first_unset_rr();
+	int64_t rs_id = mod(static_cast<int>(p),sim_param::num_load_ports);
+	if(p!=-1 and not(machine_state.load_rs.at(rs_id).full())) {
+	    rs_available = true;
+	    rs_queue = &(machine_state.load_rs.at(rs_id));
+	    load_alloc.set_bit(p);
+	    alloc_histo[u->op->get_op_class()]++;
 	}
-	fetch_queue.pop();
-	u->decode_cycle = global::curr_cycle;
-	u->op = decode_insn(u);
-	decode_queue.push(u);
-	decode_amt++;
+	break;
       }
-      gthread_yield();
-    }
-    gthread_terminate();
-  }
-
-  void allocate(void *arg) {
-    sim_state &machine_state = *reinterpret_cast<sim_state*>(arg);
-    auto &decode_queue = machine_state.decode_queue;
-    auto &rob = machine_state.rob;
-    auto &alu_alloc = machine_state.alu_alloc;
-    auto &fpu_alloc = machine_state.fpu_alloc;
-    auto &load_alloc = machine_state.load_alloc;
-    auto &store_alloc = machine_state.store_alloc;
-    int64_t alloc_counter = 0;
-    while(not(machine_state.terminate_sim)) {
-      int alloc_amt = 0;
-      std::map<oper_type, int> alloc_histo;
-      alu_alloc.clear();
-      fpu_alloc.clear();
-      load_alloc.clear();
-      store_alloc.clear();
-
-      
-      while(not(decode_queue.empty())
-	    and not(rob.full())
-	    and (alloc_amt < sim_param::alloc_bw)
-	    and not(machine_state.nuke)
-	    and not(machine_state.alloc_blocked)) {
-	auto u = decode_queue.peek();
-
-	bool jmp_avail = true, store_avail = true, system_avail = true;
-	sim_state::rs_type *rs_queue = nullptr;
-	bool rs_available = false;
-
-	if(u->op == nullptr) {
-	  std::cout << "u->op == nullptr @ " << get_curr_cycle() << ",pc = "
-		    << std::hex << u->pc << std::dec << "\n";
-	  die();
-
-	  break;
+      case oper_type::store: {
+	int64_t p = store_alloc.find_first_unset_rr();
+	int64_t rs_id = mod(static_cast<int>(p),sim_param::num_store_ports);
+	if(p!=-1 and not(machine_state.store_rs.at(rs_id).full())) {
+	  rs_available = true;
+	  rs_queue = &(machine_state.store_rs.at(rs_id));
+	  store_alloc.set_bit(p);
+	  alloc_histo[u->op->get_op_class()]++;
+	  store_avail = false;
 	}
-	else if(u->decode_cycle == global::curr_cycle) {
-	  break;
+	break;
+      }
+      case oper_type::system:
+	if(system_avail and not(machine_state.system_rs.full())) {
+	  rs_available = true;
+	  rs_queue = &(machine_state.system_rs);
+	  alloc_histo[u->op->get_op_class()]++;
+	  system_avail = false;
 	}
-
-	switch(u->op->get_op_class())
-	  {
-	  case oper_type::unknown:
-	    die();
-	  case oper_type::alu: {
-	    int64_t p = alu_alloc.find_first_unset_rr();
-	    int64_t rs_id = mod(static_cast<int>(p),sim_param::num_alu_ports);
-	    if(p!=-1 and not(machine_state.alu_rs.at(rs_id).full())) {
-	      rs_available = true;
-	      rs_queue = &(machine_state.alu_rs.at(rs_id));
-	      alu_alloc.set_bit(p);
-	      alloc_histo[u->op->get_op_class()]++;
-	    }
-	  }
-	    break;
-	  case oper_type::fp: {
-	    int64_t p = fpu_alloc.find_first_unset_rr();
-	    int64_t rs_id = mod(static_cast<int>(p),sim_param::num_fpu_ports);
-	    if(p!=-1 and not(machine_state.fpu_rs.at(rs_id).full())) {
-	      rs_available = true;
-	      rs_queue = &(machine_state.fpu_rs.at(rs_id));
-	      fpu_alloc.set_bit(p);
-	      alloc_histo[u->op->get_op_class()]++;
-	    }
-	  }
-	    break;
-	  case oper_type::jmp:
-	    if(jmp_avail and not(machine_state.jmp_rs.full())) {
-	      rs_available = true;
-	      rs_queue = &(machine_state.jmp_rs);
-	      alloc_histo[u->op->get_op_class()]++;
-	      jmp_avail = false;
-	    }
-	    break;
-	  case oper_type::load: {
-	    int64_t p = load_alloc.find_first_unset_rr();
-	    int64_t rs_id = mod(static_cast<int>(p),sim_param::num_load_ports);
-	    if(p!=-1 and not(machine_state.load_rs.at(rs_id).full())) {
-		rs_available = true;
-		rs_queue = &(machine_state.load_rs.at(rs_id));
-		load_alloc.set_bit(p);
-		alloc_histo[u->op->get_op_class()]++;
-	    }
-	    break;
-	  }
-	  case oper_type::store: {
-	    int64_t p = store_alloc.find_first_unset_rr();
-	    int64_t rs_id = mod(static_cast<int>(p),sim_param::num_store_ports);
-	    if(p!=-1 and not(machine_state.store_rs.at(rs_id).full())) {
-	      rs_available = true;
-	      rs_queue = &(machine_state.store_rs.at(rs_id));
-	      store_alloc.set_bit(p);
-	      alloc_histo[u->op->get_op_class()]++;
-	      store_avail = false;
-	    }
-	    break;
-	  }
-	  case oper_type::system:
-	    if(system_avail and not(machine_state.system_rs.full())) {
-	      rs_available = true;
-	      rs_queue = &(machine_state.system_rs);
-	      alloc_histo[u->op->get_op_class()]++;
-	      system_avail = false;
-	    }
-	    break;
-	  }
+	break;
+      }
 	
-	if(not(rs_available)) {
+    if(not(rs_available)) {
 #if 0
-	  std::cout << "can't allocate due to lack of "
-	  	    << u->op->get_op_class()
-		    << " resources @ cycle "
-		    << get_curr_cycle()
-		    << "\n";
+      std::cout << "can't allocate due to lack of "
+		<< u->op->get_op_class()
+		<< " resources @ cycle "
+		<< get_curr_cycle()
+		<< "\n";
 #endif
-	  break;
-	}
+      break;
+    }
 	
-	/* just yield... */
-	assert(u->op != nullptr);
+    /* just yield... */
+    assert(u->op != nullptr);
 
-	if(not(u->op->allocate(machine_state))) {
+    if(not(u->op->allocate(machine_state))) {
 #if 0
-	  std::cout << "allocation failed @ cycle "
-		    << get_curr_cycle()
-		    << " for 0x"
-		    << std::hex
-		    << u->pc
-		    << std::dec
-		    << "\n";
+      std::cout << "allocation failed @ cycle "
+		<< get_curr_cycle()
+		<< " for 0x"
+		<< std::hex
+		<< u->pc
+		<< std::dec
+		<< "\n";
 #endif
-	  break;
-	}
-	u->alloc_id = alloc_counter++;
-
-	rs_queue->push(u);
-	decode_queue.pop();
-	u->alloc_cycle = global::curr_cycle;
-	u->rob_idx = rob.push(u);
-	alloc_amt++;
-      }
-      machine_state.total_allocated_insns += alloc_amt;
-      gthread_yield();
+      break;
+    }
+    u->alloc_id = alloc_counter++;
+    if(u->op->get_op_class() == oper_type::store) {
+      machine_state.store_sets->store_allocated(u->pc, u->store_tbl_idx, u->alloc_id,
+						u->dep_store_tbl_idx, u->dep_store_alloc_id);
+    }
+    else if(u->op->get_op_class() == oper_type::load) {
+      machine_state.store_sets->load_allocated(u->pc, u->dep_store_tbl_idx,
+					       u->dep_store_alloc_id);
     }
-    gthread_terminate();
+
+    rs_queue->push(u);
+    decode_queue.pop();
+    u->alloc_cycle = global::curr_cycle;
+    u->rob_idx = rob.push(u);
+    alloc_amt++;
   }
+  machine_state.total_allocated_insns += alloc_amt;
+}
 
-  void execute(void *arg) {
-    sim_state &machine_state = *reinterpret_cast<sim_state*>(arg);
-    auto & alu_rs = machine_state.alu_rs;
-    auto & fpu_rs = machine_state.fpu_rs;
-    auto & jmp_rs = machine_state.jmp_rs;
-    auto & load_rs = machine_state.load_rs;
-    auto & store_rs = machine_state.store_rs;
-    auto & system_rs = machine_state.system_rs;
+static void execute_stage(sim_state &machine_state) {
+  auto & alu_rs = machine_state.alu_rs;
+  auto & fpu_rs = machine_state.fpu_rs;
+  auto & jmp_rs = machine_state.jmp_rs;
+  auto & load_rs = machine_state.load_rs;
+  auto & store_rs = machine_state.store_rs;
+  auto & system_rs = machine_state.system_rs;
     
-    while(not(machine_state.terminate_sim)) {
-      int exec_cnt = 0;
-      if(not(machine_state.nuke)) {
-	machine_state.wr_ports[get_curr_cycle()% sim_state::max_op_lat] = 0;
-	//alu loop (OoO scheduler)
+  int exec_cnt = 0;
+  if(not(machine_state.nuke)) {
+    machine_state.wr_ports[get_curr_cycle()% sim_state::max_op_lat] = 0;
+    //alu loop (OoO scheduler)
 #define OOO_SCHED(RS,NUM,PORTS) {					\
-	  int ns = 0, rd_ports = 0;					\
-	  const uint64_t cs = get_curr_cycle();				\
-	  for(auto it = RS.begin(); it != RS.end(); it++) {		\
-	    sim_op u = *it;						\
-	    bool r = u->op->ready(machine_state);			\
-	    if(r) machine_state.total_ready_insns++;			\
-	    if((u->ready_cycle==-1) and r) {				\
-	      u->ready_cycle = cs;					\
+      int ns = 0, rd_ports = 0;					\
+      const uint64_t cs = get_curr_cycle();				\
+      RS.merge_woken();						\
+      for(auto it = RS.begin(); it != RS.end(); /*nil*/) {		\
+	sim_op u = *it;						\
+	u->wait_rf = reg_file::none;					\
+	bool r = u->op->ready(machine_state);			\
+	if(r) machine_state.total_ready_insns++;			\
+	if((u->ready_cycle==-1) and r) {				\
+	  u->ready_cycle = cs;					\
+	}								\
+	if(not(r) and (u->wait_rf != reg_file::none)) {		\
+	  machine_state.park(u, &(RS));				\
+	  it = RS.park(it);						\
+	}								\
+	else {							\
+	  it++;							\
+	}								\
+      }								\
+      for(auto it = RS.begin(); it != RS.end() and (ns <= NUM) and (PORTS>=0); /*nil*/ ) { \
+	sim_op u = *it;						\
+	if(u->op->ready(machine_state) and	(cs >= (sim_param::ready_to_dispatch_latency+u->ready_cycle)) ) { \
+	  int num_ports = u->op->count_rd_ports();			\
+	  int wb_at_cycle = (get_curr_cycle() + u->op->get_latency()) % sim_state::max_op_lat; \
+	  if((PORTS-num_ports) >= 0 /*and machine_state.wr_ports[wb_at_cycle] < 4*/) { \
+	    it = RS.erase(it);					\
+	    u->op->execute(machine_state);				\
+	    u->dispatch_cycle = cs;					\
+	    if(u->complete_cycle >= static_cast<int64_t>(cs)) {	\
+	      machine_state.complete_wheel.schedule(cs, u->complete_cycle, u); \
 	    }								\
+	    exec_cnt++;						\
+	    ns++;							\
+	    PORTS-=num_ports;					\
+	    machine_state.wr_ports[wb_at_cycle]++;			\
 	  }								\
-	  for(auto it = RS.begin(); it != RS.end() and (ns <= NUM) and (PORTS>=0); /*nil*/ ) { \
-	    sim_op u = *it;						\
-	    if(u->op->ready(machine_state) and	(cs >= (sim_param::ready_to_dispatch_latency+u->ready_cycle)) ) { \
-	      int num_ports = u->op->count_rd_ports();			\
-	      int wb_at_cycle = (get_curr_cycle() + u->op->get_latency()) % sim_state::max_op_lat; \
-	      if((PORTS-num_ports) >= 0 /*and machine_state.wr_ports[wb_at_cycle] < 4*/) { \
-		it = RS.erase(it);					\
-		u->op->execute(machine_state);				\
-		u->dispatch_cycle = cs;					\
-		exec_cnt++;						\
-		ns++;							\
-		PORTS-=num_ports;					\
-		machine_state.wr_ports[wb_at_cycle]++;			\
-	      }								\
-	      else {							\
-		it++;							\
-	      }								\
-	    }								\
-	    else {							\
-	      it++;							\
-	    }								\
+	  else {							\
+	    it++;							\
 	  }								\
-	}
+	}								\
+	else {							\
+	  it++;							\
+	}								\
+      }								\
+    }
 	
 #define INORDER_SCHED(RS) {						\
-	  for(auto it = RS.begin(); it != RS.end(); it++) {		\
-	    sim_op u = *it;						\
-	    bool r = u->op->ready(machine_state);			\
-	    if(r) machine_state.total_ready_insns++;			\
-	    if((u->ready_cycle==-1) and r) {				\
-	      u->ready_cycle = get_curr_cycle();			\
-	    }								\
-	  }								\
-	  if(not(RS.empty())) {						\
-	    if(RS.peek()->op->ready(machine_state) and			\
-	       (get_curr_cycle() >= (sim_param::ready_to_dispatch_latency+RS.peek()->ready_cycle)) ) { \
-	      sim_op u = RS.pop();					\
-	      u->op->execute(machine_state);				\
-	      u->dispatch_cycle = get_curr_cycle();			\
-	      exec_cnt++;						\
-	    }								\
+      for(auto it = RS.begin(); it != RS.end(); it++) {		\
+	sim_op u = *it;						\
+	bool r = u->op->ready(machine_state);			\
+	if(r) machine_state.total_ready_insns++;			\
+	if((u->ready_cycle==-1) and r) {				\
+	  u->ready_cycle = get_curr_cycle();			\
+	}								\
+      }								\
+      if(not(RS.empty())) {						\
+	if(RS.peek()->op->ready(machine_state) and			\
+	   (get_curr_cycle() >= (sim_param::ready_to_dispatch_latency+RS.peek()->ready_cycle)) ) { \
+	  sim_op u = RS.pop();					\
+	  u->op->execute(machine_state);				\
+	  u->dispatch_cycle = get_curr_cycle();			\
+	  if(u->complete_cycle >= static_cast<int64_t>(get_curr_cycle())) { \
+	    machine_state.complete_wheel.schedule(get_curr_cycle(), u->complete_cycle, u); \
 	  }								\
-	}
+	  exec_cnt++;						\
+	}								\
+      }								\
+    }
 
-	int avail_int_ports = 1024, avail_fp_ports = 1024;
-	for(int i = 0; i < machine_state.num_alu_rs; i++) {
-	  OOO_SCHED(alu_rs.at(i),sim_param::num_alu_sched_per_cycle,avail_int_ports);
-	}
-	for(int i = 0; i < machine_state.num_load_rs; i++) {
-	  OOO_SCHED(load_rs.at(i),sim_param::num_load_sched_per_cycle,avail_int_ports);
-	}
-	/* not really out-of-order as stores are processed
-	 * at retirement */
-	for(int i = 0; i < machine_state.num_store_rs; i++) {
-	  OOO_SCHED(store_rs.at(i),sim_param::num_store_sched_per_cycle,avail_int_ports);
-	}
+    int avail_int_ports = 1024, avail_fp_ports = 1024;
+    for(int i = 0; i < machine_state.num_alu_rs; i++) {
+      OOO_SCHED(alu_rs.at(i),sim_param::num_alu_sched_per_cycle,avail_int_ports);
+    }
+    for(int i = 0; i < machine_state.num_load_rs; i++) {
+      OOO_SCHED(load_rs.at(i),sim_param::num_load_sched_per_cycle,avail_int_ports);
+    }
+    /* stores hold their data in the lsq until retirement */
+    for(int i = 0; i < machine_state.num_store_rs; i++) {
+      OOO_SCHED(store_rs.at(i),sim_param::num_store_sched_per_cycle,avail_int_ports);
+    }
 	
-	for(int i = 0; i < machine_state.num_fpu_rs; i++) {
-	  OOO_SCHED(fpu_rs.at(i),sim_param::num_fpu_sched_per_cycle,avail_fp_ports);
-	}
+    for(int i = 0; i < machine_state.num_fpu_rs; i++) {
+      OOO_SCHED(fpu_rs.at(i),sim_param::num_fpu_sched_per_cycle,avail_fp_ports);
+    }
 
-	OOO_SCHED(jmp_rs,1,avail_int_ports);
-	INORDER_SCHED(system_rs);
+    OOO_SCHED(jmp_rs,1,avail_int_ports);
+    INORDER_SCHED(system_rs);
 #undef OOO_SCHED
 #undef INORDER_SCHED
-      }
-      else {
-	std::fill(machine_state.wr_ports.begin(),
-		  machine_state.wr_ports.end(),
-		  0);
-      }
-      machine_state.total_dispatched_insns += exec_cnt;
-      gthread_yield();
-    }
-    gthread_terminate();
-  }
-  void complete(void *arg) {
-    sim_state &machine_state = *reinterpret_cast<sim_state*>(arg);
-    auto &rob = machine_state.rob;
-    while(not(machine_state.terminate_sim)) {
-      for(size_t i = 0; not(machine_state.nuke) and (i < rob.capacity()); i++) {
-	if((rob.at(i) != nullptr) and not(rob.at(i)->is_complete)) {
-	  if(rob.at(i)->op == nullptr) {
-	    std::cerr << "@ cycle " <<  get_curr_cycle() << " "
-		      << std::hex << rob.at(i)->pc << std::dec << " "
-		      <<  getAsmString(rob.at(i)->inst, rob.at(i)->pc)
-		      << " breaks retirement\n";
-	    exit(-1);
-	  }
-	  rob.at(i)->op->complete(machine_state);
-	}
-      }
-      gthread_yield();
-    }
-    gthread_terminate();
   }
-  void retire(void *arg) {
-    sim_state &machine_state = *reinterpret_cast<sim_state*>(arg);
-    if(machine_state.oracle_mem)
-      retire<true>(machine_state);
-    else
-      retire<false>(machine_state);
+  else {
+    std::fill(machine_state.wr_ports.begin(),
+	      machine_state.wr_ports.end(),
+	      0);
   }
+  machine_state.total_dispatched_insns += exec_cnt;
+}
 
-  
+static void complete_stage(sim_state &machine_state) {
+  if(machine_state.nuke) {
+    return;
+  }
+  machine_state.complete_wheel.drain(get_curr_cycle(), [&machine_state](sim_op u) {
+      if(machine_state.nuke) {
+	return;
+      }
+      if(u->op == nullptr) {
+	std::cerr << "@ cycle " <<  get_curr_cycle() << " "
+		  << std::hex << u->pc << std::dec << " "
+		  <<  getAsmString(u->inst, u->pc)
+		  << " breaks retirement\n";
+	exit(-1);
+      }
+      u->op->complete(machine_state);
+    });
+}
+
+static void cache_stage(sim_state &machine_state) {
+  machine_state.l1d->tick(machine_state.complete_wheel);
+}
+
+/* gthread engine : each stage runs as a coroutine,
+ * yielding once per simulated cycle */
+extern "C" {
+#define GTHREAD_STAGE(NAME,STAGE)					\
+  void NAME(void *arg) {						\
+    sim_state &machine_state = *reinterpret_cast<sim_state*>(arg);	\
+    while(not(machine_state.terminate_sim)) {				\
+      STAGE(machine_state);						\
+      gthread_yield();							\
+    }									\
+    gthread_terminate();						\
+  }
+  GTHREAD_STAGE(cycle_count, cycle_count_stage)
+  GTHREAD_STAGE(cache, cache_stage)
+  GTHREAD_STAGE(fetch, fetch_stage<false>)
+  GTHREAD_STAGE(oracle_fetch, fetch_stage<true>)
+  GTHREAD_STAGE(decode, decode_stage)
+  GTHREAD_STAGE(allocate, allocate_stage)
+  GTHREAD_STAGE(execute, execute_stage)
+  GTHREAD_STAGE(complete, complete_stage)
+  GTHREAD_STAGE(retire, retire_stage<false>)
+  GTHREAD_STAGE(oracle_retire, retire_stage<true>)
+#undef GTHREAD_STAGE
 };
 
+/* static engine : same stages called in the gthread
+ * round-robin order from a single loop */
+template <bool enable_oracle>
+static void run_cycle_loop(sim_state &machine_state) {
+  const bool use_cache = (machine_state.l1d != nullptr);
+  while(true) {
+#define RUN_STAGE(STAGE) {			\
+      if(machine_state.terminate_sim) {		\
+	break;					\
+      }						\
+      STAGE(machine_state);			\
+    }
+    RUN_STAGE(retire_stage<enable_oracle>);
+    RUN_STAGE(complete_stage);
+    RUN_STAGE(execute_stage);
+    RUN_STAGE(allocate_stage);
+    RUN_STAGE(decode_stage);
+    RUN_STAGE(fetch_stage<enable_oracle>);
+    if(use_cache) {
+      RUN_STAGE(cache_stage);
+    }
+    RUN_STAGE(cycle_count_stage);
+#undef RUN_STAGE
+  }
+}
 
 
 void sim_state::copy_state(const state_t *s) {
@@ -1162,6 +1499,38 @@ void sim_state::copy_state(const state_t *s) {
 }
 
 
+/* hand the retired architectural state back to the interpreter */
+void sim_state::sync_state(state_t *s) const {
+  for(int i = 0; i < 32; i++) {
+    s->gpr[i] = gpr_prf[gpr_rat_retire[i]];
+  }
+  s->lo = gpr_prf[gpr_rat_retire[32]];
+  s->hi = gpr_prf[gpr_rat_retire[33]];
+  for(int i = 0; i < 32; i++) {
+    s->cpr0[i] = cpr0_prf[cpr0_rat_retire[i]];
+  }
+  for(int i = 0; i < 32; i++) {
+    s->cpr1[i] = cpr1_prf[cpr1_rat_retire[i]];
+  }
+  for(int i = 0; i < 5; i++) {
+    s->fcr1[i] = fcr1_prf[fcr1_rat_retire[i]];
+  }
+  s->icnt = icnt;
+  /* the oldest op still in the pipeline is on the correct path */
+  if(not(rob.empty())) {
+    s->pc = rob.peek()->pc;
+  }
+  else if(not(decode_queue.empty())) {
+    s->pc = decode_queue.peek()->pc;
+  }
+  else if(not(fetch_queue.empty())) {
+    s->pc = fetch_queue.peek()->pc;
+  }
+  else {
+    s->pc = delay_slot_npc ? delay_slot_npc : fetch_pc;
+  }
+}
+
 void sim_state::initialize_rat_mappings() {
   for(int i = 0; i < 32; i++) {
     gpr_rat[i] = i;
@@ -1197,6 +1566,101 @@ void sim_state::initialize_rat_mappings() {
   }
 }
 
+sim_state::sim_state() {}
+
+sim_state::~sim_state() {
+  if(gpr_prf) delete [] gpr_prf;
+  if(cpr0_prf) delete [] cpr0_prf;
+  if(cpr1_prf) delete [] cpr1_prf;
+  if(fcr1_prf) delete [] fcr1_prf;
+  if(load_tbl) delete [] load_tbl;
+  if(store_tbl) delete [] store_tbl;
+  if(dcache) delete dcache;
+}
+
+mips_meta_op *sim_state::alloc_op(uint64_t fetch_icnt,
+				  uint32_t pc,
+				  uint32_t inst,
+				  uint32_t fetch_npc,
+				  uint64_t fetch_cycle,
+				  bool predict_taken,
+				  bool pop_return_stack) {
+  mips_meta_op *op = op_pool.get();
+  if(op == nullptr) {
+    return new mips_meta_op(fetch_icnt, pc, inst, fetch_npc, fetch_cycle,
+			    predict_taken, pop_return_stack);
+  }
+  op->reinit(fetch_icnt, pc, inst, fetch_npc, fetch_cycle,
+	     predict_taken, pop_return_stack);
+  return op;
+}
+
+void sim_state::free_op(mips_meta_op *op) {
+  op->release();
+  if(not(op_pool.put(op))) {
+    delete op;
+  }
+}
+
+void sim_state::park(mips_meta_op *u, rs_type *rs) {
+  waiter w = {u, rs};
+  switch(u->wait_rf)
+    {
+    case reg_file::gpr:
+      gpr_waiters.at(u->wait_prf).push_back(w);
+      break;
+    case reg_file::cpr1:
+      cpr1_waiters.at(u->wait_prf).push_back(w);
+      break;
+    case reg_file::fcr1:
+      fcr1_waiters.at(u->wait_prf).push_back(w);
+      break;
+    default:
+      die();
+    }
+}
+
+void sim_state::broadcast(reg_file rf, int32_t prf) {
+  std::vector<waiter> *w = nullptr;
+  switch(rf)
+    {
+    case reg_file::gpr:
+      gpr_valid.set_bit(prf);
+      w = &gpr_waiters[prf];
+      break;
+    case reg_file::cpr0:
+      /* nothing reads cpr0 out of order */
+      cpr0_valid.set_bit(prf);
+      return;
+    case reg_file::cpr1:
+      cpr1_valid.set_bit(prf);
+      w = &cpr1_waiters[prf];
+      break;
+    case reg_file::fcr1:
+      fcr1_valid.set_bit(prf);
+      w = &fcr1_waiters[prf];
+      break;
+    default:
+      die();
+    }
+  for(waiter &e : *w) {
+    e.rs->wake(e.u);
+  }
+  w->clear();
+}
+
+void sim_state::clear_waiters() {
+  for(auto &w : gpr_waiters) {
+    w.clear();
+  }
+  for(auto &w : cpr1_waiters) {
+    w.clear();
+  }
+  for(auto &w : fcr1_waiters) {
+    w.clear();
+  }
+}
+
 void sim_state::initialize() {
   num_gpr_prf_ = sim_param::num_gpr_prf;
   num_cpr0_prf_ = sim_param::num_cpr0_prf;
@@ -1226,6 +1690,8 @@ void sim_state::initialize() {
 
   store_tbl_freevec.clear_and_resize(sim_param::store_tbl_size);
   store_tbl = new mips_meta_op*[sim_param::store_tbl_size];
+  load_cam.resize(sim_param::lsq_cam_buckets);
+  store_cam.resize(sim_param::lsq_cam_buckets);
   
   for(size_t i = 0; i < load_tbl_freevec.size(); i++) {
     load_tbl[i] = nullptr;
@@ -1238,10 +1704,24 @@ void sim_state::initialize() {
   cpr0_valid.clear_and_resize(sim_param::num_cpr0_prf);
   cpr1_valid.clear_and_resize(sim_param::num_cpr1_prf);
   fcr1_valid.clear_and_resize(sim_param::num_fcr1_prf);
+  gpr_waiters.resize(sim_param::num_gpr_prf);
+  cpr1_waiters.resize(sim_param::num_cpr1_prf);
+  fcr1_waiters.resize(sim_param::num_fcr1_prf);
   
   fetch_queue.resize(sim_param::fetchq_size);
   decode_queue.resize(sim_param::decodeq_size);
   rob.resize(sim_param::rob_size);
+  complete_wheel.resize(2*max_op_lat);
+
+  /* everything in flight plus the op retire holds */
+  size_t max_inflight = sim_param::rob_size + sim_param::fetchq_size +
+    sim_param::decodeq_size + 2;
+  op_pool.set_limit(max_inflight);
+  op_pool.fill();
+  mips_op::set_pool_limit(max_inflight);
+  if(dcache == nullptr) {
+    dcache = new decode_cache(sim_param::lg_decode_cache_entries);
+  }
 
   num_alu_rs = sim_param::num_alu_ports;
   num_fpu_rs = sim_param::num_fpu_ports;
@@ -1271,6 +1751,14 @@ void sim_state::initialize() {
   system_rs.resize(sim_param::num_system_sched_entries);
 
   branch_pred = branch_predictor::get_predictor(sim_param::branch_predictor, *this);
+  btb = new branch_target_buffer(sim_param::btb_entries, sim_param::btb_ways,
+				 sim_param::btb_tag_bits, sim_param::btb_replacement);
+  store_sets = new store_set_predictor(sim_param::ssit_entries, sim_param::lfst_entries,
+				       sim_param::store_set_clear_interval);
+  /* walks go through the data caches */
+  if(l1d and sim_param::model_tlbs) {
+    mmu = new sim_mmu(l1d);
+  }
     
   if(sim_param::num_loop_entries) {
     loop_pred = new loop_predictor(sim_param::num_loop_entries);
@@ -1299,18 +1787,51 @@ void sim_state::initialize() {
   initialize_rat_mappings();
 }
 
+/* run the static engine until maxicnt instructions retire or the
+ * program stops ; can be called again with a larger maxicnt */
+void step_ooo_core(sim_state &machine_state, uint64_t maxicnt) {
+  machine_state.maxicnt = maxicnt;
+  machine_state.terminate_sim = false;
+  if(machine_state.oracle_mem != nullptr) {
+    run_cycle_loop<true>(machine_state);
+  }
+  else {
+    run_cycle_loop<false>(machine_state);
+  }
+}
 
-void run_ooo_core(sim_state &machine_state) {
-  gthread::make_gthread(&retire, reinterpret_cast<void*>(&machine_state));
-  gthread::make_gthread(&complete,reinterpret_cast<void*>(&machine_state));
-  gthread::make_gthread(&execute, reinterpret_cast<void*>(&machine_state));
-  gthread::make_gthread(&allocate, reinterpret_cast<void*>(&machine_state));
-  gthread::make_gthread(&decode, reinterpret_cast<void*>(&machine_state));
-  gthread::make_gthread(&fetch, reinterpret_cast<void*>(&machine_state));
-  gthread::make_gthread(&cache, reinterpret_cast<void*>(&machine_state));
-  gthread::make_gthread(&cycle_count, reinterpret_cast<void*>(&machine_state));
+void run_ooo_core(sim_state &machine_state, bool use_gthreads, bool decoupled_fetch) {
+  const bool use_oracle = (machine_state.oracle_mem != nullptr);
+  if(decoupled_fetch and use_oracle and (machine_state.frontend == nullptr)) {
+    machine_state.frontend = new oracle_frontend(machine_state);
+    machine_state.frontend->start();
+  }
+  else if(decoupled_fetch and not(use_oracle)) {
+    *global::sim_log << "decoupled fetch needs the branch oracle, ignored\n";
+  }
+  if(use_gthreads) {
+    void *arg = reinterpret_cast<void*>(&machine_state);
+    gthread::make_gthread(use_oracle ? &oracle_retire : &retire, arg);
+    gthread::make_gthread(&complete, arg);
+    gthread::make_gthread(&execute, arg);
+    gthread::make_gthread(&allocate, arg);
+    gthread::make_gthread(&decode, arg);
+    gthread::make_gthread(use_oracle ? &oracle_fetch : &fetch, arg);
+    if(machine_state.l1d) {
+      gthread::make_gthread(&cache, arg);
+    }
+    gthread::make_gthread(&cycle_count, arg);
+  }
   double now = timestamp();
-  start_gthreads();
+  if(use_gthreads) {
+    start_gthreads();
+  }
+  else if(use_oracle) {
+    run_cycle_loop<true>(machine_state);
+  }
+  else {
+    run_cycle_loop<false>(machine_state);
+  }
   now = timestamp() - now;
 
   
@@ -1397,10 +1918,44 @@ void run_ooo_core(sim_state &machine_state) {
 	    << " mispredicted jrs\n";
   *global::sim_log << machine_state.mispredicted_jalrs 
 	    << " mispredicted jalrs\n";
+  if(machine_state.btb) {
+    *global::sim_log << machine_state.btb->get_hits() << " btb hits\n";
+    *global::sim_log << machine_state.btb->get_misses() << " btb misses\n";
+    *global::sim_log << machine_state.btb->get_target_mispredicts()
+		     << " btb target mispredicts\n";
+  }
+  if(machine_state.mmu) {
+    const sim_mmu &mmu = *machine_state.mmu;
+    const sim_tlb *tlbs[] = {&mmu.get_itlb(), &mmu.get_dtlb(), &mmu.get_stlb()};
+    const char *names[] = {"itlb", "dtlb", "stlb"};
+    for(int i = 0; i < 3; i++) {
+      double t_mpki = (tlbs[i]->get_misses()/static_cast<double>(total_insns))*1000.0;
+      *global::sim_log << tlbs[i]->get_misses() << " " << names[i] << " misses\n";
+      *global::sim_log << t_mpki << " " << names[i] << " MPKI\n";
+    }
+    *global::sim_log << mmu.get_walks() << " page walks\n";
+    *global::sim_log << mmu.get_walk_cycles() << " page walk cycles\n";
+  }
+  if(machine_state.l1i) {
+    double i_mpki = (machine_state.l1i->getMisses()/static_cast<double>(total_insns))*1000.0;
+    *global::sim_log << machine_state.l1i->getMisses() << " l1i misses\n";
+    *global::sim_log << i_mpki << " l1i MPKI\n";
+  }
+  if(machine_state.store_sets) {
+    *global::sim_log << machine_state.store_sets->get_violations()
+		     << " store set violations\n";
+    *global::sim_log << machine_state.store_sets->get_predicted_deps()
+		     << " store set predicted dependences\n";
+    *global::sim_log << machine_state.store_sets->get_clears()
+		     << " store set clears\n";
+  }
 
+  *global::sim_log << machine_state.skipped_cycles << " idle cycles skipped\n";
   *global::sim_log << machine_state.nukes << " nukes\n";
   *global::sim_log << machine_state.branch_nukes << " branch nukes\n";
   *global::sim_log << machine_state.load_nukes << " load nukes\n";
+  *global::sim_log << machine_state.stlf_forwards << " store to load forwards\n";
+  *global::sim_log << machine_state.stlf_replays << " partial overlap load replays\n";
   
   //*global::sim_log << "CHECK INSN CNT : "
   //<< machine_state.ref_state->icnt << "\n";
@@ -1408,10 +1963,10 @@ void run_ooo_core(sim_state &machine_state) {
   if(get_curr_cycle() != 0) {
     double avg_latency = 0.0;
     double d_cycles = static_cast<double>(get_curr_cycle());
-    for(auto &p : insn_lifetime_map) {
+    for(auto &p : machine_state.insn_lifetime_map) {
       avg_latency += (static_cast<double>(p.first) * static_cast<double>(p.second)) / d_cycles;
     }
-    mapToCSV(insn_lifetime_map,"insn_lifetime_map.csv");
+    mapToCSV(machine_state.insn_lifetime_map,"insn_lifetime_map.csv");
     *global::sim_log << avg_latency << " cycles is the average instruction lifetime\n";
   }
   
@@ -1422,8 +1977,283 @@ void run_ooo_core(sim_state &machine_state) {
   *global::sim_log << (prediction_rate*100.0) << "\% of branches and jumps predicted correctly\n";
   
   *global::sim_log << ((machine_state.icnt-machine_state.skipicnt)/now)
-	    << " simulated instructions per second\n";
+	    << " simulated instructions per second ("
+	    << (use_gthreads ? "gthread" : "static")
+	    << " engine)\n";
   *global::sim_log << "simulation took " << now << " seconds\n";
   
 }  
 
+
+/* drop everything in flight and restart the pipeline from the
+ * architectural state in s ; caches and predictors are kept */
+static void reseed_ooo_core(sim_state &machine_state, const state_t *s) {
+  auto &rob = machine_state.rob;
+  for(size_t i = 0; i < rob.capacity(); i++) {
+    if(rob.at(i)) {
+      machine_state.free_op(rob.at(i));
+      rob.at(i) = nullptr;
+    }
+  }
+  finish_nuke(machine_state);
+  if(machine_state.l1d) {
+    machine_state.l1d->nuke_inflight();
+  }
+  machine_state.gpr_freevec.clear();
+  machine_state.cpr0_freevec.clear();
+  machine_state.cpr1_freevec.clear();
+  machine_state.fcr1_freevec.clear();
+  machine_state.gpr_freevec_retire.clear();
+  machine_state.cpr0_freevec_retire.clear();
+  machine_state.cpr1_freevec_retire.clear();
+  machine_state.fcr1_freevec_retire.clear();
+  machine_state.gpr_valid.clear();
+  machine_state.cpr0_valid.clear();
+  machine_state.cpr1_valid.clear();
+  machine_state.fcr1_valid.clear();
+  machine_state.initialize_rat_mappings();
+  machine_state.spec_bhr.copy(machine_state.bhr);
+  machine_state.wr_ports.fill(0);
+  machine_state.retire_ctx = retire_context();
+  machine_state.terminate_sim = false;
+  machine_state.last_retire_cycle = global::curr_cycle;
+  machine_state.copy_state(s);
+}
+
+struct sample_stat {
+  double sum = 0.0, sum2 = 0.0;
+  uint64_t n = 0;
+  void add(double x) {
+    sum += x;
+    sum2 += x*x;
+    n++;
+  }
+  double mean() const {
+    return n ? sum / n : 0.0;
+  }
+  double stddev() const {
+    if(n < 2) {
+      return 0.0;
+    }
+    double m = mean();
+    double v = (sum2 - n*m*m) / (n-1);
+    return v > 0.0 ? std::sqrt(v) : 0.0;
+  }
+  /* half-width of the 95% confidence interval */
+  double ci95() const {
+    return n ? 1.96 * stddev() / std::sqrt(static_cast<double>(n)) : 0.0;
+  }
+};
+
+struct window_stats {
+  uint64_t detailed_insns = 0, detailed_cycles = 0;
+  uint64_t insns = 0, cycles = 0, mispredicts = 0;
+  uint64_t l1d_hits = 0, l1d_misses = 0;
+};
+
+/* the interpreter and the pipeline take turns on one image */
+static void share_interp_mem(sim_state &machine_state) {
+  state_t *s = machine_state.ref_state;
+  if(machine_state.mem != &(s->mem)) {
+    delete machine_state.mem;
+    machine_state.mem = &(s->mem);
+  }
+}
+
+/* reseed from the interpreter, run warmup instructions then the
+ * measured window in detail and hand the state back. returns false
+ * if the program exited or the watchdog fired before the window end */
+static bool run_detailed_window(sim_state &machine_state, uint64_t maxicnt,
+				uint64_t warmup, uint64_t window,
+				window_stats &ws) {
+  state_t *s = machine_state.ref_state;
+  simCache *l1d = machine_state.l1d;
+  bool ok = true;
+  reseed_ooo_core(machine_state, s);
+  uint64_t start_cycle = global::curr_cycle;
+  uint64_t icnt0 = 0, cycle0 = 0, mispredicts0 = 0;
+  uint64_t hits0 = 0, misses0 = 0;
+  for(int w = 0; w < 2; w++) {
+    if(w == 1) {
+      icnt0 = machine_state.icnt;
+      cycle0 = global::curr_cycle;
+      mispredicts0 = machine_state.mispredicted_branches + machine_state.mispredicted_jumps;
+      if(l1d) {
+	hits0 = l1d->getHits();
+	misses0 = l1d->getMisses();
+      }
+    }
+    step_ooo_core(machine_state, std::min(maxicnt, machine_state.icnt + (w ? window : warmup)));
+    if(machine_state.retire_ctx.stop_sim or (machine_state.icnt < machine_state.maxicnt)) {
+      ok = false;
+      break;
+    }
+  }
+  ws.detailed_insns = machine_state.icnt - s->icnt;
+  ws.detailed_cycles = global::curr_cycle - start_cycle;
+  if(ok) {
+    ws.insns = machine_state.icnt - icnt0;
+    ws.cycles = global::curr_cycle - cycle0;
+    ws.mispredicts = machine_state.mispredicted_branches + machine_state.mispredicted_jumps - mispredicts0;
+    if(l1d) {
+      ws.l1d_hits = l1d->getHits() - hits0;
+      ws.l1d_misses = l1d->getMisses() - misses0;
+    }
+  }
+  /* the interpreter check steps s at each retire, so s already holds
+   * the state at the window end ; what we hand back must agree */
+  const bool check = global::use_interp_check and ok;
+  uint32_t ref_pc = 0;
+  int32_t ref_gpr[32];
+  if(check) {
+    ref_pc = s->pc;
+    memcpy(ref_gpr, s->gpr, sizeof(ref_gpr));
+  }
+  machine_state.sync_state(s);
+  if(check) {
+    bool error = (s->pc != ref_pc);
+    for(int i = 0; i < 32; i++) {
+      error |= (s->gpr[i] != ref_gpr[i]);
+    }
+    if(error) {
+      std::cerr << "window hands back pc " << std::hex << s->pc
+		<< ", interpreter is at " << ref_pc << std::dec
+		<< " after " << machine_state.icnt << " insns\n";
+      die();
+    }
+  }
+  if(machine_state.retire_ctx.stop_sim) {
+    s->brk = 1;
+  }
+  return ok;
+}
+
+/* SMARTS-style sampling : every interval instructions, fast-forward
+ * in the interpreter, run warmup instructions in detail, then measure
+ * window instructions in detail. */
+void run_sampled_ooo_core(sim_state &machine_state, uint64_t interval,
+			  uint64_t warmup, uint64_t window) {
+  state_t *s = machine_state.ref_state;
+  const uint64_t maxicnt = machine_state.maxicnt;
+  const uint64_t fastfwd = interval - (warmup + window);
+  sample_stat cpi, mpki, l1d_miss_rate;
+  uint64_t detailed_insns = 0, detailed_cycles = 0;
+  uint64_t interval_start = s->icnt;
+
+  share_interp_mem(machine_state);
+  
+  double now = timestamp();
+  while(true) {
+    while((s->icnt < (interval_start + fastfwd)) and (s->icnt < maxicnt) and not(s->brk)) {
+      runMips(s, std::min(interval_start + fastfwd, maxicnt));
+    }
+    if(s->brk or (s->icnt >= maxicnt)) {
+      break;
+    }
+    window_stats ws;
+    bool ok = run_detailed_window(machine_state, maxicnt, warmup, window, ws);
+    detailed_insns += ws.detailed_insns;
+    detailed_cycles += ws.detailed_cycles;
+    if(not(ok)) {
+      break;
+    }
+    if(ws.insns != 0) {
+      double n_insns = static_cast<double>(ws.insns);
+      cpi.add(ws.cycles / n_insns);
+      mpki.add(1000.0 * ws.mispredicts / n_insns);
+      if((ws.l1d_hits + ws.l1d_misses) != 0) {
+	l1d_miss_rate.add(static_cast<double>(ws.l1d_misses) / (ws.l1d_hits + ws.l1d_misses));
+      }
+    }
+    interval_start += interval;
+  }
+  now = timestamp() - now;
+  machine_state.maxicnt = maxicnt;
+  
+  *global::sim_log << cpi.n << " samples of " << window
+		   << " insns (" << warmup << " warmup) every "
+		   << interval << " insns\n";
+  *global::sim_log << s->icnt << " insns total, "
+		   << detailed_insns << " in detail over "
+		   << detailed_cycles << " cycles\n";
+  if(cpi.n != 0) {
+    double m = cpi.mean();
+    *global::sim_log << "sampled cpi = " << m << " +- " << cpi.ci95() << " (95% conf)\n";
+    *global::sim_log << "sampled ipc = " << (1.0/m) << " ["
+		     << (1.0/(m + cpi.ci95())) << ","
+		     << (1.0/std::max(m - cpi.ci95(), 1e-9)) << "]\n";
+    *global::sim_log << "sampled mpki = " << mpki.mean() << " +- " << mpki.ci95() << "\n";
+    if(l1d_miss_rate.n != 0) {
+      *global::sim_log << "sampled l1d miss rate = " << l1d_miss_rate.mean()
+		       << " +- " << l1d_miss_rate.ci95() << "\n";
+    }
+    /* samples needed for +-3% cpi error at 95% confidence */
+    double cv = cpi.stddev() / m;
+    *global::sim_log << static_cast<uint64_t>(std::ceil((1.96*cv/0.03)*(1.96*cv/0.03)))
+		     << " samples needed for +-3% cpi error\n";
+  }
+  *global::sim_log << "simulation took " << now << " seconds\n";
+}
+
+/* simulate each simpoint interval in detail and weight the
+ * per-interval cpi by its cluster weight */
+void run_simpoint_ooo_core(sim_state &machine_state,
+			   const std::vector<simpoint> &simpoints,
+			   uint64_t interval, uint64_t warmup) {
+  state_t *s = machine_state.ref_state;
+  const uint64_t maxicnt = machine_state.maxicnt;
+  const uint64_t base_icnt = s->icnt;
+  double weighted_cpi = 0.0, weighted_mpki = 0.0, total_weight = 0.0;
+  
+  share_interp_mem(machine_state);
+
+  double now = timestamp();
+  for(const simpoint &sp : simpoints) {
+    uint64_t start = base_icnt + sp.interval * interval;
+    uint64_t warm_start = (start > (base_icnt + warmup)) ? (start - warmup) : base_icnt;
+    /* a window may end past its interval, on its last branch's delay
+     * slot ; only an overlap with the detailed interval skips it, one
+     * with the warmup just shortens the warmup */
+    if(s->icnt > start) {
+      std::cerr << "simpoint " << sp.interval << " overlaps the previous one, skipped\n";
+      continue;
+    }
+    warm_start = std::max(warm_start, s->icnt);
+    while((s->icnt < warm_start) and not(s->brk)) {
+      runMips(s, warm_start);
+    }
+    if(s->brk) {
+      break;
+    }
+    window_stats ws;
+    bool ok = run_detailed_window(machine_state, maxicnt, start - s->icnt, interval, ws);
+    if(ws.insns != 0) {
+      double cpi = static_cast<double>(ws.cycles) / ws.insns;
+      double mpki = 1000.0 * static_cast<double>(ws.mispredicts) / ws.insns;
+      *global::sim_log << "simpoint " << sp.interval
+		       << " weight " << sp.weight
+		       << " : cpi " << cpi
+		       << ", mpki " << mpki << "\n";
+      weighted_cpi += sp.weight * cpi;
+      weighted_mpki += sp.weight * mpki;
+      total_weight += sp.weight;
+    }
+    if(not(ok)) {
+      break;
+    }
+  }
+  now = timestamp() - now;
+  machine_state.maxicnt = maxicnt;
+  
+  if(total_weight > 0.0) {
+    weighted_cpi /= total_weight;
+    weighted_mpki /= total_weight;
+    *global::sim_log << "weighted cpi = " << weighted_cpi << "\n";
+    *global::sim_log << "weighted ipc = " << (1.0/weighted_cpi) << "\n";
+    *global::sim_log << "weighted mpki = " << weighted_mpki << "\n";
+    if(total_weight < 0.999) {
+      *global::sim_log << "simpoints covered " << (total_weight*100.0) << "% of the weight\n";
+    }
+  }
+  *global::sim_log << "simulation took " << now << " seconds\n";
+}
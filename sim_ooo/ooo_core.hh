@@ -0,0 +1,30 @@
+#ifndef __ooo_core_hh__
+#define __ooo_core_hh__
+
+#include <cstdint>
+#include <vector>
+
+class sim_state;
+class simCache;
+class sparse_mem;
+struct state_t;
+struct simpoint;
+
+void initialize_ooo_core(sim_state &machine_state,
+			 simCache *l1d,
+			 simCache *l1i,
+			 bool use_oracle,
+			 bool use_syscall_skip,
+			 uint64_t skipicnt, uint64_t maxicnt,
+			 state_t *s, const sparse_mem *sm);
+
+void step_ooo_core(sim_state &machine_state, uint64_t maxicnt);
+void run_ooo_core(sim_state &machine_state, bool use_gthreads, bool decoupled_fetch);
+void run_sampled_ooo_core(sim_state &machine_state, uint64_t interval,
+			  uint64_t warmup, uint64_t window);
+void run_simpoint_ooo_core(sim_state &machine_state,
+			   const std::vector<simpoint> &simpoints,
+			   uint64_t interval, uint64_t warmup);
+void destroy_ooo_core(sim_state &machine_state);
+
+#endif
@@ -0,0 +1,169 @@
+#include <cassert>
+#include <iostream>
+
+#include "oracle_frontend.hh"
+#include "interpret.hh"
+#include "helper.hh"
+#include "mips_op.hh"
+#include "sim_parameters.hh"
+#include "machine_state.hh"
+
+oracle_frontend::oracle_frontend(sim_state &machine_state) :
+  machine_state(machine_state),
+  oracle(machine_state.oracle_state),
+  ring(ring_len),
+  stop(false) {
+  assert(oracle != nullptr);
+  fetch_pc = machine_state.fetch_pc;
+  delay_slot_npc = machine_state.delay_slot_npc;
+  fetch_icnt = next_icnt = machine_state.fetched_insns;
+
+  /* a nuke never rewinds past the oldest op in the pipeline */
+  uint64_t inflight = sim_param::rob_size + sim_param::fetchq_size +
+    sim_param::decodeq_size;
+  uint64_t history_len = 1;
+  while(history_len < 2*inflight) {
+    history_len *= 2;
+  }
+  history.resize(history_len);
+  history_mask = history_len - 1;
+  dcache = new decode_cache(sim_param::lg_decode_cache_entries);
+}
+
+oracle_frontend::~oracle_frontend() {
+  halt();
+  record r;
+  while(ring.pop(r)) {
+    delete r.op;
+  }
+  delete dcache;
+}
+
+void oracle_frontend::start() {
+  producer = std::thread(&oracle_frontend::run, this);
+}
+
+void oracle_frontend::halt() {
+  stop.store(true);
+  if(producer.joinable()) {
+    producer.join();
+  }
+}
+
+/* same walk as fetch_stage<true>, minus timing and bandwidth */
+void oracle_frontend::produce(record &r) {
+  sparse_mem &mem = oracle->mem;
+  r.icnt = fetch_icnt;
+  r.delay_slot = false;
+  r.predict_taken = false;
+
+  if(delay_slot_npc) {
+    r.pc = delay_slot_npc;
+    r.inst = bswap(mem.get32(delay_slot_npc));
+    r.npc = delay_slot_npc + 4;
+    r.delay_slot = true;
+    delay_slot_npc = 0;
+  }
+  else {
+    r.pc = fetch_pc;
+    r.inst = bswap(mem.get32(fetch_pc));
+    r.npc = fetch_pc + 4;
+    if(not(oracle->brk)) {
+      if(fetch_icnt == oracle->icnt) {
+	execMips(oracle);
+      }
+      auto &hh = oracle->hbuf[fetch_icnt%HWINDOW];
+      if(hh.icnt != fetch_icnt or hh.fetch_pc != fetch_pc) {
+	std::cerr << "hh.fetch_pc = "
+		  << std::hex
+		  << hh.fetch_pc
+		  << ",fetch_pc = "
+		  << fetch_pc
+		  << std::dec
+		  << " hh.icnt = "
+		  << hh.icnt
+		  << ",fetch_icnt = "
+		  << fetch_icnt
+		  << "\n";
+	die();
+      }
+      bool jump = is_jal(r.inst) or is_jr(r.inst) or is_j(r.inst);
+      if(jump) {
+	assert(hh.was_branch_or_jump and hh.took_branch_or_jump);
+      }
+      if(hh.was_branch_or_jump and hh.took_branch_or_jump) {
+	delay_slot_npc = fetch_pc + 4;
+	r.npc = hh.next_pc;
+	r.predict_taken = true;
+      }
+      else if(hh.was_likely_branch and not(hh.took_branch_or_jump)) {
+	r.npc = fetch_pc + 8;
+      }
+    }
+    fetch_pc = r.npc;
+  }
+  r.op = new mips_meta_op(r.icnt, r.pc, r.inst, r.npc, 0,
+			  r.predict_taken, false);
+  r.op->op = dcache->decode(r.op);
+  fetch_icnt++;
+}
+
+void oracle_frontend::run() {
+  record r;
+  bool pending = false;
+  while(not(stop.load(std::memory_order_relaxed))) {
+    if(not(pending)) {
+      produce(r);
+      pending = true;
+    }
+    if(ring.push(r)) {
+      pending = false;
+    }
+    else {
+      std::this_thread::yield();
+    }
+  }
+  if(pending) {
+    delete r.op;
+  }
+}
+
+uint32_t oracle_frontend::peek_pc() {
+  const uint64_t icnt = machine_state.fetched_insns;
+  if(icnt < next_icnt) {
+    return history[icnt & history_mask].pc;
+  }
+  const record *r = nullptr;
+  while((r = ring.peek()) == nullptr) {
+    std::this_thread::yield();
+  }
+  return r->pc;
+}
+
+mips_meta_op *oracle_frontend::next(uint64_t fetch_cycle, bool &delay_slot) {
+  const uint64_t icnt = machine_state.fetched_insns;
+  mips_meta_op *f = nullptr;
+  if(icnt < next_icnt) {
+    /* refetch after a nuke ; the ops were freed by the
+     * rollback so rebuild them, decode_stage will decode */
+    const record &r = history[icnt & history_mask];
+    assert(r.icnt == icnt);
+    f = machine_state.alloc_op(r.icnt, r.pc, r.inst, r.npc, fetch_cycle,
+			       r.predict_taken, false);
+    delay_slot = r.delay_slot;
+    return f;
+  }
+  assert(icnt == next_icnt);
+  record r;
+  while(not(ring.pop(r))) {
+    std::this_thread::yield();
+  }
+  assert(r.icnt == icnt);
+  f = r.op;
+  f->fetch_cycle = fetch_cycle;
+  delay_slot = r.delay_slot;
+  r.op = nullptr;
+  history[icnt & history_mask] = r;
+  next_icnt++;
+  return f;
+}
@@ -0,0 +1,60 @@
+#ifndef __oracle_frontend_hh__
+#define __oracle_frontend_hh__
+
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "spsc_queue.hh"
+
+struct state_t;
+class sim_state;
+class mips_meta_op;
+class decode_cache;
+
+/* With the branch oracle, the fetch stream does not depend on
+ * backend timing. This runs the oracle, builds and predecodes
+ * mips_meta_ops on a second host thread ; fetch_stage pulls them
+ * at the modeled fetch bandwidth and stamps the fetch cycle. */
+class oracle_frontend {
+public:
+  struct record {
+    mips_meta_op *op;
+    uint64_t icnt;
+    uint32_t pc, inst, npc;
+    bool predict_taken, delay_slot;
+  };
+private:
+  static const uint64_t ring_len = 4096;
+  sim_state &machine_state;
+  state_t *oracle;
+  spsc_queue<record> ring;
+  std::thread producer;
+  std::atomic<bool> stop;
+
+  /* producer side : owned by the frontend thread */
+  uint32_t fetch_pc = 0, delay_slot_npc = 0;
+  uint64_t fetch_icnt = 0;
+  decode_cache *dcache = nullptr;
+
+  /* consumer side : records already handed to the pipeline,
+   * replayed after a nuke rewinds machine_state.fetched_insns */
+  uint64_t next_icnt = 0;
+  std::vector<record> history;
+  uint64_t history_mask = 0;
+
+  void produce(record &r);
+  void run();
+public:
+  oracle_frontend(sim_state &machine_state);
+  ~oracle_frontend();
+  void start();
+  void halt();
+  /* op with fetch_icnt == machine_state.fetched_insns */
+  mips_meta_op *next(uint64_t fetch_cycle, bool &delay_slot);
+  /* pc of the op next() returns */
+  uint32_t peek_pc();
+};
+
+#endif
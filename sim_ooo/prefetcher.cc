@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "prefetcher.hh"
+#include "sim_parameters.hh"
+
+namespace {
+  /* fetch the next degree lines after each trigger */
+  class next_line : public prefetcher {
+  public:
+    next_line(uint32_t line_bytes, int degree) :
+      prefetcher(line_bytes, degree) {}
+    const char *name() const override {
+      return "next_line";
+    }
+    void observe(uint32_t /*pc*/, uint32_t addr, bool trigger,
+		 std::vector<uint32_t> &addrs) override {
+      if(not(trigger)) {
+	return;
+      }
+      for(int i = 1; i <= degree; i++) {
+	addrs.push_back(line_of(addr) + i*line_bytes);
+      }
+    }
+  };
+
+  /* Chen and Baer's reference prediction table : a direct-mapped
+   * table indexed by load pc remembers the last address and stride.
+   * trains on every access and prefetches once the same stride has
+   * been seen twice in a row */
+  class pc_stride : public prefetcher {
+  private:
+    struct entry {
+      uint32_t pc = 0;
+      uint32_t last = 0;
+      int32_t stride = 0;
+      int conf = 0;
+    };
+    std::vector<entry> tbl;
+  public:
+    pc_stride(uint32_t line_bytes, int degree, uint32_t n_entries) :
+      prefetcher(line_bytes, degree), tbl(n_entries) {}
+    const char *name() const override {
+      return "pc_stride";
+    }
+    void observe(uint32_t pc, uint32_t addr, bool /*trigger*/,
+		 std::vector<uint32_t> &addrs) override {
+      entry &e = tbl[(pc >> 2) & (tbl.size()-1)];
+      if(e.pc != pc) {
+	e.pc = pc;
+	e.last = addr;
+	e.stride = 0;
+	e.conf = 0;
+	return;
+      }
+      int32_t d = static_cast<int32_t>(addr - e.last);
+      e.last = addr;
+      if(d == 0) {
+	return;
+      }
+      if(d == e.stride) {
+	e.conf = std::min(e.conf + 1, 3);
+      }
+      else if(e.conf > 0) {
+	e.conf--;
+      }
+      else {
+	e.stride = d;
+      }
+      if(e.conf < 2) {
+	return;
+      }
+      uint32_t prev = line_of(addr);
+      for(int i = 1; i <= degree; i++) {
+	uint32_t a = line_of(addr + i*e.stride);
+	if(a != prev) {
+	  addrs.push_back(a);
+	  prev = a;
+	}
+      }
+    }
+  };
+
+  /* tracks a few ascending or descending miss streams. a trigger
+   * within window lines of a stream advances it ; a second step in
+   * the same direction confirms it and from then on every trigger
+   * prefetches degree lines ahead */
+  class stream : public prefetcher {
+  private:
+    static const int32_t window = 8;
+    struct entry {
+      bool valid = false;
+      uint32_t last = 0;
+      int32_t dir = 1;
+      int conf = 0;
+      uint64_t stamp = 0;
+    };
+    std::vector<entry> tbl;
+    uint64_t clock = 0;
+  public:
+    stream(uint32_t line_bytes, int degree, uint32_t n_streams) :
+      prefetcher(line_bytes, degree), tbl(n_streams) {}
+    const char *name() const override {
+      return "stream";
+    }
+    void observe(uint32_t /*pc*/, uint32_t addr, bool trigger,
+		 std::vector<uint32_t> &addrs) override {
+      if(not(trigger)) {
+	return;
+      }
+      const int32_t l = static_cast<int32_t>(addr / line_bytes);
+      entry *s = nullptr, *victim = &tbl[0];
+      for(entry &e : tbl) {
+	int32_t d = l - static_cast<int32_t>(e.last);
+	if(e.valid and (std::abs(d) <= window)) {
+	  s = &e;
+	  break;
+	}
+	if(not(e.valid) or (victim->valid and (e.stamp < victim->stamp))) {
+	  victim = &e;
+	}
+      }
+      clock++;
+      if(s == nullptr) {
+	victim->valid = true;
+	victim->last = l;
+	victim->dir = 1;
+	victim->conf = 0;
+	victim->stamp = clock;
+	return;
+      }
+      s->stamp = clock;
+      int32_t d = l - static_cast<int32_t>(s->last);
+      if(d == 0) {
+	return;
+      }
+      int32_t dir = (d > 0) ? 1 : -1;
+      if(dir == s->dir) {
+	s->conf = std::min(s->conf + 1, 2);
+      }
+      else {
+	s->dir = dir;
+	s->conf = 1;
+      }
+      s->last = l;
+      if(s->conf < 2) {
+	return;
+      }
+      for(int i = 1; i <= degree; i++) {
+	addrs.push_back(static_cast<uint32_t>(l + i*dir) * line_bytes);
+      }
+    }
+  };
+}
+
+prefetcher* prefetcher::get_prefetcher(int id, uint32_t line_bytes) {
+  switch(id)
+    {
+    case 1:
+      return new next_line(line_bytes, sim_param::prefetch_degree);
+    case 2:
+      return new pc_stride(line_bytes, sim_param::prefetch_degree,
+			   sim_param::pf_stride_entries);
+    case 3:
+      return new stream(line_bytes, sim_param::prefetch_degree,
+			sim_param::pf_streams);
+    default:
+      break;
+    }
+  return nullptr;
+}
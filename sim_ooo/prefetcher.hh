@@ -0,0 +1,30 @@
+#ifndef __prefetcher_hh__
+#define __prefetcher_hh__
+
+#include <cstdint>
+#include <vector>
+
+/* hardware prefetcher attached to one cache level. it sees every
+ * timed demand access to that level and proposes addresses for the
+ * level to fill. trigger is set on a demand miss and on the first
+ * demand touch of a prefetched line, so a covered stream keeps
+ * running ahead */
+class prefetcher {
+protected:
+  const uint32_t line_bytes;
+  const int degree;
+  uint32_t line_of(uint32_t addr) const {
+    return addr & ~(line_bytes-1);
+  }
+public:
+  /* 0 : none, 1 : next-line, 2 : pc-stride, 3 : stream */
+  static prefetcher* get_prefetcher(int id, uint32_t line_bytes);
+  prefetcher(uint32_t line_bytes, int degree) :
+    line_bytes(line_bytes), degree(degree) {}
+  virtual ~prefetcher() {}
+  virtual const char *name() const = 0;
+  virtual void observe(uint32_t pc, uint32_t addr, bool trigger,
+		       std::vector<uint32_t> &addrs) = 0;
+};
+
+#endif
@@ -2,10 +2,15 @@
 #include <iostream>
 #include <cstdint>
 #include <cassert>
+#include <algorithm>
+#include <vector>
 #include <fcntl.h>
 
 #include "sparse_mem.hh"
 #include "saveState.hh"
+#include "interpret.hh"
+#include "helper.hh"
+#include "globals.hh"
 
 struct page {
   uint32_t va;
@@ -55,3 +60,95 @@ void loadState(state_t &s, const std::string &filename, bool clear_icnt) {
   }
   close(fd);
 }
+
+static void write_header(int fd, const state_t &s, uint32_t num_pages) {
+  header h;
+  h.pc = s.pc;
+  memcpy(&h.gpr,&s.gpr,sizeof(s.gpr));
+  h.lo = s.lo;
+  h.hi = s.hi;
+  memcpy(&h.cpr0,&s.cpr0,sizeof(s.cpr0));
+  memcpy(&h.cpr1,&s.cpr1,sizeof(s.cpr1));
+  memcpy(&h.fcr1,&s.fcr1,sizeof(s.fcr1));
+  h.icnt = s.icnt;
+  h.num_nz_pages = num_pages;
+  size_t sz = write(fd, &h, sizeof(h));
+  assert(sz == sizeof(h));
+}
+
+static void write_page(int fd, sparse_mem &mem, uint32_t pg) {
+  page p;
+  p.va = pg * sparse_mem::pgsize;
+  if(mem.get_page(pg)) {
+    memcpy(p.data, mem.get_page(pg), sparse_mem::pgsize);
+  }
+  else {
+    memset(p.data, 0, sparse_mem::pgsize);
+  }
+  size_t sz = write(fd, &p, sizeof(p));
+  assert(sz == sizeof(p));
+}
+
+void saveState(state_t &s, const std::string &filename) {
+  std::vector<uint32_t> pages;
+  for(int64_t p = s.mem.first_page(); p != -1; p = s.mem.get_next_page(p)) {
+    if(not(s.mem.is_zero_page(p))) {
+      pages.push_back(p);
+    }
+  }
+  int fd = ::open(filename.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0600);
+  assert(fd != -1);
+  write_header(fd, s, pages.size());
+  for(uint32_t p : pages) {
+    write_page(fd, s.mem, p);
+  }
+  close(fd);
+}
+
+checkpoint_writer::checkpoint_writer(const std::string &prefix, bool incremental) :
+  prefix(prefix), incremental(incremental) {}
+
+std::string checkpoint_writer::write(state_t &s) {
+  sparse_mem &mem = s.mem;
+  std::string filename = prefix + "." + std::to_string(s.icnt);
+  std::vector<uint32_t> pages;
+  
+  if(not(incremental) or (n_written == 0)) {
+    saveState(s, filename);
+  }
+  else {
+    /* every page handed out for writing since the last dump, even
+     * one that reads as zero now, so it replaces the older copy */
+    for(int64_t p = mem.first_dirty_page(); p != -1; p = mem.get_next_dirty_page(p)) {
+      pages.push_back(p);
+    }
+    filename += ".inc";
+    int fd = ::open(filename.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0600);
+    assert(fd != -1);
+    write_header(fd, s, pages.size());
+    for(uint32_t p : pages) {
+      write_page(fd, mem, p);
+    }
+    close(fd);
+  }
+  mem.clear_dirty();
+  n_written++;
+  return filename;
+}
+
+void checkpoint_run(state_t *s, const std::string &prefix, uint64_t every,
+		    bool incremental, uint64_t maxicnt) {
+  checkpoint_writer w(prefix, incremental);
+  uint64_t next = s->icnt + every;
+  double now = timestamp();
+  while(not(s->brk) and (s->icnt < maxicnt)) {
+    runMips(s, std::min(next, maxicnt));
+    if(s->icnt >= next) {
+      std::string fname = w.write(*s);
+      *global::sim_log << "wrote " << fname << " at icnt " << s->icnt << "\n";
+      next += every;
+    }
+  }
+  now = timestamp() - now;
+  *global::sim_log << (s->icnt / now) << " instructions per second with checkpointing\n";
+}
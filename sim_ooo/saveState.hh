@@ -5,5 +5,23 @@
 #include "state.hh"
 
 void loadState(state_t &s, const std::string &filename, bool clr_icnt = false);
+void saveState(state_t &s, const std::string &filename);
+
+/* writes checkpoints in the loadState format. incremental
+ * checkpoints hold only pages changed since the previous one
+ * and are loaded on top of it. */
+class checkpoint_writer {
+private:
+  std::string prefix;
+  bool incremental;
+  uint64_t n_written = 0;
+public:
+  checkpoint_writer(const std::string &prefix, bool incremental);
+  std::string write(state_t &s);
+};
+
+/* run the interpreter, checkpointing every n instructions */
+void checkpoint_run(state_t *s, const std::string &prefix, uint64_t every,
+		    bool incremental, uint64_t maxicnt);
 
 #endif
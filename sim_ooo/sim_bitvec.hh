@@ -222,6 +222,14 @@ public:
   E to_integer() const {
     return arr[0];
   }
+  /* the n lowest bits, n <= 64 */
+  uint64_t low_bits(uint64_t n) const {
+    uint64_t v = 0;
+    for(uint64_t w = 0, b = 0; (w < n_words) and (b < n); w++, b += bpw) {
+      v |= static_cast<uint64_t>(arr[w]) << b;
+    }
+    return (n < 64) ? (v & ((1UL << n) - 1)) : v;
+  }
   friend std::ostream & operator<<(std::ostream &out, const sim_bitvec_template<E> &bv) {
     for(size_t i = 0; i < bv.size(); i++) {
       out <<  bv.get_bit(i);
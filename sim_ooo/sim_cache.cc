@@ -1,30 +1,69 @@
 #include <cstdio>
 #include <algorithm>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 #include "sim_cache.hh"
 #include "sim_parameters.hh"
 #include "helper.hh"
 #include "mips_op.hh"
+#include "prefetcher.hh"
+#include "dram.hh"
 
 uint64_t get_curr_cycle();
 
-std::ostream &operator<<(std::ostream &out, const simCache &cache) {
-  double total = static_cast<double>(cache.hits+cache.misses);
-  double rate = cache.misses / total;
+void simCache::print_level(std::ostream &out) const {
+  double total = static_cast<double>(hits+misses);
+  double rate = misses / total;
   
-  out << cache.name << ":\n";
-  out << "total_cache_size = " << cache.total_cache_size << "\n";
-  out << "bytes_per_line = " << cache.bytes_per_line << "\n";
-  out << "assoc = " << cache.assoc << "\n";
-  out << "num_sets = " << cache.num_sets<< "\n";
+  out << name << ":\n";
+  out << "total_cache_size = " << total_cache_size << "\n";
+  out << "bytes_per_line = " << bytes_per_line << "\n";
+  out << "assoc = " << assoc << "\n";
+  out << "num_sets = " << num_sets<< "\n";
   out << "miss_rate = " << rate << "\n";
-  out << "total_accesses = " << (cache.hits+cache.misses) << "\n";
-  out << "hits = " << cache.hits << "\n";
-  out << "misses = " << cache.misses << "\n";
-  out << "read_hits = "<< cache.rw_hits[0] << "\n";
-  out << "read_misses = "<< cache.rw_misses[0] << "\n";
-  out << "write_hits = "<< cache.rw_hits[1] << "\n";
-  out << "write_misses = "<< cache.rw_misses[1] << "\n";
-  out << "amat = " << cache.computeAMAT() << "\n";
+  out << "total_accesses = " << (hits+misses) << "\n";
+  out << "hits = " << hits << "\n";
+  out << "misses = " << misses << "\n";
+  out << "read_hits = "<< rw_hits[0] << "\n";
+  out << "read_misses = "<< rw_misses[0] << "\n";
+  out << "write_hits = "<< rw_hits[1] << "\n";
+  out << "write_misses = "<< rw_misses[1] << "\n";
+  out << "amat = " << computeAMAT() << "\n";
+  if(not(mshrs.empty())) {
+    out << "mshrs = " << mshrs.size() << "\n";
+    out << "mshr_merges = " << mshr_merges << "\n";
+    out << "mshr_stalls = " << mshr_stalls << "\n";
+    out << "mlp_hist =";
+    for(size_t n : mlp_hist) {
+      out << " " << n;
+    }
+    out << "\n";
+  }
+  if(writebacks or writebacks_in) {
+    const uint64_t cycles = std::max(get_curr_cycle(), static_cast<uint64_t>(1));
+    out << "writebacks = " << writebacks << "\n";
+    out << "writebacks_in = " << writebacks_in << "\n";
+    out << "writeback_bytes = " << (writebacks * bytes_per_line) << "\n";
+    out << "writeback_bytes_per_cycle = "
+	<< (static_cast<double>(writebacks * bytes_per_line) / cycles) << "\n";
+  }
+  if(pf) {
+    double useful = static_cast<double>(pf_useful);
+    out << "prefetcher = " << pf->name() << "\n";
+    out << "pf_issued = " << pf_issued << "\n";
+    out << "pf_useful = " << pf_useful << "\n";
+    out << "pf_timely = " << (pf_useful - pf_late) << "\n";
+    out << "pf_late = " << pf_late << "\n";
+    out << "pf_redundant = " << pf_redundant << "\n";
+    out << "pf_dropped = " << pf_dropped << "\n";
+    out << "pf_accuracy = " << (useful / pf_issued) << "\n";
+    out << "pf_coverage = " << (useful / (useful + demand_misses)) << "\n";
+  }
+}
+
+std::ostream &operator<<(std::ostream &out, const simCache &cache) {
+  cache.print_level(out);
   if(cache.next_level)
     out << *(cache.next_level);
   
@@ -56,10 +95,12 @@ simCache::simCache(size_t bytes_per_line, size_t assoc, size_t num_sets,
   
   ln2_offset_bits = ln2_num_sets + ln2_bytes_per_line;
   ln2_tag_bits = 8*sizeof(uint32_t) - ln2_offset_bits;
-  inflight.resize(sim_param::rob_size);
+  max_inflight = sim_param::rob_size;
 }
 
-simCache::~simCache() {}
+simCache::~simCache() {
+  delete pf;
+}
 
 void highAssocCache::flush() {
   for(size_t i =0; i < num_sets; i++) {
@@ -347,7 +388,9 @@ bool setAssocCache::access(uint32_t addr, uint32_t num_bytes, opType o, uint32_t
   uint32_t w,t;
   lat += latency;
   uint32_t b = index(addr, w, t);
-  bool hit = sets[w]->access(t,o);
+  uint32_t victim = 0;
+  bool dirty = false;
+  bool hit = sets[w]->access(t,o,victim,dirty);
 #if 0
   std::cerr << "access 0x"
 	    << std::hex
@@ -361,18 +404,163 @@ bool setAssocCache::access(uint32_t addr, uint32_t num_bytes, opType o, uint32_t
 	    << "\n";
 #endif
   if(not(hit)) {
-    if(next_level) {
-      size_t reload_addr = addr & (~(bytes_per_line-1));
-      next_level->access(reload_addr, bytes_per_line, o, lat);
-    }
-    else {
-      lat += sim_param::mem_latency;
-    }
+    fill(addr, lat);
+  }
+  /* the victim leaves once the fill lands */
+  if(dirty) {
+    writeback(line_addr(w, victim), lat);
   }
   return hit;
   
 }
 
+void setAssocCache::accept_writeback(uint32_t addr, uint32_t lat) {
+  uint32_t w,t;
+  index(addr, w, t);
+  writebacks_in++;
+  uint32_t victim = 0;
+  if(sets[w]->install_dirty(t, victim)) {
+    writeback(line_addr(w, victim), lat + latency);
+  }
+}
+
+flatSetAssocCache::flatSetAssocCache(size_t bytes_per_line, size_t assoc, size_t num_sets,
+				     std::string name, int latency, simCache *next_level) :
+  simCache(bytes_per_line, assoc, num_sets, name, latency, next_level),
+  tags(assoc*num_sets, invalid_tag),
+  ages(assoc*num_sets, static_cast<uint8_t>(assoc)),
+  dirty(assoc*num_sets, 0) {
+  /* ages are bytes and assoc marks an empty way */
+  if(assoc > 255) {
+    die();
+  }
+}
+
+int32_t flatSetAssocCache::find(const uint32_t *set, uint32_t tag) const {
+  uint32_t w = 0;
+#ifdef __AVX2__
+  const __m256i t = _mm256_set1_epi32(tag);
+  for(; (w + 8) <= assoc; w += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(set + w));
+    uint32_t m = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, t)));
+    if(m) {
+      return w + __builtin_ctz(m);
+    }
+  }
+#endif
+  for(; w < assoc; w++) {
+    if(set[w] == tag) {
+      return w;
+    }
+  }
+  return -1;
+}
+
+/* every way younger than this one ages by one. empty ways sit at
+ * assoc and never move. n is a local as the byte stores could alias
+ * assoc, which would keep the loop from vectorizing */
+void flatSetAssocCache::touch(size_t base, uint32_t way) {
+  uint8_t *a = &ages[base];
+  const uint8_t age = a[way];
+  const uint32_t n = assoc;
+  for(uint32_t w = 0; w < n; w++) {
+    a[w] += (a[w] < age);
+  }
+  a[way] = 0;
+}
+
+/* a set with an empty way has no valid way aged assoc-1, so any way
+ * at least that old is an empty one or the lru. the scan runs over
+ * every way without an early exit, the position is random enough to
+ * defeat the branch predictor */
+bool flatSetAssocCache::allocate(size_t base, uint32_t tag, bool d, uint32_t &victim) {
+  const uint8_t *a = &ages[base];
+  const uint32_t n = assoc;
+  const uint8_t oldest = static_cast<uint8_t>(n-1);
+  uint32_t way = 0;
+  for(uint32_t w = 0; w < n; w++) {
+    way = (a[w] >= oldest) ? w : way;
+  }
+  bool wb = (tags[base+way] != invalid_tag) and dirty[base+way];
+  victim = tags[base+way];
+  tags[base+way] = tag;
+  dirty[base+way] = d;
+  touch(base, way);
+  return wb;
+}
+
+void flatSetAssocCache::flush() {
+  std::fill(tags.begin(), tags.end(), invalid_tag);
+  std::fill(ages.begin(), ages.end(), static_cast<uint8_t>(assoc));
+  std::fill(dirty.begin(), dirty.end(), 0);
+  if(next_level) {
+    next_level->flush();
+  }
+}
+
+void flatSetAssocCache::flush_line(uint32_t addr) {
+  uint32_t w,t;
+  index(addr, w, t);
+  const size_t base = w*assoc;
+  int32_t way = find(&tags[base], t);
+  if(way >= 0) {
+    /* close the gap so the valid ways stay 0..n-1 */
+    uint8_t *a = &ages[base];
+    const uint8_t age = a[way];
+    const uint32_t n = assoc;
+    for(uint32_t v = 0; v < n; v++) {
+      a[v] -= (a[v] > age) and (a[v] < n);
+    }
+    a[way] = static_cast<uint8_t>(assoc);
+    tags[base+way] = invalid_tag;
+    dirty[base+way] = 0;
+  }
+  if(next_level) {
+    next_level->flush_line(addr);
+  }
+}
+
+bool flatSetAssocCache::access(uint32_t addr, uint32_t num_bytes, opType o, uint32_t &lat) {
+  uint32_t w,t;
+  lat += latency;
+  index(addr, w, t);
+  const size_t base = w*assoc;
+  const size_t rw = (opType::WRITE==o) ? 1 : 0;
+  int32_t way = find(&tags[base], t);
+  if(way >= 0) {
+    rw_hits[rw]++;
+    hits++;
+    dirty[base+way] |= rw;
+    touch(base, way);
+    return true;
+  }
+  rw_misses[rw]++;
+  misses++;
+  uint32_t victim = 0;
+  bool wb = allocate(base, t, rw, victim);
+  fill(addr, lat);
+  if(wb) {
+    writeback(line_addr(w, victim), lat);
+  }
+  return false;
+}
+
+void flatSetAssocCache::accept_writeback(uint32_t addr, uint32_t lat) {
+  uint32_t w,t;
+  index(addr, w, t);
+  const size_t base = w*assoc;
+  writebacks_in++;
+  int32_t way = find(&tags[base], t);
+  if(way >= 0) {
+    dirty[base+way] = 1;
+    return;
+  }
+  uint32_t victim = 0;
+  if(allocate(base, t, true, victim)) {
+    writeback(line_addr(w, victim), lat + latency);
+  }
+}
+
 void fullRandAssocCache::flush() {
   entries.clear();
   tags.clear();
@@ -452,11 +640,7 @@ bool highAssocCache::access(uint32_t addr, uint32_t num_bytes, opType o, uint32_
   
   /* cache miss .. handle it */
   if( a == (assoc+1)) {
-    if(next_level) {
-      /* mask off to align */
-      size_t reload_addr = addr & (~(bytes_per_line-1));
-      next_level->access(reload_addr, bytes_per_line, o, lat);
-    }
+    fill(addr, lat);
     
     misses++;
     rw_misses[(opType::WRITE==o) ? 1 : 0]++;
@@ -578,12 +762,7 @@ bool lowAssocCache::access(uint32_t addr, uint32_t num_bytes, opType o, uint32_t
   /* cache miss .. handle it */
   if( a == (assoc+1))
     {
-      if(next_level)
-	{
-	  /* mask off to align */
-	  size_t reload_addr = addr & (~(bytes_per_line-1));
-	  next_level->access(reload_addr, bytes_per_line, o, lat);
-	}
+      fill(addr, lat);
       
       misses++;
       rw_misses[(opType::WRITE==o) ? 1 : 0]++;
@@ -609,22 +788,231 @@ bool lowAssocCache::access(uint32_t addr, uint32_t num_bytes, opType o, uint32_t
   return h;
 }
 
-void simCache::tick() {
+void simCache::set_miss_handlers(size_t n) {
+  mshrs.clear();
+  mshrs.resize(n);
+  mlp_hist.clear();
+  mlp_hist.resize(n+1, 0);
+}
+
+void simCache::fill(uint32_t addr, uint32_t &lat) {
+  /* mask off to align */
+  size_t reload_addr = addr & (~(bytes_per_line-1));
+  /* a write miss fetches the line too, it is only dirty up here */
+  if(next_level == nullptr) {
+    if(timed and memory) {
+      lat += memory->access(reload_addr, bytes_per_line, opType::READ, get_curr_cycle() + lat);
+    }
+    else {
+      lat += sim_param::mem_latency;
+    }
+  }
+  else if(prefetching) {
+    next_level->prefetch_fill(reload_addr, lat);
+  }
+  else if(timed) {
+    next_level->lookup(reload_addr, bytes_per_line, opType::READ, lat, demand_pc);
+  }
+  else {
+    next_level->access(reload_addr, bytes_per_line, opType::READ, lat);
+  }
+}
+
+/* writebacks are posted : nothing waits on them, but they occupy the
+ * next level and the dram behind it */
+void simCache::writeback(uint32_t addr, uint32_t lat) {
+  writebacks++;
   if(next_level) {
-    next_level->tick();
+    next_level->timed = timed;
+    next_level->accept_writeback(addr, lat);
+    next_level->timed = false;
   }
-  
-  for(auto it = inflight.begin(); it != inflight.end(); /* nil */) {
-    sim_op o = *it;
-     if(o->aux_cycle == get_curr_cycle()) {
-      size_t was = inflight.size();
-      o->complete_cycle = o->aux_cycle + 1;
-      it = inflight.erase(it);
+  else if(timed and memory) {
+    memory->access(addr, bytes_per_line, opType::WRITE, get_curr_cycle() + lat);
+  }
+}
+
+void simCache::accept_writeback(uint32_t addr, uint32_t lat) {
+  writebacks_in++;
+  writeback(addr, lat + latency);
+}
+
+/* access from the pipeline : lat holds the cycles spent reaching this
+ * level. a request to a line still being filled merges onto that
+ * fill, a primary miss takes a free mshr or waits for the first one
+ * to free up */
+bool simCache::lookup(uint32_t addr, uint32_t num_bytes, opType o, uint32_t &lat, uint32_t pc) {
+  const uint64_t now = get_curr_cycle();
+  const uint64_t t = now + lat;
+  const uint32_t line = addr & (~(bytes_per_line-1));
+  demand_pc = pc;
+  timed = true;
+  bool hit = access(addr, num_bytes, o, lat);
+  timed = false;
+  demand_misses += not(hit);
+  bool trigger = not(hit);
+  if(pf) {
+    pf_entry &e = pf_slot(line);
+    if(e.valid and (e.line == line)) {
+      /* a miss here means the prefetched line was evicted unused */
+      if(hit) {
+	pf_useful++;
+	trigger = true;
+	if(e.ready > t) {
+	  pf_late++;
+	  lat = std::max(static_cast<uint64_t>(lat), e.ready - now);
+	}
+      }
+      e.valid = false;
+    }
+  }
+  if(not(mshrs.empty())) {
+    track_miss(line, hit, t, lat);
+  }
+  if(pf) {
+    pf->observe(pc, addr, trigger, pf_addrs);
+    for(uint32_t a : pf_addrs) {
+      prefetch(a & (~(bytes_per_line-1)), t);
+    }
+    pf_addrs.clear();
+  }
+  return hit;
+}
+
+void simCache::track_miss(uint32_t line, bool hit, uint64_t t, uint32_t &lat) {
+  const uint64_t now = get_curr_cycle();
+  mshr *pending = nullptr, *avail = nullptr, *first = nullptr;
+  size_t busy = 0;
+  for(mshr &e : mshrs) {
+    if(e.ready > t) {
+      busy++;
+      if(e.line == line) {
+	pending = &e;
+      }
+      if((first == nullptr) or (e.ready < first->ready)) {
+	first = &e;
+      }
+    }
+    else if(avail == nullptr) {
+      avail = &e;
+    }
+  }
+  if(pending) {
+    mshr_merges++;
+    lat = std::max(static_cast<uint64_t>(lat), pending->ready - now);
+    return;
+  }
+  if(hit) {
+    return;
+  }
+  mlp_hist[busy]++;
+  if(avail == nullptr) {
+    mshr_stalls++;
+    lat += first->ready - t;
+    avail = first;
+  }
+  avail->line = line;
+  avail->ready = now + lat;
+}
+
+/* fill line into this level as if the access had arrived at cycle t.
+ * prefetches leave the demand stats alone, never wait for an mshr
+ * and always leave one free for demand misses */
+void simCache::prefetch(uint32_t line, uint64_t t) {
+  const uint64_t now = get_curr_cycle();
+  pf_entry &e = pf_slot(line);
+  if(e.valid and (e.line == line)) {
+    return;
+  }
+  mshr *avail = nullptr;
+  size_t n_free = 0;
+  for(mshr &m : mshrs) {
+    if(m.ready > t) {
+      if(m.line == line) {
+	return;
+      }
     }
     else {
-      it++;
+      avail = &m;
+      n_free++;
+    }
+  }
+  if(not(mshrs.empty()) and (n_free < 2)) {
+    pf_dropped++;
+    return;
+  }
+  uint32_t lat = t - now;
+  bool hit = prefetch_fill(line, lat);
+  if(hit) {
+    pf_redundant++;
+    return;
+  }
+  pf_issued++;
+  e.valid = true;
+  e.line = line;
+  e.ready = now + lat;
+  if(avail) {
+    avail->line = line;
+    avail->ready = now + lat;
+  }
+}
+
+bool simCache::prefetch_fill(uint32_t line, uint32_t &lat) {
+  const size_t h = hits, m = misses;
+  const std::array<size_t,2> rh = rw_hits, rm = rw_misses;
+  timed = prefetching = true;
+  bool hit = access(line, bytes_per_line, opType::READ, lat);
+  timed = prefetching = false;
+  hits = h;
+  misses = m;
+  rw_hits = rh;
+  rw_misses = rm;
+  return hit;
+}
+
+void simCache::set_prefetcher(prefetcher *p) {
+  delete pf;
+  pf = p;
+  pf_tbl.clear();
+  if(pf) {
+    pf_tbl.resize(assoc*num_sets);
+  }
+}
+
+void simCache::set_memory(dram_controller *m) {
+  if(next_level) {
+    next_level->set_memory(m);
+  }
+  else {
+    memory = m;
+  }
+}
+
+void simCache::tick(sim_wheel<mips_meta_op*> &completions) {
+  if(next_level) {
+    next_level->tick(completions);
+  }
+  const uint64_t now = get_curr_cycle();
+  inflight.drain(now, [&completions, now](sim_op o) {
+      o->complete_cycle = o->aux_cycle + 1;
+      completions.schedule(now, o->complete_cycle, o);
+    });
+}
+
+int64_t simCache::next_inflight_cycle() const {
+  int64_t c = next_level ? next_level->next_inflight_cycle() : -1;
+  int64_t a = inflight.next_event(get_curr_cycle());
+  if((a != -1) and ((c == -1) or (a < c))) {
+    c = a;
+  }
+  /* a freed mshr can unblock a waiting load */
+  for(const mshr &e : mshrs) {
+    int64_t r = static_cast<int64_t>(e.ready);
+    if((e.ready > get_curr_cycle()) and ((c == -1) or (r < c))) {
+      c = r;
     }
   }
+  return c;
 }
 
 void simCache::nuke_inflight() {
@@ -634,22 +1022,28 @@ void simCache::nuke_inflight() {
   inflight.clear();
 }
 
-uint32_t simCache::read(sim_op op, uint32_t addr, uint32_t num_bytes) {
-  uint32_t lat = 0;
-  bool hit = access(addr,num_bytes,opType::READ,lat);
+uint32_t simCache::read(sim_op op, uint32_t addr, uint32_t num_bytes, uint32_t delay) {
+  uint32_t lat = delay;
+  bool hit = lookup(addr,num_bytes,opType::READ,lat,op->pc);
   if(not(hit) and false) {
     assert(op);
     std::cerr << "read: " << std::hex << op->pc << std::dec << " missed\n";
   }
   op->aux_cycle = lat + get_curr_cycle();
-  assert(not(inflight.full()));
-  inflight.push(op);
+  assert(inflight.size() < max_inflight);
+  inflight.schedule(get_curr_cycle(), op->aux_cycle, op);
   return lat;
 }
 
-uint32_t simCache::write(sim_op op, uint32_t addr, uint32_t num_bytes) {
-  uint32_t lat = 0;
-  bool hit = access(addr,num_bytes,opType::WRITE,lat);
+uint32_t simCache::fetch(uint32_t addr, uint32_t pc, uint32_t delay) {
+  uint32_t lat = delay;
+  lookup(addr, 4, opType::READ, lat, pc);
+  return (lat > static_cast<uint32_t>(latency)) ? (lat - latency) : 0;
+}
+
+uint32_t simCache::write(sim_op op, uint32_t addr, uint32_t num_bytes, uint32_t delay) {
+  uint32_t lat = delay;
+  bool hit = lookup(addr,num_bytes,opType::WRITE,lat,op->pc);
   if(not(hit) and false) {
     assert(op);
     std::cerr << "write: "
@@ -660,10 +1054,10 @@ uint32_t simCache::write(sim_op op, uint32_t addr, uint32_t num_bytes) {
 	      << lat
 	      << "\n";
   }
-  lat = 1;
+  lat = delay + 1;
   op->aux_cycle = lat + get_curr_cycle();
-  assert(not(inflight.full()));
-  inflight.push(op);
+  assert(inflight.size() < max_inflight);
+  inflight.schedule(get_curr_cycle(), op->aux_cycle, op);
   return lat;
 }
 
@@ -821,11 +1215,7 @@ bool randomReplacementCache::access(uint32_t addr, uint32_t num_bytes, opType o,
   /* cache miss .. handle it */
   if( a == (assoc+1))
     {
-      if(next_level) {
-	/* mask off to align */
-	size_t reload_addr = addr & (~(bytes_per_line-1));
-	next_level->access(reload_addr, bytes_per_line, o, lat);
-      }
+      fill(addr, lat);
       
       misses++;
       rw_misses[(o==opType::WRITE) ? 1 : 0]++;
@@ -886,12 +1276,7 @@ bool realLRUCache::access(uint32_t addr, uint32_t num_bytes, opType o, uint32_t
   /* cache miss .. handle it */
   if( a == (assoc+1))
     {
-      if(next_level)
-	{
-	  /* mask off to align */
-	  size_t reload_addr = addr & (~(bytes_per_line-1));
-	  next_level->access(reload_addr, bytes_per_line, o, lat);
-	}
+      fill(addr, lat);
       
       misses++;
       rw_misses[(o==opType::WRITE) ? 1 : 0]++;
@@ -15,9 +15,12 @@
 #include <boost/pool/object_pool.hpp>
 #include <boost/dynamic_bitset.hpp>
 #include "sim_list.hh"
+#include "sim_wheel.hh"
 #include "helper.hh"
 
 class mips_meta_op;
+class prefetcher;
+class dram_controller;
 
 enum class opType {READ,WRITE};
 
@@ -97,12 +100,18 @@ protected:
 	head = e;
       }
     }
+    T &back() {
+      return tail->getData();
+    }
     void pop_back() {
       if(tail==nullptr)
 	return;
       entry *ptr = tail;
       ptr->unlink();
       tail = ptr->prev;
+      if(tail == nullptr) {
+	head = nullptr;
+      }
       free(ptr);
       cnt--;
     }
@@ -239,6 +248,8 @@ protected:
   std::string name;
   int latency;
   simCache *next_level;
+  /* behind the last level, nullptr is a flat mem_latency */
+  dram_controller *memory = nullptr;
   size_t hits,misses;
   
   size_t total_cache_size;
@@ -251,23 +262,101 @@ protected:
   std::array<size_t,2> rw_hits;
   std::array<size_t,2> rw_misses;
 
-  sim_list<mips_meta_op*> inflight;
+  /* ops waiting on this level, keyed by aux_cycle */
+  sim_wheel<mips_meta_op*> inflight;
+  size_t max_inflight;
+
+  /* miss status holding registers : the line being filled and the
+   * cycle it lands. only timed accesses from the pipeline use them */
+  struct mshr {
+    uint32_t line = 0;
+    uint64_t ready = 0;
+  };
+  std::vector<mshr> mshrs;
+  /* busy mshrs seen by each primary miss */
+  std::vector<size_t> mlp_hist;
+  size_t mshr_merges = 0, mshr_stalls = 0;
+  bool timed = false;
+  /* the timed access in flight fills for a prefetch, its misses go
+   * down as prefetch fills rather than demand lookups */
+  bool prefetching = false;
+  /* pc of the timed access in flight, passed down with the fill */
+  uint32_t demand_pc = 0;
+
+  /* prefetched lines not yet touched by a demand access, one slot
+   * per line of capacity. a prefetch knocked out of its slot by
+   * another one is counted as unused */
+  struct pf_entry {
+    bool valid = false;
+    uint32_t line = 0;
+    uint64_t ready = 0;
+  };
+  prefetcher *pf = nullptr;
+  std::vector<pf_entry> pf_tbl;
+  std::vector<uint32_t> pf_addrs;
+  size_t pf_issued = 0, pf_useful = 0, pf_late = 0;
+  size_t pf_redundant = 0, pf_dropped = 0;
+  /* misses of demand lookups, what coverage is measured against */
+  size_t demand_misses = 0;
+  /* dirty victims sent down, and received from the level above */
+  size_t writebacks = 0, writebacks_in = 0;
+  pf_entry &pf_slot(uint32_t line) {
+    return pf_tbl[(line >> ln2_bytes_per_line) & (pf_tbl.size()-1)];
+  }
+  void prefetch(uint32_t line, uint64_t t);
+  /* timed fill for a prefetch from the level above : no stats, no
+   * mshr and no prefetcher training here or further down */
+  bool prefetch_fill(uint32_t line, uint32_t &lat);
+  /* mshr bookkeeping for a timed access that arrived at cycle t */
+  void track_miss(uint32_t line, bool hit, uint64_t t, uint32_t &lat);
+  /* line fill from the next level or memory */
+  void fill(uint32_t addr, uint32_t &lat);
+  bool lookup(uint32_t addr, uint32_t num_bytes, opType o, uint32_t &lat, uint32_t pc);
+  uint32_t line_addr(uint32_t set, uint32_t tag) const {
+    return (tag << ln2_offset_bits) | (set << ln2_bytes_per_line);
+  }
+  /* dirty victim leaving this level lat cycles from now */
+  void writeback(uint32_t addr, uint32_t lat);
+  /* a full dirty line from the level above, no fetch. levels without
+   * dirty state pass it straight down */
+  virtual void accept_writeback(uint32_t addr, uint32_t lat);
 public:
   friend std::ostream &operator<<(std::ostream &out, const simCache &cache);
+  /* this level only, operator<< walks the whole hierarchy */
+  void print_level(std::ostream &out) const;
   simCache(size_t bytes_per_line, size_t assoc, size_t num_sets, 
 	   std::string name, int latency, simCache *next_level);
   virtual ~simCache();
   
   void set_next_level(simCache *next_level);
+  /* 0 leaves misses unbounded */
+  void set_miss_handlers(size_t n);
+  /* takes ownership, nullptr detaches */
+  void set_prefetcher(prefetcher *p);
+  /* attaches to the last level, not owned */
+  void set_memory(dram_controller *m);
   
   uint32_t index(uint32_t addr, uint32_t &l, uint32_t &t);
   virtual bool access(uint32_t addr, uint32_t num_bytes, opType o, uint32_t &lat)=0;
   
-  uint32_t read(mips_meta_op *op, uint32_t addr, uint32_t num_bytes);
-  uint32_t write(mips_meta_op *op, uint32_t addr, uint32_t num_bytes);
+  /* delay : cycles before the access reaches this level, e.g.
+   * address translation */
+  uint32_t read(mips_meta_op *op, uint32_t addr, uint32_t num_bytes, uint32_t delay);
+  /* instruction fetch : the hit latency is covered by the fetch
+   * pipeline, returns the cycles fetch waits beyond it */
+  uint32_t fetch(uint32_t addr, uint32_t pc, uint32_t delay);
+  uint32_t write(mips_meta_op *op, uint32_t addr, uint32_t num_bytes, uint32_t delay);
+  /* timed access nothing waits on, e.g. a page walk. lat holds the
+   * cycles before it reaches this level and returns the total */
+  bool access_timed(uint32_t addr, uint32_t num_bytes, uint32_t pc, uint32_t &lat) {
+    return lookup(addr, num_bytes, opType::READ, lat, pc);
+  }
 
   void nuke_inflight();
-  virtual void tick();
+  /* fills due this cycle get their completion scheduled */
+  virtual void tick(sim_wheel<mips_meta_op*> &completions);
+  /* earliest pending aux_cycle in this level or below, -1 if idle */
+  int64_t next_inflight_cycle() const;
 
   /* warm-start uarch simulator with these methods */
   void read(uint32_t addr, uint32_t num_bytes) {
@@ -288,9 +377,6 @@ public:
   size_t capacity() const {
     return bytes_per_line*assoc*num_sets;
   }
-  bool miss_handlers_available() const {
-    return not(inflight.full());
-  }
   std::string getStats(std::string &fName);
   void getStats();
   double computeAMAT() const;
@@ -387,7 +473,25 @@ class setAssocCache: public simCache {
     size_t &hits;
     size_t &misses;
     size_t lhits,lmisses;
-    mylist<uint32_t> entries;
+    struct line {
+      uint32_t tag;
+      bool dirty;
+      line(uint32_t tag, bool dirty = false) : tag(tag), dirty(dirty) {}
+      bool operator==(const line &rhs) const {
+	return tag == rhs.tag;
+      }
+    };
+    mylist<line> entries;
+    /* makes room for a new line, true when the victim was dirty */
+    bool evict(uint32_t &victim) {
+      bool d = false;
+      if(entries.size() == assoc) {
+	d = entries.back().dirty;
+	victim = entries.back().tag;
+	entries.pop_back();
+      }
+      return d;
+    }
   public:
     cacheset(int32_t id, size_t assoc,
 	     size_t &hits, size_t &misses,
@@ -403,13 +507,17 @@ class setAssocCache: public simCache {
 	entries.erase(it);
       }
     }
-    bool access(uint32_t tag, opType o) {
+    /* write-allocate, write-back. dirty : set when the line pushed
+     * out to make room has to be written back */
+    bool access(uint32_t tag, opType o, uint32_t &victim, bool &dirty) {
       bool h = false;
       auto it = entries.find(tag);
+      dirty = false;
       if(it != entries.end()) {
 	rw_hits[(opType::WRITE==o) ? 1 : 0]++;
 	hits++;
 	lhits++;
+	(*it).dirty |= (opType::WRITE==o);
 	entries.move_to_head(it);
 	h = true;
       }
@@ -417,13 +525,23 @@ class setAssocCache: public simCache {
 	rw_misses[(opType::WRITE==o) ? 1 : 0]++;
 	misses++;
 	lmisses++;
-    	if(entries.size() == assoc) {
-	  entries.pop_back();
-	}
-	entries.push_front(tag);
+	dirty = evict(victim);
+	entries.push_front(line(tag, opType::WRITE==o));
       }
       return h;
     }
+    /* a written back line, installed dirty without touching the
+     * demand stats */
+    bool install_dirty(uint32_t tag, uint32_t &victim) {
+      auto it = entries.find(tag);
+      if(it != entries.end()) {
+	(*it).dirty = true;
+	return false;
+      }
+      bool d = evict(victim);
+      entries.push_front(line(tag, true));
+      return d;
+    }
     void clear() {
       entries.clear();
     }
@@ -432,6 +550,7 @@ class setAssocCache: public simCache {
     }
   };
   cacheset **sets;
+  void accept_writeback(uint32_t addr, uint32_t lat) override;
   
 public:
   setAssocCache(size_t bytes_per_line, size_t assoc, size_t num_sets, 
@@ -443,6 +562,33 @@ public:
 };
 
 
+/* setAssocCache with the tags of a set in one contiguous run and an
+ * lru age per way, 0 the most recent. empty ways hold invalid_tag and
+ * age assoc, so the oldest way is always the one to fill. tags are
+ * compared eight at a time with avx2. replacement matches the list
+ * version access for access, cache_bench checks that */
+class flatSetAssocCache: public simCache {
+private:
+  static const uint32_t invalid_tag = ~0U;
+  std::vector<uint32_t> tags;
+  std::vector<uint8_t> ages;
+  std::vector<uint8_t> dirty;
+  int32_t find(const uint32_t *set, uint32_t tag) const;
+  void touch(size_t base, uint32_t way);
+  /* installs tag over the oldest way, true when a dirty line was
+   * pushed out */
+  bool allocate(size_t base, uint32_t tag, bool d, uint32_t &victim);
+  void accept_writeback(uint32_t addr, uint32_t lat) override;
+public:
+  flatSetAssocCache(size_t bytes_per_line, size_t assoc, size_t num_sets,
+		    std::string name, int latency, simCache *next_level);
+  ~flatSetAssocCache() {}
+  bool access(uint32_t addr, uint32_t num_bytes, opType o, uint32_t &lat) override;
+  void flush() override;
+  void flush_line(uint32_t addr) override;
+};
+
+
 class fullRandAssocCache: public simCache {
  private:
   std::unordered_set<uint32_t> entries;
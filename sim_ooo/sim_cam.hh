@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+
+#ifndef __sim_cam_hh__
+#define __sim_cam_hh__
+
+/* stands in for the lsq address cam : load / store table slots
+ * hashed by 8-byte granule so a search only walks slots that can
+ * overlap. an access straddling two granules sits in both buckets */
+class sim_cam {
+private:
+  uint32_t mask = 0;
+  std::vector<std::vector<int32_t>> buckets;
+  uint32_t first(uint32_t addr) const {
+    return (addr >> 3) & mask;
+  }
+  uint32_t last(uint32_t addr, uint32_t len) const {
+    return ((addr + len - 1) >> 3) & mask;
+  }
+public:
+  sim_cam(size_t len = 64) {
+    resize(len);
+  }
+  void resize(size_t len) {
+    assert(((len-1)&len)==0);
+    mask = len-1;
+    buckets.clear();
+    buckets.resize(len);
+  }
+  void clear() {
+    for(auto &b : buckets) {
+      b.clear();
+    }
+  }
+  void insert(uint32_t addr, uint32_t len, int32_t id) {
+    buckets[first(addr)].push_back(id);
+    if(last(addr, len) != first(addr)) {
+      buckets[last(addr, len)].push_back(id);
+    }
+  }
+  void erase(uint32_t addr, uint32_t len, int32_t id) {
+    uint32_t b[2] = {first(addr), last(addr, len)};
+    for(int i = 0; i < ((b[0] == b[1]) ? 1 : 2); i++) {
+      std::vector<int32_t> &v = buckets[b[i]];
+      auto it = std::find(v.begin(), v.end(), id);
+      assert(it != v.end());
+      *it = v.back();
+      v.pop_back();
+    }
+  }
+  /* f(id) for every slot that may overlap [addr, addr+len) ; a
+   * slot in both buckets can be visited twice */
+  template <typename F>
+  void search(uint32_t addr, uint32_t len, F f) const {
+    for(int32_t id : buckets[first(addr)]) {
+      f(id);
+    }
+    if(last(addr, len) != first(addr)) {
+      for(int32_t id : buckets[last(addr, len)]) {
+	f(id);
+      }
+    }
+  }
+};
+
+#endif
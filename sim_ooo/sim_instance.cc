@@ -0,0 +1,214 @@
+#include <iostream>
+
+#include "sim_instance.hh"
+#include "sim_cache.hh"
+#include "prefetcher.hh"
+#include "dram.hh"
+#include "sparse_mem.hh"
+#include "state.hh"
+#include "globals.hh"
+#include "helper.hh"
+#include "ooo_core.hh"
+
+#define SAVE_SIM_PARAM_LIST
+#include "sim_parameters.hh"
+
+/* linkage */
+bool global::enClockFuncts = false;
+int global::sysArgc = 0;
+char **global::sysArgv = nullptr;
+thread_local std::ostream *global::sim_log = &(std::cout);
+thread_local bool global::use_interp_check = true;
+thread_local bool global::use_dbt = false;
+thread_local uint64_t global::curr_cycle = 0;
+thread_local uint64_t global::pipestart = 0;
+thread_local uint64_t global::pipeend = 0;
+
+#define SIM_PARAM(A,B,C,D) thread_local int sim_param::A = C;
+SIM_PARAM_LIST;
+#undef SIM_PARAM
+
+sim_instance::sim_instance(const state_t &program) : log(&(std::cout)) {
+#define SIM_PARAM(A,B,C,D) params.push_back(B);
+  SIM_PARAM_LIST;
+#undef SIM_PARAM
+  sm = new sparse_mem(program.mem);
+  s = new state_t(*sm);
+  s->copy(&program);
+  s->silent = true;
+}
+
+sim_instance::~sim_instance() {
+  if(initialized) {
+    enter();
+    destroy_ooo_core(machine_state);
+    leave();
+  }
+  delete s;
+  delete sm;
+  if(l1d) {
+    delete l1d;
+  }
+  if(l1i) {
+    delete l1i;
+  }
+  if(l2d) {
+    delete l2d;
+  }
+  if(l3d) {
+    delete l3d;
+  }
+  if(dram) {
+    delete dram;
+  }
+}
+
+bool sim_instance::set_param(const std::string &name, int value) {
+  if(initialized) {
+    return false;
+  }
+  size_t i = 0;
+#define SIM_PARAM(A,B,C,D) {						\
+    if(name == #A) {							\
+      if((value < C) or (D and not(isPow2(value)))) {			\
+	return false;							\
+      }									\
+      params[i] = value;						\
+      return true;							\
+    }									\
+    i++;								\
+  }
+  SIM_PARAM_LIST;
+#undef SIM_PARAM
+  return false;
+}
+
+bool sim_instance::get_param(const std::string &name, int &value) const {
+  size_t i = 0;
+#define SIM_PARAM(A,B,C,D) {			\
+    if(name == #A) {				\
+      value = params[i];			\
+      return true;				\
+    }						\
+    i++;					\
+  }
+  SIM_PARAM_LIST;
+#undef SIM_PARAM
+  return false;
+}
+
+void sim_instance::set_caches(bool use_mem_model, bool use_l2, bool use_l3) {
+  if(not(initialized)) {
+    this->use_mem_model = use_mem_model;
+    this->use_l2 = use_l2;
+    this->use_l3 = use_l2 and use_l3;
+  }
+}
+
+bool sim_instance::set_gthreads(bool use_gthreads) {
+  return not(use_gthreads);
+}
+
+void sim_instance::set_log(std::ostream *out) {
+  log = out;
+}
+
+/* install this instance's settings on the calling thread */
+void sim_instance::enter() {
+  size_t i = 0;
+#define SIM_PARAM(A,B,C,D) sim_param::A = params[i++];
+  SIM_PARAM_LIST;
+#undef SIM_PARAM
+  global::curr_cycle = curr_cycle;
+  global::sim_log = log;
+  global::use_interp_check = false;
+  global::use_dbt = false;
+  global::pipestart = global::pipeend = ~(0UL);
+}
+
+void sim_instance::leave() {
+  curr_cycle = global::curr_cycle;
+}
+
+void sim_instance::initialize() {
+  if(use_mem_model) {
+    if(use_l3) {
+      l3d = new flatSetAssocCache(sim_param::l3d_linesize,
+				  sim_param::l3d_assoc,
+				  sim_param::l3d_sets,
+				  "l3d",
+				  sim_param::l3d_latency,
+				  nullptr);
+      l3d->set_miss_handlers(sim_param::l3d_misses_inflight);
+      l3d->set_prefetcher(prefetcher::get_prefetcher(sim_param::l3d_prefetcher,
+						     sim_param::l3d_linesize));
+    }
+    if(use_l2) {
+      l2d = new flatSetAssocCache(sim_param::l2d_linesize,
+				  sim_param::l2d_assoc,
+				  sim_param::l2d_sets,
+				  "l2d",
+				  sim_param::l2d_latency, l3d);
+      l2d->set_miss_handlers(sim_param::l2d_misses_inflight);
+      l2d->set_prefetcher(prefetcher::get_prefetcher(sim_param::l2d_prefetcher,
+						     sim_param::l2d_linesize));
+    }
+    l1d = new flatSetAssocCache(sim_param::l1d_linesize,
+				sim_param::l1d_assoc,
+				sim_param::l1d_sets,
+				"l1d",
+				sim_param::l1d_latency, l2d);
+    l1d->set_miss_handlers(sim_param::l1d_misses_inflight);
+    l1d->set_prefetcher(prefetcher::get_prefetcher(sim_param::l1d_prefetcher,
+						   sim_param::l1d_linesize));
+    l1i = new flatSetAssocCache(sim_param::l1i_linesize,
+				sim_param::l1i_assoc,
+				sim_param::l1i_sets,
+				"l1i",
+				sim_param::l1i_latency, l2d);
+    l1i->set_prefetcher(prefetcher::get_prefetcher(sim_param::l1i_prefetcher,
+						   sim_param::l1i_linesize));
+    if(sim_param::use_dram) {
+      dram = new dram_controller();
+      l1d->set_memory(dram);
+      l1i->set_memory(dram);
+    }
+  }
+  initialize_ooo_core(machine_state, l1d, l1i, false, false, 0, ~(0UL), s, sm);
+  start_icnt = machine_state.icnt;
+  initialized = true;
+}
+
+uint64_t sim_instance::run(uint64_t n) {
+  enter();
+  if(not(initialized)) {
+    initialize();
+  }
+  uint64_t icnt = machine_state.icnt;
+  if(not(finished)) {
+    step_ooo_core(machine_state, icnt + n);
+    /* program exit or the no-retirement watchdog */
+    finished = machine_state.retire_ctx.stop_sim or (machine_state.icnt < (icnt + n));
+  }
+  leave();
+  return machine_state.icnt - icnt;
+}
+
+bool sim_instance::done() const {
+  return finished;
+}
+
+sim_instance::stats sim_instance::get_stats() const {
+  stats st;
+  st.insns = machine_state.icnt - start_icnt;
+  st.cycles = curr_cycle;
+  st.fetched_insns = machine_state.fetched_insns;
+  st.branches_and_jumps = machine_state.n_branches + machine_state.n_jumps;
+  st.mispredicts = machine_state.mispredicted_branches + machine_state.mispredicted_jumps;
+  st.nukes = machine_state.nukes;
+  if(l1d) {
+    st.l1d_hits = l1d->getHits();
+    st.l1d_misses = l1d->getMisses();
+  }
+  return st;
+}
@@ -0,0 +1,79 @@
+#ifndef __sim_instance_hh__
+#define __sim_instance_hh__
+
+#include <cstdint>
+#include <string>
+#include <ostream>
+#include <vector>
+
+#include "machine_state.hh"
+
+class simCache;
+class dram_controller;
+class sparse_mem;
+struct state_t;
+
+/* One simulation with everything it needs: machine state, guest
+ * memories, caches and its run-wide settings. sim_param and the
+ * per-run globals are thread_local ; every call installs this
+ * instance's values on the calling thread, so independent instances
+ * can run concurrently on different host threads. An instance must
+ * not be used from two threads at once. Construction only reads the
+ * program and shares its pages copy-on-write, so many instances can
+ * be built from one program concurrently while nothing runs it. */
+class sim_instance {
+public:
+  struct stats {
+    uint64_t insns = 0;
+    uint64_t cycles = 0;
+    uint64_t fetched_insns = 0;
+    uint64_t branches_and_jumps = 0;
+    uint64_t mispredicts = 0;
+    uint64_t nukes = 0;
+    uint64_t l1d_hits = 0;
+    uint64_t l1d_misses = 0;
+    double ipc() const {
+      return cycles ? static_cast<double>(insns) / cycles : 0.0;
+    }
+  };
+private:
+  /* sim_param values, in SIM_PARAM_LIST order */
+  std::vector<int> params;
+  bool use_l2 = true, use_l3 = true, use_mem_model = true;
+  std::ostream *log = nullptr;
+  uint64_t curr_cycle = 0;
+  uint64_t start_icnt = 0;
+  bool initialized = false;
+  bool finished = false;
+
+  sim_state machine_state;
+  sparse_mem *sm = nullptr;
+  state_t *s = nullptr;
+  simCache *l1d = nullptr, *l1i = nullptr, *l2d = nullptr, *l3d = nullptr;
+  dram_controller *dram = nullptr;
+
+  void enter();
+  void leave();
+  void initialize();
+public:
+  /* copies the architectural state and memory image of program */
+  sim_instance(const state_t &program);
+  ~sim_instance();
+  sim_instance(const sim_instance &) = delete;
+  sim_instance &operator=(const sim_instance &) = delete;
+  /* parameters can only change before the first run */
+  bool set_param(const std::string &name, int value);
+  bool get_param(const std::string &name, int &value) const;
+  void set_caches(bool use_mem_model, bool use_l2, bool use_l3);
+  /* the gthread engine runs a program to the end in one go and cannot
+   * stop after n instructions, so instances always use the static
+   * cycle loop ; asking for gthreads fails */
+  bool set_gthreads(bool use_gthreads);
+  void set_log(std::ostream *out);
+  /* simulate up to n more instructions, returns the number retired */
+  uint64_t run(uint64_t n);
+  bool done() const;
+  stats get_stats() const;
+};
+
+#endif
@@ -4,6 +4,7 @@
 #define SIM_PARAM_LIST				\
   SIM_PARAM(heartbeat,(1<<20),1,true)		\
   SIM_PARAM(flash_restart,1,0,true)		\
+  SIM_PARAM(skip_idle_cycles,1,0,false)		\
   SIM_PARAM(rob_size,64,1,true)			\
   SIM_PARAM(fetchq_size,8,1,true)			\
   SIM_PARAM(decodeq_size,8,1,true)			\
@@ -38,6 +39,10 @@
   SIM_PARAM(bhr_length,32,1,true)					\
   SIM_PARAM(bht_length,8,1,true)					\
   SIM_PARAM(num_bht_entries,16,1,true)					\
+  SIM_PARAM(l1i_latency,2,1,false)					\
+  SIM_PARAM(l1i_assoc,8,1,true)						\
+  SIM_PARAM(l1i_sets,64,1,true)						\
+  SIM_PARAM(l1i_linesize,64,64,true)					\
   SIM_PARAM(l1d_latency,3,1,false)					\
   SIM_PARAM(l1d_assoc,8,1,true)						\
   SIM_PARAM(l1d_sets,64,1,true)						\
@@ -51,16 +56,58 @@
   SIM_PARAM(l3d_sets,4096,1,true)					\
   SIM_PARAM(l3d_linesize,64,64,true)					\
   SIM_PARAM(mem_latency,100,1,false)					\
+  SIM_PARAM(use_dram,0,0,false)						\
+  SIM_PARAM(dram_channels,1,1,true)					\
+  SIM_PARAM(dram_ranks,2,1,true)					\
+  SIM_PARAM(dram_banks,8,1,true)					\
+  SIM_PARAM(dram_row_bytes,8192,64,true)				\
+  SIM_PARAM(dram_queue_entries,32,1,false)				\
+  SIM_PARAM(dram_ctrl_latency,20,0,false)				\
+  SIM_PARAM(dram_tcas,28,1,false)					\
+  SIM_PARAM(dram_trcd,28,1,false)					\
+  SIM_PARAM(dram_trp,28,1,false)					\
+  SIM_PARAM(dram_tras,68,0,false)					\
+  SIM_PARAM(dram_tburst,8,1,false)					\
+  SIM_PARAM(model_tlbs,0,0,false)					\
+  SIM_PARAM(lg_page_size,12,12,false)					\
+  SIM_PARAM(itlb_entries,64,1,true)					\
+  SIM_PARAM(itlb_ways,4,1,true)						\
+  SIM_PARAM(dtlb_entries,64,1,true)					\
+  SIM_PARAM(dtlb_ways,4,1,true)						\
+  SIM_PARAM(stlb_entries,1024,1,true)					\
+  SIM_PARAM(stlb_ways,8,1,true)						\
+  SIM_PARAM(stlb_latency,7,0,false)					\
   SIM_PARAM(ready_to_dispatch_latency,0,0,false)			\
-  SIM_PARAM(l1d_misses_inflight,1,1,false)				\
+  SIM_PARAM(l1d_misses_inflight,8,0,false)				\
+  SIM_PARAM(l2d_misses_inflight,16,0,false)				\
+  SIM_PARAM(l3d_misses_inflight,32,0,false)				\
+  SIM_PARAM(l1i_prefetcher,0,0,false)					\
+  SIM_PARAM(l1d_prefetcher,0,0,false)					\
+  SIM_PARAM(l2d_prefetcher,0,0,false)					\
+  SIM_PARAM(l3d_prefetcher,0,0,false)					\
+  SIM_PARAM(prefetch_degree,2,1,false)					\
+  SIM_PARAM(pf_stride_entries,256,1,true)				\
+  SIM_PARAM(pf_streams,16,1,false)					\
   SIM_PARAM(branch_predictor,6,0,false)					\
   SIM_PARAM(num_tage_tbls,4,1,false)					\
   SIM_PARAM(lg_tage_bimode_tbl_entries,12,1,false)			\
-  SIM_PARAM(lg_tage_tagged_tbl_entries,10,1,false)
+  SIM_PARAM(lg_tage_tagged_tbl_entries,10,1,false)			\
+  SIM_PARAM(lg_decode_cache_entries,12,0,false)			\
+  SIM_PARAM(btb_entries,4096,1,true)					\
+  SIM_PARAM(btb_ways,4,1,true)						\
+  SIM_PARAM(btb_tag_bits,0,0,false)					\
+  SIM_PARAM(btb_replacement,0,0,false)					\
+  SIM_PARAM(btb_miss_penalty,2,0,false)					\
+  SIM_PARAM(ssit_entries,1024,1,true)					\
+  SIM_PARAM(lfst_entries,128,1,true)					\
+  SIM_PARAM(store_set_clear_interval,1000000,0,false)			\
+  SIM_PARAM(lsq_cam_buckets,64,1,true)					\
+  SIM_PARAM(stlf_latency,3,1,false)					\
+  SIM_PARAM(stlf_per_cycle,2,0,false)
 
 
 namespace sim_param {
-#define SIM_PARAM(A,B,C,D) extern int A;
+#define SIM_PARAM(A,B,C,D) extern thread_local int A;
   SIM_PARAM_LIST;
 #undef SIM_PARAM
 }
@@ -0,0 +1,61 @@
+#include <cstdint>
+#include <vector>
+
+#ifndef __sim_pool_hh__
+#define __sim_pool_hh__
+
+/* bounded free list of heap objects ; put() refuses past the
+ * limit so the caller deletes, get() returns nullptr when empty */
+template <typename T>
+class sim_pool {
+protected:
+  size_t limit;
+  std::vector<T*> free_list;
+public:
+  sim_pool(size_t limit = 0) : limit(limit) {
+    free_list.reserve(limit);
+  }
+  ~sim_pool() {
+    clear();
+  }
+  void set_limit(size_t limit) {
+    this->limit = limit;
+    while(free_list.size() > limit) {
+      delete free_list.back();
+      free_list.pop_back();
+    }
+    free_list.reserve(limit);
+  }
+  void clear() {
+    for(T *p : free_list) {
+      delete p;
+    }
+    free_list.clear();
+  }
+  /* allocate up front so the steady state never hits the heap */
+  void fill() {
+    while(free_list.size() < limit) {
+      free_list.push_back(new T());
+    }
+  }
+  T *get() {
+    if(free_list.empty()) {
+      return nullptr;
+    }
+    T *p = free_list.back();
+    free_list.pop_back();
+    return p;
+  }
+  bool put(T *p) {
+    if(free_list.size() >= limit) {
+      return false;
+    }
+    free_list.push_back(p);
+    return true;
+  }
+  size_t size() const {
+    return free_list.size();
+  }
+};
+
+#endif
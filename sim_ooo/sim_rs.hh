@@ -0,0 +1,105 @@
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+
+#ifndef __sim_rs_hh__
+#define __sim_rs_hh__
+
+/* register file of a wakeup tag */
+enum class reg_file : int8_t {none, gpr, cpr0, cpr1, fcr1};
+
+/* reservation station ; every allocated entry holds a slot, but only
+ * entries not parked on a wakeup tag sit in the awake list, which is
+ * kept oldest first by alloc_id for select */
+template <typename T>
+class sim_rs {
+private:
+  size_t num_entries, cnt;
+  std::vector<T> awake;
+  /* broadcast since the last merge_woken() */
+  std::vector<T> woken;
+  static bool older(const T &a, const T &b) {
+    return a->alloc_id < b->alloc_id;
+  }
+public:
+  typedef typename std::vector<T>::iterator iterator;
+  typedef typename std::vector<T>::const_iterator const_iterator;
+  sim_rs(size_t num_entries=16) : num_entries(num_entries), cnt(0) {
+    awake.reserve(num_entries);
+    woken.reserve(num_entries);
+  }
+  void resize(size_t num_entries) {
+    this->num_entries = num_entries;
+    clear();
+    awake.reserve(num_entries);
+    woken.reserve(num_entries);
+  }
+  void clear() {
+    cnt = 0;
+    awake.clear();
+    woken.clear();
+  }
+  bool full() const {
+    return cnt==num_entries;
+  }
+  bool empty() const {
+    return cnt==0;
+  }
+  size_t size() const {
+    return cnt;
+  }
+  bool has_woken() const {
+    return not(woken.empty());
+  }
+  void push(T v) {
+    assert(v != nullptr);
+    assert(cnt < num_entries);
+    assert(awake.empty() or older(awake.back(), v));
+    awake.push_back(v);
+    cnt++;
+  }
+  /* oldest awake entry */
+  T peek() const {
+    assert(not(awake.empty()));
+    return awake.front();
+  }
+  T pop() {
+    T v = peek();
+    awake.erase(awake.begin());
+    cnt--;
+    return v;
+  }
+  /* dispatched, frees the slot */
+  iterator erase(iterator it) {
+    cnt--;
+    return awake.erase(it);
+  }
+  /* waiting on a tag, keeps the slot */
+  iterator park(iterator it) {
+    return awake.erase(it);
+  }
+  void wake(T v) {
+    woken.push_back(v);
+  }
+  void merge_woken() {
+    for(T v : woken) {
+      awake.insert(std::upper_bound(awake.begin(), awake.end(), v, older), v);
+    }
+    woken.clear();
+  }
+  iterator begin() {
+    return awake.begin();
+  }
+  iterator end() {
+    return awake.end();
+  }
+  const_iterator begin() const {
+    return awake.begin();
+  }
+  const_iterator end() const {
+    return awake.end();
+  }
+};
+
+#endif
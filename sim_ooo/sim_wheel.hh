@@ -0,0 +1,111 @@
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <vector>
+#include <utility>
+
+#ifndef __sim_wheel_hh__
+#define __sim_wheel_hh__
+
+/* timing wheel : an event sits in the bucket for its cycle and each
+ * cycle drains one bucket, like wr_ports[max_op_lat]. events further
+ * out than the wheel wait in a far list until they come in range */
+template <typename T>
+class sim_wheel {
+private:
+  typedef std::pair<uint64_t, T> event;
+  uint64_t mask;
+  size_t cnt;
+  std::vector<std::vector<event>> buckets;
+  std::vector<event> far;
+  /* events already past come in too : their bucket drops them as
+   * stale, as it does for any skipped drain */
+  void pull_far(uint64_t now) {
+    for(size_t i = 0; i < far.size(); /*nil*/) {
+      if(far[i].first <= (now + mask)) {
+	buckets[far[i].first & mask].push_back(far[i]);
+	far[i] = far.back();
+	far.pop_back();
+      }
+      else {
+	i++;
+      }
+    }
+  }
+public:
+  sim_wheel(size_t len = 256) {
+    resize(len);
+  }
+  void resize(size_t len) {
+    assert(((len-1)&len)==0);
+    mask = len-1;
+    cnt = 0;
+    buckets.clear();
+    buckets.resize(len);
+    far.clear();
+  }
+  void clear() {
+    for(auto &b : buckets) {
+      b.clear();
+    }
+    far.clear();
+    cnt = 0;
+  }
+  size_t size() const {
+    return cnt;
+  }
+  bool empty() const {
+    return cnt == 0;
+  }
+  void schedule(uint64_t now, uint64_t cycle, T v) {
+    assert(cycle >= now);
+    if((cycle - now) <= mask) {
+      buckets[cycle & mask].push_back(event(cycle, v));
+    }
+    else {
+      far.push_back(event(cycle, v));
+    }
+    cnt++;
+  }
+  /* call f on every event for cycle now ; f may schedule more,
+   * including for now. stale events from skipped drains are dropped */
+  template <typename F>
+  void drain(uint64_t now, F f) {
+    if(not(far.empty())) {
+      pull_far(now);
+    }
+    std::vector<event> &b = buckets[now & mask];
+    for(size_t i = 0; i < b.size(); i++) {
+      if(b[i].first == now) {
+	f(b[i].second);
+      }
+    }
+    cnt -= b.size();
+    b.clear();
+  }
+  /* earliest pending cycle at or after now, -1 if idle */
+  int64_t next_event(uint64_t now) const {
+    if(cnt == 0) {
+      return -1;
+    }
+    int64_t c = -1;
+    for(const event &e : far) {
+      if((e.first >= now) and ((c == -1) or (e.first < static_cast<uint64_t>(c)))) {
+	c = e.first;
+      }
+    }
+    for(uint64_t i = 0; i <= mask; i++) {
+      if((c != -1) and ((now+i) >= static_cast<uint64_t>(c))) {
+	break;
+      }
+      for(const event &e : buckets[(now+i) & mask]) {
+	if(e.first == (now+i)) {
+	  return now+i;
+	}
+      }
+    }
+    return c;
+  }
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+
+#include "simpoint.hh"
+#include "interpret.hh"
+#include "helper.hh"
+#include "globals.hh"
+
+void profile_bbv(state_t *s, const std::string &fname,
+		 uint64_t interval, uint64_t maxicnt) {
+  std::ofstream out(fname);
+  if(not(out.is_open())) {
+    std::cerr << "unable to open " << fname << "\n";
+    return;
+  }
+  /* block start pc -> dimension (SimPoint wants ids from 1) */
+  std::unordered_map<uint32_t, uint32_t> block_ids;
+  /* per-interval instruction counts, indexed by id */
+  std::vector<uint64_t> counts(1, 0);
+  std::vector<uint32_t> touched;
+  uint32_t block_pc = s->pc;
+  uint64_t block_icnt = s->icnt;
+  uint64_t next_dump = s->icnt + interval;
+  const uint64_t start_icnt = s->icnt;
+  uint64_t n_intervals = 0;
+  s->track_history = true;
+
+  auto dump = [&]() {
+    out << "T";
+    std::sort(touched.begin(), touched.end());
+    for(uint32_t id : touched) {
+      out << ":" << id << ":" << counts[id] << " ";
+      counts[id] = 0;
+    }
+    out << "\n";
+    touched.clear();
+    n_intervals++;
+  };
+  
+  double now = timestamp();
+  while(not(s->brk) and (s->icnt < maxicnt)) {
+    const uint64_t idx = s->icnt % HWINDOW;
+    execMips(s);
+    /* a block ends at any control transfer ; execMips runs the
+     * delay slot along with the branch */
+    if(not(s->hbuf[idx].was_branch_or_jump)) {
+      continue;
+    }
+    auto it = block_ids.find(block_pc);
+    uint32_t id;
+    if(it == block_ids.end()) {
+      id = counts.size();
+      block_ids[block_pc] = id;
+      counts.push_back(0);
+    }
+    else {
+      id = it->second;
+    }
+    if(counts[id] == 0) {
+      touched.push_back(id);
+    }
+    counts[id] += s->icnt - block_icnt;
+    block_pc = s->pc;
+    block_icnt = s->icnt;
+    if(s->icnt >= next_dump) {
+      dump();
+      next_dump += interval;
+    }
+  }
+  if(not(touched.empty())) {
+    dump();
+  }
+  now = timestamp() - now;
+  *global::sim_log << n_intervals << " intervals of " << interval
+		   << " insns, " << block_ids.size()
+		   << " basic blocks written to " << fname << "\n";
+  *global::sim_log << ((s->icnt - start_icnt) / now) << " profiled instructions per second\n";
+}
+
+bool read_simpoints(const std::string &simpoints_fname,
+		    const std::string &weights_fname,
+		    std::vector<simpoint> &simpoints) {
+  std::ifstream sp_in(simpoints_fname), w_in(weights_fname);
+  if(not(sp_in.is_open()) or not(w_in.is_open())) {
+    std::cerr << "unable to open simpoint files\n";
+    return false;
+  }
+  /* both files are "<value> <cluster id>" per line */
+  std::map<uint64_t, uint64_t> cluster_interval;
+  std::map<uint64_t, double> cluster_weight;
+  uint64_t interval, cluster;
+  double weight;
+  while(sp_in >> interval >> cluster) {
+    cluster_interval[cluster] = interval;
+  }
+  while(w_in >> weight >> cluster) {
+    cluster_weight[cluster] = weight;
+  }
+  simpoints.clear();
+  for(auto &p : cluster_interval) {
+    auto it = cluster_weight.find(p.first);
+    if(it == cluster_weight.end()) {
+      std::cerr << "no weight for cluster " << p.first << "\n";
+      return false;
+    }
+    simpoints.push_back(simpoint{p.second, it->second});
+  }
+  std::sort(simpoints.begin(), simpoints.end(),
+	    [](const simpoint &a, const simpoint &b) {
+	      return a.interval < b.interval;
+	    });
+  return not(simpoints.empty());
+}
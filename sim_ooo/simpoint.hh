@@ -0,0 +1,25 @@
+#ifndef __simpoint_hh__
+#define __simpoint_hh__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct state_t;
+
+struct simpoint {
+  uint64_t interval;
+  double weight;
+};
+
+/* run the interpreter to completion (or maxicnt), writing one
+ * basic-block vector per interval instructions in SimPoint .bb format */
+void profile_bbv(state_t *s, const std::string &fname,
+		 uint64_t interval, uint64_t maxicnt);
+
+/* parse SimPoint .simpoints and .weights files, sorted by interval */
+bool read_simpoints(const std::string &simpoints_fname,
+		    const std::string &weights_fname,
+		    std::vector<simpoint> &simpoints);
+
+#endif
@@ -7,24 +7,130 @@
 
 sparse_mem::sparse_mem(uint64_t nbytes) {
   npages = (nbytes+pgsize-1) / pgsize;
+  nleaves = (npages+leaf_len-1) / leaf_len;
   present_bitvec.clear_and_resize(npages);
-  mem = new uint8_t*[npages];
-  memset(mem, 0, sizeof(uint8_t*)*npages);
+  dirty_bitvec.clear_and_resize(npages);
+  tbl = new leaf*[nleaves];
+  memset(tbl, 0, sizeof(leaf*)*nleaves);
 }
 
+/* O(present pages) : pages are shared until one side writes */
 sparse_mem::sparse_mem(const sparse_mem &other) {
+  share_pages(other);
+}
+
+void sparse_mem::share_pages(const sparse_mem &other) {
   npages = other.npages;
+  nleaves = other.nleaves;
   present_bitvec.clear_and_resize(npages);
-  mem = new uint8_t*[npages];
-  memset(mem, 0, sizeof(uint8_t*)*npages);
-  for(size_t i = 0; i < npages; i++) {
-    if(other.mem[i]) {
-      present_bitvec.set_bit(i);
-      int rc = posix_memalign(reinterpret_cast<void**>(&mem[i]), 4096, pgsize);
-      assert(rc==0);
-      memcpy(mem[i], other.mem[i], pgsize);
+  dirty_bitvec.clear_and_resize(npages);
+  tbl = new leaf*[nleaves];
+  memset(tbl, 0, sizeof(leaf*)*nleaves);
+  for(size_t l = 0; l < nleaves; l++) {
+    leaf *o = other.tbl[l];
+    if(o == nullptr) {
+      continue;
+    }
+    leaf *n = new leaf();
+    for(size_t i = 0; i < leaf_len; i++) {
+      if(o->pg[i] == nullptr) {
+	continue;
+      }
+      o->pg[i]->refs.fetch_add(1, std::memory_order_relaxed);
+      n->pg[i] = o->pg[i];
+      n->data[i] = o->data[i];
+      present_bitvec.set_bit(l*leaf_len + i);
+    }
+    /* refs > 1 keeps both sides from writing in place */
+    tbl[l] = n;
+  }
+}
+
+void sparse_mem::release_pages() {
+  for(size_t l = 0; l < nleaves; l++) {
+    leaf *t = tbl[l];
+    if(t == nullptr) {
+      continue;
+    }
+    for(size_t i = 0; i < leaf_len; i++) {
+      page *p = t->pg[i];
+      if(p and (p->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)) {
+	free(p->data);
+	delete p;
+      }
+    }
+    delete t;
+  }
+  delete [] tbl;
+  tbl = nullptr;
+}
+
+sparse_mem::~sparse_mem() {
+  release_pages();
+}
+
+sparse_mem::leaf *sparse_mem::get_leaf(uint64_t p) {
+  assert(p < npages);
+  leaf *&l = tbl[p >> lg_leaf_len];
+  if(l == nullptr) {
+    l = new leaf();
+  }
+  return l;
+}
+
+uint8_t *sparse_mem::alloc_page(uint64_t p) {
+  leaf *l = get_leaf(p);
+  uint64_t i = p & (leaf_len-1);
+  assert(l->pg[i] == nullptr);
+  page *n = new page;
+  int rc = posix_memalign(reinterpret_cast<void**>(&n->data), 4096, pgsize);
+  assert(rc==0);
+  memset(n->data, 0, pgsize);
+  n->refs.store(1, std::memory_order_relaxed);
+  l->pg[i] = n;
+  l->data[i] = n->data;
+  present_bitvec.set_bit(p);
+  return n->data;
+}
+
+uint8_t *sparse_mem::unshare_page(uint64_t p) {
+  leaf *l = get_leaf(p);
+  uint64_t i = p & (leaf_len-1);
+  page *o = l->pg[i];
+  if(o == nullptr) {
+    return alloc_page(p);
+  }
+  /* other holders already dropped it */
+  if(o->refs.load(std::memory_order_acquire) != 1) {
+    page *n = new page;
+    int rc = posix_memalign(reinterpret_cast<void**>(&n->data), 4096, pgsize);
+    assert(rc==0);
+    memcpy(n->data, o->data, pgsize);
+    n->refs.store(1, std::memory_order_relaxed);
+    if(o->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      free(o->data);
+      delete o;
+    }
+    l->pg[i] = n;
+    l->data[i] = n->data;
+  }
+  return l->data[i];
+}
+
+uint64_t sparse_mem::shared_count() const {
+  uint64_t c = 0;
+  for(size_t l = 0; l < nleaves; l++) {
+    const leaf *t = tbl[l];
+    if(t == nullptr) {
+      continue;
+    }
+    for(size_t i = 0; i < leaf_len; i++) {
+      if(t->pg[i] and (t->pg[i]->refs.load(std::memory_order_relaxed) > 1)) {
+	c++;
+      }
     }
   }
+  return c;
 }
 
 uint32_t sparse_mem::crc32() const {
@@ -39,18 +145,20 @@ uint32_t sparse_mem::crc32() const {
       }
     }
     else {
+      const uint8_t *d = page_ptr(i);
       //uint8_t x = 0;
       for(size_t n=0;n<4096;n++) {
-	c = _mm_crc32_u8(c, mem[i][n]);
-	//x ^= mem[i][n];
+	c = _mm_crc32_u8(c, d[n]);
+	//x ^= d[n];
       }
       //std::cout << "page " << i << " is non-zero, x = "
       //<< std::hex << static_cast<uint32_t>(x) << std::dec << "\n";
     }
 #else
     static const uint32_t POLY = 0x82f63b78;
+    const uint8_t *d = page_ptr(i);
     for(size_t n=0;n<4096;n++) {
-      uint8_t b = present_bitvec[i] ? mem[i][n] : 0;
+      uint8_t b = d ? d[n] : 0;
       c ^= b;
       for(int k = 0; k < 8; k++) {
 	c = c & 1 ? (c>>1) ^ POLY : c>>1;
@@ -62,36 +170,11 @@ uint32_t sparse_mem::crc32() const {
 }
 
 void sparse_mem::copy(const sparse_mem &other) {
-  for(size_t i = 0; i < npages; i++) {
-    if(mem[i]) {
-      free(mem[i]);
-    }
-  }
-  delete [] mem;
-  present_bitvec.clear();
-  
-  npages = other.npages;
-  present_bitvec.clear_and_resize(npages);
-  mem = new uint8_t*[npages];
-  memset(mem, 0, sizeof(uint8_t*)*npages);
-  for(size_t i = 0; i < npages; i++) {
-    if(other.mem[i]) {
-      present_bitvec.set_bit(i);
-      int rc = posix_memalign(reinterpret_cast<void**>(&mem[i]), 4096, pgsize);
-      assert(rc==0);
-      memcpy(mem[i], other.mem[i], pgsize);
-    }
-  }
-}
-
-
-sparse_mem::~sparse_mem() {
-  for(size_t i = 0; i < npages; i++) {
-    if(mem[i]) {
-      free(mem[i]);
-    }
+  if(&other == this) {
+    return;
   }
-  delete [] mem;
+  release_pages();
+  share_pages(other);
 }
 
 static int sparse_mem_handler(void *fault_addr, int serious) {
@@ -107,7 +190,8 @@ static int sparse_mem_handler(void *fault_addr, int serious) {
 void sparse_mem::mark_pages_as_no_write() {
   int64_t p = present_bitvec.find_first_set();
   while(p != -1) {
-    int rc = mprotect(mem[p], pgsize,  PROT_READ);
+    /* protection is per host page, so stop sharing first */
+    int rc = mprotect(unshare_page(p), pgsize,  PROT_READ);
     assert(rc == 0);
     p = present_bitvec.find_next_set(p);
   }
@@ -123,20 +207,22 @@ bool sparse_mem::equal(const sparse_mem &other) const {
   int64_t p1 = present_bitvec.find_first_set();
   
   while(p0!=-1 and p1 !=-1) {
-    assert(other.mem[p0]);
-    assert(mem[p1]);
+    const uint8_t *d0 = other.page_ptr(p0);
+    const uint8_t *d1 = page_ptr(p1);
+    assert(d0);
+    assert(d1);
     //std::cerr << "p0 = " << p0 << ",p1 = " << p1 << "\n";
     
     if(p0==p1) {
-      int d = memcmp(mem[p1], other.mem[p0], pgsize);
+      int d = memcmp(d1, d0, pgsize);
       if(d != 0) {
 	std::cout << "page " << p1 << " mismatch!\n";
 	for(int i = 0; i < pgsize; i++) {
-	  if(other.mem[p0][i] != mem[p1][i]) {
+	  if(d0[i] != d1[i]) {
 	    std::cout << "byte " << i << " differs : "
 		      << std::hex
-		      << static_cast<uint32_t>(other.mem[p0][i]) << ","
-	      << static_cast<uint32_t>(mem[p1][i])
+		      << static_cast<uint32_t>(d0[i]) << ","
+	      << static_cast<uint32_t>(d1[i])
 		      << std::dec << "\n";
 	  }
 	}
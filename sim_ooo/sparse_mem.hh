@@ -5,6 +5,7 @@
 #include <cassert>
 #include <cstring>
 #include <cstdint>
+#include <atomic>
 #include <iostream>
 #include <unistd.h>
  #include <sys/mman.h>
@@ -16,17 +17,68 @@
 class sparse_mem {
 public:
   static const uint64_t pgsize = 4096;
+  /* two-level page table : 1024 leaves of 1024 pages for 4GB */
+  static const uint64_t lg_leaf_len = 10;
+  static const uint64_t leaf_len = 1UL << lg_leaf_len;
 private:
+  /* a page may be shared copy-on-write between instances ;
+   * instances live on different host threads, so refs is atomic.
+   * a holder may write in place only while refs is 1 */
+  struct page {
+    std::atomic<uint32_t> refs;
+    uint8_t *data;
+  };
+  /* data[] mirrors pg[]->data to keep reads at two loads */
+  struct leaf {
+    uint8_t *data[leaf_len];
+    page *pg[leaf_len];
+  };
   size_t npages = 0;
-  uint8_t **mem = nullptr;
+  size_t nleaves = 0;
+  leaf **tbl = nullptr;
   sim_bitvec_template<uint64_t> present_bitvec;
+  /* pages handed out for writing since the last clear_dirty() ;
+   * conservative, syscall emulation reads through raw pointers */
+  sim_bitvec_template<uint64_t> dirty_bitvec;
+  uint8_t *page_ptr(uint64_t p) const {
+    const leaf *l = tbl[p >> lg_leaf_len];
+    return l ? l->data[p & (leaf_len-1)] : nullptr;
+  }
   bool is_zero(uint64_t p) const {
+    const uint8_t *d = page_ptr(p);
     for(uint64_t i = 0; i < pgsize; i++) {
-      if(mem[p][i])
+      if(d[i])
 	return false;
     }
     return true;
   }
+  leaf *get_leaf(uint64_t p);
+  uint8_t *alloc_page(uint64_t p);
+  uint8_t *unshare_page(uint64_t p);
+  /* only reads other : copies of one source may be made
+   * concurrently, as long as nothing writes the source meanwhile */
+  void share_pages(const sparse_mem &other);
+  /* acquire pairs with the release in a co-holder's drop, so its
+   * last reads of the page come before our writes */
+  static bool sole_holder(const leaf *l, uint64_t i) {
+    const page *p = l->pg[i];
+    return p and (p->refs.load(std::memory_order_acquire) == 1);
+  }
+  void release_pages();
+  /* loads never copy a shared page */
+  uint8_t *rd_page(uint64_t p) {
+    uint8_t *d = page_ptr(p);
+    return d ? d : alloc_page(p);
+  }
+  uint8_t *wr_page(uint64_t p) {
+    dirty_bitvec.set_bit(p);
+    leaf *l = tbl[p >> lg_leaf_len];
+    uint64_t i = p & (leaf_len-1);
+    if(l and sole_holder(l, i)) {
+      return l->data[i];
+    }
+    return unshare_page(p);
+  }
 public:
   sparse_mem(uint64_t nbytes = 1UL<<32);
   sparse_mem(const sparse_mem &other);
@@ -36,6 +88,21 @@ public:
   int64_t get_next_page(int64_t idx) const {
     return present_bitvec.find_next_set(idx);
   }
+  size_t num_pages() const {
+    return npages;
+  }
+  int64_t first_dirty_page() const {
+    return dirty_bitvec.find_first_set();
+  }
+  int64_t get_next_dirty_page(int64_t idx) const {
+    return dirty_bitvec.find_next_set(idx);
+  }
+  void clear_dirty() {
+    dirty_bitvec.clear();
+  }
+  bool is_zero_page(uint64_t p) const {
+    return (page_ptr(p) == nullptr) or is_zero(p);
+  }
   void copy(const sparse_mem &other);
   ~sparse_mem();
   void mark_pages_as_no_write();
@@ -43,64 +110,55 @@ public:
   bool get_pb_addr(uint32_t addr, uint32_t &paddr, uint32_t &baddr) {
     paddr = addr / pgsize;
     baddr = addr % pgsize;
-    return(mem[paddr]!=nullptr);
+    return(page_ptr(paddr)!=nullptr);
   }
   uint32_t parity(uint32_t addr) const {
     uint32_t paddr = addr / pgsize;
-    if(mem[paddr] == nullptr)
+    const uint8_t *d = page_ptr(paddr);
+    if(d == nullptr)
       return 0;
     uint8_t p = 0;
     for(int i = 0; i < pgsize; i++) {
-      p ^= mem[paddr][i];
+      p ^= d[i];
     }
     return static_cast<uint32_t>(p);
   }
   bool equal(const sparse_mem &other) const;
+  /* read-only view, may be shared with other instances */
   uint8_t* get_page(uint32_t pg) const {
-    return mem[pg];
+    return page_ptr(pg);
+  }
+  /* pages shared with another instance */
+  uint64_t shared_count() const;
+  /* for software tlbs : non-null only while this instance holds
+   * the sole reference, so the pointer stays valid until pages
+   * are next shared */
+  uint8_t *owned_page(uint32_t pg) const {
+    const leaf *l = tbl[pg >> lg_leaf_len];
+    uint64_t i = pg & (leaf_len-1);
+    if(l and sole_holder(l, i)) {
+      return l->data[i];
+    }
+    return nullptr;
   }
   uint8_t & at(uint32_t addr) {
     uint32_t paddr = addr / pgsize;
     uint32_t baddr = addr % pgsize;
-    if(mem[paddr]==nullptr) {
-      present_bitvec.set_bit(paddr);
-      int rc = posix_memalign(reinterpret_cast<void**>(&mem[paddr]), 4096, pgsize);
-      assert(rc==0);
-      memset(mem[paddr],0,pgsize);
-    }
-    return mem[paddr][baddr];
+    return wr_page(paddr)[baddr];
   }
   uint8_t * operator[](uint32_t addr) {
     uint32_t paddr = addr / pgsize;
     uint32_t baddr = addr % pgsize;
-    if(mem[paddr]==nullptr) {
-      present_bitvec.set_bit(paddr);
-      int rc = posix_memalign(reinterpret_cast<void**>(&mem[paddr]), 4096, pgsize);
-      assert(rc==0);
-      memset(mem[paddr],0,pgsize);
-    }
-    return &mem[paddr][baddr];
+    return wr_page(paddr) + baddr;
   }
   void prefault(uint32_t addr) {
-    uint32_t paddr = addr / pgsize;
-    if(mem[paddr]==nullptr) {
-      present_bitvec.set_bit(paddr);
-      int rc = posix_memalign(reinterpret_cast<void**>(&mem[paddr]), 4096, pgsize);
-      assert(rc==0);
-      memset(mem[paddr],0,pgsize);
-    }
+    wr_page(addr / pgsize);
   }
   template <typename T>
   T get(uint32_t byte_addr) {
     uint32_t paddr = byte_addr / pgsize;
     uint32_t baddr = byte_addr % pgsize;
-    if(mem[paddr]==nullptr) {
-      present_bitvec.set_bit(paddr);
-      int rc = posix_memalign(reinterpret_cast<void**>(&mem[paddr]), 4096, pgsize);
-      assert(rc==0);
-      memset(mem[paddr],0,pgsize);
-    }
-    return *reinterpret_cast<T*>(mem[paddr]+baddr);
+    return *reinterpret_cast<T*>(rd_page(paddr)+baddr);
   }
   template <typename T>
   T load(uint32_t byte_addr) {
@@ -110,13 +168,7 @@ public:
   void set(uint32_t byte_addr, T v) {
     uint32_t paddr = byte_addr / pgsize;
     uint32_t baddr = byte_addr % pgsize;
-    if(mem[paddr]==nullptr) {
-      present_bitvec.set_bit(paddr);
-      int rc = posix_memalign(reinterpret_cast<void**>(&mem[paddr]), 4096, pgsize);
-      assert(rc==0);
-      memset(mem[paddr],0,pgsize);
-    }
-    *reinterpret_cast<T*>(mem[paddr]+baddr) = v;
+    *reinterpret_cast<T*>(wr_page(paddr)+baddr) = v;
   }
   template<typename T>
   void store(uint32_t byte_addr, T v) {
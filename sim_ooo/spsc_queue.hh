@@ -0,0 +1,68 @@
+#ifndef __spsc_queue__
+#define __spsc_queue__
+
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+
+/* bounded single-producer / single-consumer ring ;
+ * one host thread pushes, one host thread pops */
+template <typename T>
+class spsc_queue {
+private:
+  static const int cacheline = 64;
+  uint64_t len = 0;
+  T *data = nullptr;
+  /* keep producer and consumer indices on separate lines */
+  uint8_t pad0[cacheline];
+  std::atomic<uint64_t> read_idx;
+  uint8_t pad1[cacheline];
+  std::atomic<uint64_t> write_idx;
+  uint8_t pad2[cacheline];
+public:
+  spsc_queue(uint64_t len) : len(len), read_idx(0), write_idx(0) {
+    bool pow2 = ((len-1)&len)==0;
+    assert(pow2);
+    data = new T[len];
+  }
+  ~spsc_queue() {
+    delete [] data;
+  }
+  /* producer side */
+  bool push(const T &v) {
+    const uint64_t w = write_idx.load(std::memory_order_relaxed);
+    if((w - read_idx.load(std::memory_order_acquire)) == len) {
+      return false;
+    }
+    data[w & (len-1)] = v;
+    write_idx.store(w+1, std::memory_order_release);
+    return true;
+  }
+  /* consumer side */
+  bool pop(T &v) {
+    const uint64_t r = read_idx.load(std::memory_order_relaxed);
+    if(r == write_idx.load(std::memory_order_acquire)) {
+      return false;
+    }
+    v = data[r & (len-1)];
+    read_idx.store(r+1, std::memory_order_release);
+    return true;
+  }
+  /* front element without popping it, nullptr when empty */
+  const T *peek() const {
+    const uint64_t r = read_idx.load(std::memory_order_relaxed);
+    if(r == write_idx.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &data[r & (len-1)];
+  }
+  bool empty() const {
+    return read_idx.load(std::memory_order_acquire) ==
+      write_idx.load(std::memory_order_acquire);
+  }
+  size_t capacity() const {
+    return len;
+  }
+};
+
+#endif
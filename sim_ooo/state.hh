@@ -36,6 +36,8 @@ struct state_t {
   uint32_t fcr1[5];
   int num_open_fd = 0;
   bool silent = false;
+  /* fill hbuf ; only the oracle and bbv profiling read it */
+  bool track_history = false;
   simCache *l1d = nullptr;
   history_t hbuf[HWINDOW];
   state_t(sparse_mem &mem) : mem(mem), pc(0), lo(0), hi(0),
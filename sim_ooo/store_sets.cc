@@ -0,0 +1,74 @@
+#include <cassert>
+#include <algorithm>
+
+#include "store_sets.hh"
+#include "helper.hh"
+
+store_set_predictor::store_set_predictor(uint32_t ssit_entries, uint32_t lfst_entries, uint64_t clear_interval) :
+  ssit(ssit_entries, invalid), lfst(lfst_entries), clear_interval(clear_interval) {
+  assert(isPow2(ssit_entries) and isPow2(lfst_entries));
+}
+
+void store_set_predictor::clear() {
+  std::fill(ssit.begin(), ssit.end(), invalid);
+  std::fill(lfst.begin(), lfst.end(), lfst_entry());
+  accesses = 0;
+  clears++;
+}
+
+void store_set_predictor::tick() {
+  accesses++;
+  if(clear_interval and (accesses >= clear_interval)) {
+    clear();
+  }
+}
+
+bool store_set_predictor::load_allocated(uint32_t pc, int32_t &store_tbl_idx, int64_t &alloc_id) {
+  tick();
+  int32_t ssid = ssit[ssit_idx(pc)];
+  if(ssid == invalid or lfst[ssid].store_tbl_idx == invalid) {
+    return false;
+  }
+  store_tbl_idx = lfst[ssid].store_tbl_idx;
+  alloc_id = lfst[ssid].alloc_id;
+  predicted_deps++;
+  return true;
+}
+
+bool store_set_predictor::store_allocated(uint32_t pc, int32_t store_tbl_idx, int64_t alloc_id,
+					  int32_t &prev_tbl_idx, int64_t &prev_alloc_id) {
+  tick();
+  int32_t ssid = ssit[ssit_idx(pc)];
+  if(ssid == invalid) {
+    return false;
+  }
+  lfst_entry &e = lfst[ssid];
+  bool dep = (e.store_tbl_idx != invalid);
+  if(dep) {
+    prev_tbl_idx = e.store_tbl_idx;
+    prev_alloc_id = e.alloc_id;
+    predicted_deps++;
+  }
+  e.store_tbl_idx = store_tbl_idx;
+  e.alloc_id = alloc_id;
+  return dep;
+}
+
+void store_set_predictor::violation(uint32_t load_pc, uint32_t store_pc) {
+  int32_t &ld = ssit[ssit_idx(load_pc)];
+  int32_t &st = ssit[ssit_idx(store_pc)];
+  violations++;
+  if(ld == invalid and st == invalid) {
+    ld = st = (store_pc >> 2) & (lfst.size()-1);
+  }
+  else if(ld == invalid) {
+    ld = st;
+  }
+  else if(st == invalid) {
+    st = ld;
+  }
+  else {
+    /* merge, the smaller id wins */
+    ld = st = std::min(ld, st);
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef __store_sets_hh__
+#define __store_sets_hh__
+
+#include <cstdint>
+#include <vector>
+
+/* Chrysos and Emer store sets : the SSIT maps load and store pcs
+ * to a set id, the LFST remembers the last store allocated in each
+ * set. a load waits on that store and a store on the one before it,
+ * so the stores of a set issue in order. the SSIT is wiped every
+ * clear_interval memory ops so stale sets don't serialize forever */
+class store_set_predictor {
+public:
+  static const int32_t invalid = -1;
+private:
+  struct lfst_entry {
+    int32_t store_tbl_idx = invalid;
+    int64_t alloc_id = -1;
+  };
+  std::vector<int32_t> ssit;
+  std::vector<lfst_entry> lfst;
+  uint64_t clear_interval = 0, accesses = 0;
+  uint64_t violations = 0, predicted_deps = 0, clears = 0;
+  uint32_t ssit_idx(uint32_t pc) const {
+    return (pc >> 2) & (ssit.size()-1);
+  }
+  void tick();
+public:
+  /* clear_interval of 0 never clears */
+  store_set_predictor(uint32_t ssit_entries, uint32_t lfst_entries, uint64_t clear_interval);
+  /* store table slot and alloc id of the store a load at pc should
+   * wait on ; the caller checks the slot still holds that store */
+  bool load_allocated(uint32_t pc, int32_t &store_tbl_idx, int64_t &alloc_id);
+  /* records the store as the last of its set and hands back the
+   * previous one, which it should wait on */
+  bool store_allocated(uint32_t pc, int32_t store_tbl_idx, int64_t alloc_id,
+		       int32_t &prev_tbl_idx, int64_t &prev_alloc_id);
+  /* load at load_pc executed ahead of an older store to the same
+   * address */
+  void violation(uint32_t load_pc, uint32_t store_pc);
+  void clear();
+  uint64_t get_violations() const {
+    return violations;
+  }
+  uint64_t get_predicted_deps() const {
+    return predicted_deps;
+  }
+  uint64_t get_clears() const {
+    return clears;
+  }
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include <cassert>
+
+#include "tlb.hh"
+#include "sim_cache.hh"
+#include "sim_parameters.hh"
+#include "helper.hh"
+#include "globals.hh"
+
+/* page tables live in kseg2, clear of user addresses : a directory
+ * word per 4MB region, then a pte per page */
+static const uint32_t pgd_base = 0xc0000000;
+static const uint32_t pte_base = 0xc0400000;
+static const uint32_t lg_pgd_region = 22;
+
+sim_tlb::sim_tlb(uint32_t n_entries, uint32_t n_ways, uint32_t lg_page) :
+  n_ways(n_ways), lg_page(lg_page) {
+  assert(isPow2(n_entries) and isPow2(n_ways) and (n_ways <= n_entries));
+  n_sets = n_entries / n_ways;
+  arr.resize(n_entries);
+}
+
+bool sim_tlb::lookup(uint32_t addr, uint32_t &wait) {
+  const uint32_t vpn = addr >> lg_page;
+  entry *set = &arr[set_of(vpn) * n_ways];
+  for(uint32_t w = 0; w < n_ways; w++) {
+    if(set[w].valid and (set[w].vpn == vpn)) {
+      const uint64_t now = get_curr_cycle();
+      hits++;
+      set[w].stamp = ++clock;
+      wait = (set[w].ready > now) ? (set[w].ready - now) : 0;
+      return true;
+    }
+  }
+  misses++;
+  return false;
+}
+
+void sim_tlb::insert(uint32_t addr, uint64_t ready) {
+  const uint32_t vpn = addr >> lg_page;
+  entry *set = &arr[set_of(vpn) * n_ways];
+  entry *v = &set[0];
+  for(uint32_t w = 0; w < n_ways; w++) {
+    if(not(set[w].valid)) {
+      v = &set[w];
+      break;
+    }
+    if(set[w].stamp < v->stamp) {
+      v = &set[w];
+    }
+  }
+  v->valid = true;
+  v->vpn = vpn;
+  v->stamp = ++clock;
+  v->ready = ready;
+}
+
+sim_mmu::sim_mmu(simCache *walk_cache) :
+  itlb(sim_param::itlb_entries, sim_param::itlb_ways, sim_param::lg_page_size),
+  dtlb(sim_param::dtlb_entries, sim_param::dtlb_ways, sim_param::lg_page_size),
+  stlb(sim_param::stlb_entries, sim_param::stlb_ways, sim_param::lg_page_size),
+  walk_cache(walk_cache), lg_page(sim_param::lg_page_size) {
+  assert(walk_cache != nullptr);
+  if(lg_page >= 32) {
+    die();
+  }
+}
+
+/* dependent directory and pte loads. pages of a directory region or
+ * larger map straight from the directory */
+uint32_t sim_mmu::walk(uint32_t addr, uint32_t pc, uint32_t lat) {
+  const uint32_t start = lat;
+  walks++;
+  walk_cache->access_timed(pgd_base + 4*(addr >> lg_pgd_region), 4, pc, lat);
+  if(lg_page < lg_pgd_region) {
+    walk_cache->access_timed(pte_base + 4*(addr >> lg_page), 4, pc, lat);
+  }
+  walk_cycles += lat - start;
+  return lat;
+}
+
+uint32_t sim_mmu::translate(sim_tlb &tlb, uint32_t addr, uint32_t pc) {
+  uint32_t lat = 0;
+  if(tlb.lookup(addr, lat)) {
+    return lat;
+  }
+  uint32_t wait = 0;
+  if(stlb.lookup(addr, wait)) {
+    lat = sim_param::stlb_latency + wait;
+  }
+  else {
+    lat = walk(addr, pc, sim_param::stlb_latency);
+    stlb.insert(addr, get_curr_cycle() + lat);
+  }
+  tlb.insert(addr, get_curr_cycle() + lat);
+  return lat;
+}
@@ -0,0 +1,77 @@
+#ifndef __tlb_hh__
+#define __tlb_hh__
+
+#include <cstdint>
+#include <vector>
+
+class simCache;
+
+/* set-associative tlb with lru replacement. the pipeline runs on
+ * virtual addresses, so entries only hold page numbers : translation
+ * costs time, never correctness. an entry filled by a walk still in
+ * flight makes later lookups wait for it */
+class sim_tlb {
+private:
+  struct entry {
+    bool valid = false;
+    uint32_t vpn = 0;
+    uint64_t stamp = 0;
+    uint64_t ready = 0;
+  };
+  uint32_t n_sets = 1, n_ways = 1, lg_page = 12;
+  std::vector<entry> arr;
+  uint64_t clock = 0, hits = 0, misses = 0;
+  uint32_t set_of(uint32_t vpn) const {
+    return vpn & (n_sets-1);
+  }
+public:
+  sim_tlb(uint32_t n_entries, uint32_t n_ways, uint32_t lg_page);
+  /* wait : cycles until a pending fill lands */
+  bool lookup(uint32_t addr, uint32_t &wait);
+  void insert(uint32_t addr, uint64_t ready);
+  uint64_t get_hits() const {
+    return hits;
+  }
+  uint64_t get_misses() const {
+    return misses;
+  }
+};
+
+/* first level itlb and dtlb backed by a shared stlb. stlb misses
+ * walk a two level page table, each reference going through the data
+ * cache hierarchy */
+class sim_mmu {
+private:
+  sim_tlb itlb, dtlb, stlb;
+  simCache *walk_cache = nullptr;
+  uint32_t lg_page = 12;
+  uint64_t walks = 0, walk_cycles = 0;
+  uint32_t walk(uint32_t addr, uint32_t pc, uint32_t lat);
+  uint32_t translate(sim_tlb &tlb, uint32_t addr, uint32_t pc);
+public:
+  sim_mmu(simCache *walk_cache);
+  /* cycles before the access can reach the l1 */
+  uint32_t translate_fetch(uint32_t addr, uint32_t pc) {
+    return translate(itlb, addr, pc);
+  }
+  uint32_t translate_data(uint32_t addr, uint32_t pc) {
+    return translate(dtlb, addr, pc);
+  }
+  const sim_tlb &get_itlb() const {
+    return itlb;
+  }
+  const sim_tlb &get_dtlb() const {
+    return dtlb;
+  }
+  const sim_tlb &get_stlb() const {
+    return stlb;
+  }
+  uint64_t get_walks() const {
+    return walks;
+  }
+  uint64_t get_walk_cycles() const {
+    return walk_cycles;
+  }
+};
+
+#endif